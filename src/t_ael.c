@@ -15,14 +15,32 @@
 #include "t.h"
 #include <stdlib.h>               // malloc, free
 #include <string.h>               // memset
+#include <stdio.h>                // snprintf
+#include <inttypes.h>             // PRIu64
+#include <time.h>                 // clock_gettime
 #include "t_ael.h"
 #include "t_tim.h"
 
 
+/**----------------------------------------------------------------------------
+ * Monotonic clock used to time callbacks.
+ * \return  uint64_t  microseconds.
+ * --------------------------------------------------------------------------*/
+static inline uint64_t
+t_ael_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( T_AEL_CLOCK, &ts );
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
 /**----------------------------------------------------------------------------
  * Slot in a timer event into the loops timer event list.
- * \detail  Ordered insert; walks down linked list and inserts before the next
- *          bigger * timer
+ * \detail  Ordered insert by deadline; walks down linked list and inserts
+ *          before the next later timer.  Timers with equal deadlines fire in
+ *          the order they were inserted.
  * \param   t_ael    Loop Struct.
  * \return  void.
  * --------------------------------------------------------------------------*/
@@ -31,13 +49,11 @@ t_ael_instimer( struct t_ael *ael, struct t_ael_tm *te )
 {
 	struct t_ael_tm *tr;
 
-	if (NULL == ael->tm_head || t_tim_cmp( ael->tm_head->tv, te->tv, > ))
+	if (NULL == ael->tm_head || ael->tm_head->dl > te->dl)
 	{
 #if PRINT_DEBUGS == 1
-		printf( "Make HEAD   {%2ld:%6ld}\t PRE{%2ld:%6ld}\n",
-			te->tv->tv_sec,  te->tv->tv_usec,
-			(NULL != ael->tm_head) ? ael->tm_head->tv->tv_sec  : 0,
-			(NULL != ael->tm_head) ? ael->tm_head->tv->tv_usec : 0);
+		printf( "Make HEAD   {%" PRIu64 "}\t PRE{%" PRIu64 "}\n",
+			te->dl, (NULL != ael->tm_head) ? ael->tm_head->dl : 0 );
 #endif
 		te->nxt     = ael->tm_head;
 		ael->tm_head = te;
@@ -45,12 +61,10 @@ t_ael_instimer( struct t_ael *ael, struct t_ael_tm *te )
 	else
 	{
 		tr = ael->tm_head;
-		while (NULL != tr->nxt && t_tim_cmp( tr->nxt->tv, te->tv, < ))
+		while (NULL != tr->nxt && tr->nxt->dl <= te->dl)
 			tr = tr->nxt;
 #if PRINT_DEBUGS == 1
-		printf( "Make NODE   {%2ld:%6ld}\tPAST{%2ld:%6ld}\n",
-			te->tv->tv_sec,  te->tv->tv_usec,
-			tr->tv->tv_sec,  tr->tv->tv_usec);
+		printf( "Make NODE   {%" PRIu64 "}\tPAST{%" PRIu64 "}\n", te->dl, tr->dl );
 #endif
 		te->nxt = tr->nxt;
 		tr->nxt = te;
@@ -58,24 +72,6 @@ t_ael_instimer( struct t_ael *ael, struct t_ael_tm *te )
 }
 
 
-/**--------------------------------------------------------------------------
- * Adjust amount of time in the loops timer event list.
- *          substract ta from each timer in the list.
- * \param   t_ael    Loop Struct.
- * \return  void.
- * --------------------------------------------------------------------------*/
-static inline void
-t_ael_adjusttimer( struct t_ael *ael, struct timeval *ta )
-{
-	struct t_ael_tm *tr = ael->tm_head;
-	while (NULL != tr)
-	{
-		t_tim_sub( tr->tv, ta, tr->tv );
-		tr = tr->nxt;
-	}
-}
-
-
 /**----------------------------------------------------------------------------
  * Unfolds a lua function and parameters from a table in LUA_REGISTRYINDEX
  * \detail  Takes refPosition and gets table onto the stack. The puts function
@@ -98,41 +94,137 @@ t_ael_getfunc( lua_State *L, int refPos )
 }
 
 
+/**----------------------------------------------------------------------------
+ * Push "source:line" of where the function on top of the stack was defined.
+ * \detail  Pops the function.  The lua_Debug record lives only in this frame;
+ *          just the formatted location leaves it.
+ * \param   L         The lua state.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_pushsource( lua_State *L )
+{
+	lua_Debug ar;
+
+	lua_getinfo( L, ">S", &ar );
+	lua_pushfstring( L, "%s:%d", ar.short_src, ar.linedefined );
+}
+
+
+/**----------------------------------------------------------------------------
+ * Account for the duration of a callback and report it if it was slow.
+ * \detail  If the duration exceeds the loops threshold the slow callback hook
+ *          gets called as hook( ms, kind, id, source ) where id is the fd or the
+ *          T.Time of the timer and source is where the callback was defined.
+ * \param   L         The lua state.
+ * \param   struct t_ael  Loop struct.
+ * \param   uint64_t      time the callback was started.
+ * \param   int           stack position of the callbacks func/arg table or 0
+ *                        for a resumed coroutine.
+ * \param   const char*   kind of the callback ("read", "write" or "timer").
+ * \param   int           fd of the handle or registry reference of the T.Time.
+ * --------------------------------------------------------------------------*/
+static inline void
+t_ael_timecall( lua_State *L, struct t_ael *ael, uint64_t t0, int ft,
+                const char *k, int id )
+{
+	uint64_t  d = t_ael_clock( ) - t0;
+
+	t_ael_hst_add( &ael->sts.cbd, d );
+	if (0 == ael->slw || d < ael->slw)
+		return;
+	lua_rawgeti( L, LUA_REGISTRYINDEX, ael->sR );
+	lua_pushnumber( L, (lua_Number) d / 1000.0 );
+	lua_pushstring( L, k );
+	if ('t' == *k)
+		lua_rawgeti( L, LUA_REGISTRYINDEX, id );
+	else
+		lua_pushinteger( L, id );
+	if (0 == ft)
+		lua_pushliteral( L, "coroutine" );
+	else
+	{
+		lua_rawgeti( L, ft, 1 );
+		t_ael_pushsource( L );
+	}
+	lua_call( L, 4, 0 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Calculate how long a poll may block until the next timer is due.
+ * \param   struct t_ael    Loop struct.
+ * \param   struct timeval* timeval to fill with the timeout.
+ * \return  struct timeval* the filled timeval or NULL to block indefinitely
+ *          which is the case without timers or when a timerfd wakes the loop.
+ * --------------------------------------------------------------------------*/
+struct timeval
+*t_ael_timeout( struct t_ael *ael, struct timeval *tv )
+{
+	if (ael->tfd > -1)
+	{
+		t_ael_armtimerfd( ael );
+		return NULL;
+	}
+	if (NULL == ael->tm_head)
+		return NULL;
+	t_tim_setns( tv, (ael->tm_head->dl > ael->nw) ? ael->tm_head->dl - ael->nw : 0 );
+	return tv;
+}
+
+
 /**--------------------------------------------------------------------------
- * Executes a timer function and reorganizes the timer linked list
+ * Executes all timers which are due and reorganizes the timer linked list
+ * \detail  A timer is due when its deadline is not later than the loops
+ *          cached monotonic time.  If the function returns a T.Time the timer
+ *          gets rescheduled that far from the current iteration, otherwise it
+ *          gets removed.
  * \param   L         The lua state.
- * \param   struct xp_lp  Loop struct.
- * \lparam  userdata      T.Loop.
+ * \param   struct t_ael  Loop struct.
  * \return  void.
  * --------------------------------------------------------------------------*/
 void
-t_ael_executetimer( lua_State *L, struct t_ael *ael, struct timeval *rt )
-{
-	struct timeval  *tv;                  ///< timer returned by execution -> if there is
-	
-	struct t_ael_tm *te = ael->tm_head;   ///< timer to execute is tm_head, ALWAYS
-	int    n;                             ///< length of arguments to call
-
-	ael->tm_head = ael->tm_head->nxt;
-	n = t_ael_getfunc( L, te->fR );
-	lua_call( L, n, 1 );
-	t_tim_since( rt );
-	t_ael_adjusttimer( ael, rt );
-	tv = t_tim_check_ud( L, -1, 0 );
-	// reorganize linked timer list
-	if (NULL == tv)
-	{
-		luaL_unref( L, LUA_REGISTRYINDEX, te->fR );
-		luaL_unref( L, LUA_REGISTRYINDEX, te->tR );
-		free (te);
-	}
-	else
+t_ael_executetimers( lua_State *L, struct t_ael *ael )
+{
+	struct timeval  *tv;        ///< timer returned by execution -> if there is
+	struct t_ael_tm *te;        ///< timer to execute is tm_head, ALWAYS
+	int              n;         ///< length of arguments to call
+	uint64_t         t0;
+
+	while (NULL != ael->tm_head && ael->tm_head->dl <= ael->nw)
 	{
-		*te->tv = *tv;
-		t_ael_instimer( ael, te );
+		te           = ael->tm_head;
+		ael->tm_head = te->nxt;
+		ael->sts.tmr++;
+		t_ael_hst_add( &ael->sts.tml, (ael->nw - te->dl) / 1000 );
+		if (LUA_NOREF != te->cR)
+		{
+			t0 = t_ael_clock( );
+			t_ael_resume( L, te->cR, 0 );
+			free( te );
+			t_ael_timecall( L, ael, t0, 0, "timer", LUA_NOREF );
+			continue;
+		}
+		n  = t_ael_getfunc( L, te->fR );
+		t0 = t_ael_clock( );
+		lua_call( L, n, 1 );
+		t_ael_timecall( L, ael, t0, lua_gettop( L ) - 1, "timer", te->tR );
+		tv = t_tim_check_ud( L, -1, 0 );
+		// reorganize linked timer list
+		if (NULL == tv)
+		{
+			luaL_unref( L, LUA_REGISTRYINDEX, te->fR );
+			luaL_unref( L, LUA_REGISTRYINDEX, te->tR );
+			free( te );
+		}
+		else
+		{
+			// never due in this pass again, even when rescheduled with 0
+			te->dl = ael->nw + t_tim_getns( tv ) + 1;
+			t_ael_instimer( ael, te );
+		}
+		lua_pop( L, 2 );   // pop the one value that lua_call allows to be
+		                   // returned and the original reference table
 	}
-	lua_pop( L, 2 );   // pop the one value that lua_call allows to be
-	                   // returned and the original reference table
 }
 
 
@@ -146,20 +238,44 @@ t_ael_executetimer( lua_State *L, struct t_ael *ael, struct timeval *rt )
 void
 t_ael_executehandle( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t )
 {
-	int n;
+	int      n;
+	uint64_t t0;
 
 	//printf( "%d    %d    %d    %d\n", fd,  ael->fd_set[ fd ]->rR ,  ael->fd_set[ fd ]->wR, t );
-	if( t & T_AEL_RD )
+	ael->sts.evt++;
+	if (t & T_AEL_RD  &&  LUA_NOREF != ael->fd_set[ fd ]->rC)
+	{
+		n = ael->fd_set[ fd ]->rC;
+		ael->fd_set[ fd ]->rC = LUA_NOREF;
+		t_ael_clearhandle( L, ael, fd, T_AEL_RD );
+		t0 = t_ael_clock( );
+		t_ael_resume( L, n, 0 );
+		t_ael_timecall( L, ael, t0, 0, "read", fd );
+	}
+	else if( t & T_AEL_RD )
 	{
 		n = t_ael_getfunc( L, ael->fd_set[ fd ]->rR );
+		t0 = t_ael_clock( );
 		lua_call( L, n , 0 );
+		t_ael_timecall( L, ael, t0, lua_gettop( L ), "read", fd );
 		lua_pop( L, 1 );             // remove the table
 	}
 	// since read func can gc the socket, fd_set[fd] can be NULL
-	if( NULL != ael->fd_set[ fd ] && t & T_AEL_WR )
+	if (NULL != ael->fd_set[ fd ] && t & T_AEL_WR  &&  LUA_NOREF != ael->fd_set[ fd ]->wC)
+	{
+		n = ael->fd_set[ fd ]->wC;
+		ael->fd_set[ fd ]->wC = LUA_NOREF;
+		t_ael_clearhandle( L, ael, fd, T_AEL_WR );
+		t0 = t_ael_clock( );
+		t_ael_resume( L, n, 0 );
+		t_ael_timecall( L, ael, t0, 0, "write", fd );
+	}
+	else if( NULL != ael->fd_set[ fd ] && t & T_AEL_WR )
 	{
 		n = t_ael_getfunc( L, ael->fd_set[ fd ]->wR );
+		t0 = t_ael_clock( );
 		lua_call( L, n , 0 );
+		t_ael_timecall( L, ael, t0, lua_gettop( L ), "write", fd );
 		lua_pop( L, 1 );             // remove the table
 	}
 }
@@ -210,7 +326,25 @@ struct t_ael
 	ael = (struct t_ael *) lua_newuserdata( L, sizeof( struct t_ael ) );
 	ael->fd_sz   = sz;
 	ael->max_fd  = 0;
+	ael->nfd     = 0;
+	ael->nin     = 0;
 	ael->tm_head = NULL;
+	ael->run     = 0;
+	ael->nw      = t_tim_mono( );
+	memset( &ael->sts, 0, sizeof( struct t_ael_sts ) );
+	ael->slw     = 0;
+	ael->sR      = LUA_NOREF;
+	ael->sfd     = -1;
+	ael->tfd     = -1;
+	ael->tdl     = 0;
+	ael->gR      = LUA_NOREF;
+	sigemptyset( &ael->sms );
+	ael->tq      = NULL;
+	ael->qfd[ 0 ] = -1;
+	ael->qfd[ 1 ] = -1;
+	ael->wrk     = NULL;
+	ael->iou     = NULL;
+	ael->op      = 0;
 	ael->fd_set  = (struct t_ael_fd **) malloc( (ael->fd_sz+1) * sizeof( struct t_ael_fd * ) );
 	for (n=0; n<=ael->fd_sz; n++) ael->fd_set[ n ] = NULL;
 	t_ael_create_ud_impl( ael );
@@ -268,31 +402,159 @@ lt_ael_addhandle( lua_State *L )
 	if (0 == fd)
 		return t_push_error( L, "Argument to addHandle must be file or socket" );
 
+	lua_createtable( L, n-4, 0 );  // create function/parameter table
+	lua_insert( L, 4 );
+	//Stack: ael,fd,read/write,TABLE,func,...
+	while (n > 4)
+		lua_rawseti( L, 4, (n--)-4 );   // add arguments and function (pops each item)
+	lua_remove( L, 3 ); // remove the read write boolean
+	if (t_ael_sethandle( L, ael, fd, t ) < 0)
+		return t_push_error( L, "Can't observe descriptor %d", fd );
+
+	return  0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make room for descriptors beyond the size the T.Loop was created with.
+ * \detail  Descriptors the loop creates itself (signalfd, timerfd, the task
+ *          queue) can be numbered higher than the size it was created with.
+ *          Grows in steps of 64 slots.
+ * \param   struct t_ael*  the loop.
+ * \param   int            descriptor which must fit.
+ * \return  int  0 on success, -1 on failure.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_grow( struct t_ael *ael, int fd )
+{
+	struct t_ael_fd **fs;
+	size_t            sz = (size_t) (fd | 63);
+	size_t            n;
+
+	if (t_ael_resize_impl( ael, sz ) < 0)
+		return -1;
+	fs = (struct t_ael_fd **) realloc( ael->fd_set, (sz+1) * sizeof( struct t_ael_fd * ) );
+	if (NULL == fs)
+		return -1;
+	for (n=ael->fd_sz+1; n<=sz; n++) fs[ n ] = NULL;
+	ael->fd_set = fs;
+	ael->fd_sz  = sz;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Start observing a descriptor for read or write.
+ * \param   struct t_ael*  the loop.
+ * \param   int            descriptor.
+ * \param   enum t_ael_t   observe for read or for write.
+ * \return  int  0 on success, -1 if the loop can't hold the descriptor.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_observe( struct t_ael *ael, int fd, enum t_ael_t t )
+{
+	if (fd < 0 || ((size_t) fd > ael->fd_sz && t_ael_grow( ael, fd ) < 0))
+		return -1;
 	if (NULL == ael->fd_set[ fd ])
 	{
 		ael->fd_set[ fd ] = (struct t_ael_fd *) malloc( sizeof( struct t_ael_fd ) );
-		ael->fd_set[ fd ]->t = T_AEL_NO;
+		ael->fd_set[ fd ]->t  = T_AEL_NO;
+		ael->fd_set[ fd ]->fd = fd;
+		ael->fd_set[ fd ]->rR = LUA_NOREF;
+		ael->fd_set[ fd ]->wR = LUA_NOREF;
+		ael->fd_set[ fd ]->hR = LUA_NOREF;
+		ael->fd_set[ fd ]->rC = LUA_NOREF;
+		ael->fd_set[ fd ]->wC = LUA_NOREF;
+		ael->nfd++;
 	}
 
 	ael->fd_set[ fd ]->t |= t;
 
 	ael->max_fd = (fd > ael->max_fd) ? fd : ael->max_fd;
 	t_ael_addhandle_impl( ael, fd, t );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Register a descriptor with the T.Loop.
+ * \detail  Expects the handle and the function/parameter table on top of the
+ *          stack and pops both.  The handle gets referenced so it doesn't get
+ *          garbage collected while observed; it can be nil for descriptors
+ *          which are owned by the loop itself.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * \param   int            descriptor.
+ * \param   enum t_ael_t   observe for read or for write.
+ * \return  int  0 on success, -1 if the loop can't hold the descriptor.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_sethandle( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t )
+{
+	if (t_ael_observe( ael, fd, t ) < 0)
+	{
+		lua_pop( L, 2 );
+		return -1;
+	}
 
-	lua_createtable( L, n-4, 0 );  // create function/parameter table
-	lua_insert( L, 4 );
-	//Stack: ael,fd,read/write,TABLE,func,...
-	while (n > 4)
-		lua_rawseti( L, 4, (n--)-4 );   // add arguments and function (pops each item)
 	// pop the function reference table and assign as read or write function
 	if (T_AEL_RD & t)
 		ael->fd_set[ fd ]->rR = luaL_ref( L, LUA_REGISTRYINDEX );
 	else
 		ael->fd_set[ fd ]->wR = luaL_ref( L, LUA_REGISTRYINDEX );
-	lua_pop( L, 1 ); // pop the read write boolean
+	luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ fd ]->hR );
 	ael->fd_set[ fd ]->hR = luaL_ref( L, LUA_REGISTRYINDEX );      // keep ref to handle so it doesnt gc
+	return 0;
+}
 
-	return  0;
+
+/**--------------------------------------------------------------------------
+ * Make the running coroutine wait for a descriptor to become ready.
+ * \detail  One-shot; the interest is dropped before the coroutine gets
+ *          resumed.  The coroutine itself is the only thing referenced, so
+ *          waiting again doesn't allocate a func/arg table.  The caller has to
+ *          yield afterwards.
+ * \param   L    The lua state of the coroutine.
+ * \param   struct t_ael*  the loop.
+ * \param   int            descriptor.
+ * \param   enum t_ael_t   wait for read or for write.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_waithandle( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t )
+{
+	if ((size_t) fd <= ael->fd_sz && NULL != ael->fd_set[ fd ] && ael->fd_set[ fd ]->t & t)
+		luaL_error( L, "handle is already observed by the loop" );
+	if (t_ael_observe( ael, fd, t ) < 0)
+		t_push_error( L, "Can't observe descriptor %d", fd );
+	lua_pushthread( L );
+	if (T_AEL_RD & t)
+		ael->fd_set[ fd ]->rC = luaL_ref( L, LUA_REGISTRYINDEX );
+	else
+		ael->fd_set[ fd ]->wC = luaL_ref( L, LUA_REGISTRYINDEX );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make the running coroutine wait for a span of time.
+ * \detail  The caller has to yield afterwards.
+ * \param   L    The lua state of the coroutine.
+ * \param   struct t_ael*  the loop.
+ * \param   uint64_t       nanoseconds to wait.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_waittimer( lua_State *L, struct t_ael *ael, uint64_t ns )
+{
+	struct t_ael_tm *te = (struct t_ael_tm *) malloc( sizeof( struct t_ael_tm ) );
+
+	if (NULL == te)
+		luaL_error( L, "Failed to allocate timer" );
+	te->tv = NULL;
+	te->fR = LUA_NOREF;
+	te->tR = LUA_NOREF;
+	te->dl = ((ael->run) ? ael->nw : t_tim_mono( )) + ns;
+	lua_pushthread( L );
+	te->cR = luaL_ref( L, LUA_REGISTRYINDEX );
+	t_ael_instimer( ael, te );
 }
 
 
@@ -325,13 +587,37 @@ lt_ael_removehandle( lua_State *L )
 
 	if (0 == fd)
 		return t_push_error( L, "Argument to addHandle must be file or socket" );
+	if ((size_t) fd > ael->fd_sz || NULL == ael->fd_set[ fd ])
+		return 0;
+	t_ael_clearhandle( L, ael, fd, t );
+
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Stop observing a descriptor for read or write.
+ * \detail  Once neither direction is observed the descriptor gets removed
+ *          from the loop and its handle reference is released.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * \param   int            descriptor.
+ * \param   enum t_ael_t   stop observing read or write.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_clearhandle( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t )
+{
 	// remove function
 	if (T_AEL_RD & t)
 	{
 		luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ fd ]->rR );
+		ael->fd_set[ fd ]->rR = LUA_NOREF;
 	}
 	else
+	{
 		luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ fd ]->wR );
+		ael->fd_set[ fd ]->wR = LUA_NOREF;
+	}
 	t_ael_removehandle_impl( ael, fd, t );
 	// remove from mask
 	ael->fd_set[ fd ]->t = ael->fd_set[ fd ]-> t & (~t);
@@ -341,9 +627,8 @@ lt_ael_removehandle( lua_State *L )
 		luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ fd ]->hR );
 		free( ael->fd_set[ fd ] );
 		ael->fd_set[ fd ] = NULL;
+		ael->nfd--;
 	}
-
-	return 0;
 }
 
 
@@ -368,6 +653,9 @@ lt_ael_addtimer( lua_State *L )
 	// Build up the timer element
 	te = (struct t_ael_tm *) malloc( sizeof( struct t_ael_tm ) );
 	te->tv =  tv;
+	te->cR = LUA_NOREF;
+	// outside of run() the cached time can be arbitrarily old
+	te->dl = ((ael->run) ? ael->nw : t_tim_mono( )) + t_tim_getns( tv );
 	//t_ael_addtimer_impl( ael, tv );
 	lua_createtable( L, n-3, 0 );  // create function/parameter table
 	lua_insert( L, 3 );
@@ -397,11 +685,14 @@ lt_ael_removetimer( lua_State *L )
 {
 	struct t_ael    *ael = t_ael_check_ud( L, 1, 1 );
 	struct timeval  *tv  = t_tim_check_ud( L, 2, 1 );
-	struct t_ael_tm *tp  = ael->tm_head;
-	struct t_ael_tm *te  = tp->nxt;       ///< previous Timer event
+	struct t_ael_tm *tp  = ael->tm_head;  ///< previous Timer event
+	struct t_ael_tm *te;
 
+	if (NULL == tp)
+		return 0;
+	te = tp->nxt;
 	// if head is node in question
-	if (NULL != tp  &&  tp->tv == tv)
+	if (tp->tv == tv)
 	{
 		ael->tm_head = te;
 		luaL_unref( L, LUA_REGISTRYINDEX, tp->fR );
@@ -419,7 +710,7 @@ lt_ael_removetimer( lua_State *L )
 	{
 		tp->nxt = te->nxt;
 		luaL_unref( L, LUA_REGISTRYINDEX, te->fR );
-		luaL_unref( L, LUA_REGISTRYINDEX, tp->tR );
+		luaL_unref( L, LUA_REGISTRYINDEX, te->tR );
 		free( te );
 	}
 
@@ -446,6 +737,7 @@ lt_ael__gc( lua_State *L )
 		//printf( "Start  %p   %d   %d    %p\n", tf, tf->fR, tf->tR, tf->nxt );
 		luaL_unref( L, LUA_REGISTRYINDEX, tf->fR ); // remove func/arg table from registry
 		luaL_unref( L, LUA_REGISTRYINDEX, tf->tR ); // remove timeval ref from registry
+		luaL_unref( L, LUA_REGISTRYINDEX, tf->cR ); // remove waiting coroutine
 		tr = tr->nxt;
 		//printf( "Free   %p   %d   %d    %p\n", tf, tf->fR, tf->tR, tf->nxt );
 		free( tf );
@@ -458,13 +750,43 @@ lt_ael__gc( lua_State *L )
 			luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ i ]->rR );
 			luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ i ]->wR );
 			luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ i ]->hR );
+			luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ i ]->rC );
+			luaL_unref( L, LUA_REGISTRYINDEX, ael->fd_set[ i ]->wC );
 			free( ael->fd_set[ i ] );
 		}
 	}
+	luaL_unref( L, LUA_REGISTRYINDEX, ael->sR );
+	t_ael_lnx_free( L, ael );
+	t_ael_wrk_free( L, ael );
+	t_ael_tsk_free( L, ael );
+	t_ael_free_impl( L, ael );
 	return 0;
 }
 
 
+/**--------------------------------------------------------------------------
+ * Check if anything is left in the T.Loop which could produce an event.
+ * \detail  Descriptors the loop created itself (signalfd, timerfd, the task
+ *          queue) don't count.  Observed signals, queued tasks and operations
+ *          in flight do.
+ * \param   struct t_ael*  the loop.
+ * \return  int  1 if the loop is idle, 0 otherwise.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_idle( struct t_ael *ael )
+{
+	int sig;
+
+	if (NULL != ael->tm_head || ael->nfd > ael->nin || 0 != ael->op ||
+	    NULL != __atomic_load_n( &ael->tq, __ATOMIC_ACQUIRE ))
+		return 0;
+	for (sig=1; sig<NSIG; sig++)
+		if (sigismember( &ael->sms, sig ) > 0)
+			return 0;
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Set up a select call for all events in the T.Loop
  * \param   L  The lua state.
@@ -479,16 +801,23 @@ static int
 lt_ael_run( lua_State *L )
 {
 	struct t_ael    *ael = t_ael_check_ud( L, 1, 1 );
+	uint64_t         n;      ///< events executed before the poll
+	uint64_t         b;      ///< time spent in callbacks before the poll
 	ael->run = 1;
 
-	while (ael->run)
+	while (__atomic_load_n( &ael->run, __ATOMIC_ACQUIRE ))
 	{
+		n = ael->sts.evt + ael->sts.tmr;
+		b = ael->sts.cbd.sum;
 		if (t_ael_poll_impl( L, ael ) < 0)
 		{
 			return t_push_error( L, "Failed to continue" );
 		}
+		ael->sts.wkp++;
+		t_ael_hst_add( &ael->sts.epw, ael->sts.evt + ael->sts.tmr - n );
+		t_ael_hst_add( &ael->sts.lag, ael->sts.cbd.sum - b );
 		// if there are no events left in the loop stop processing
-		ael->run = (NULL==ael->tm_head && ael->max_fd<1) ? 0 : ael->run;
+		ael->run = (t_ael_idle( ael )) ? 0 : ael->run;
 	}
 
 	return 0;
@@ -505,11 +834,226 @@ static int
 lt_ael_stop( lua_State *L )
 {
 	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
-	ael->run = 0;
+	t_ael_stop( ael );
 	return 0;
 }
 
 
+/**--------------------------------------------------------------------------
+ * Record a value in a log2 bucketed histogram.
+ * \param   struct t_ael_hst*  the histogram.
+ * \param   uint64_t           the value.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_hst_add( struct t_ael_hst *h, uint64_t v )
+{
+	int b = (0 == v) ? 0 : 64 - __builtin_clzll( v );
+
+	h->b[ (b < T_AEL_HST_SZ) ? b : T_AEL_HST_SZ-1 ]++;
+	h->cnt++;
+	h->sum += v;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push a histogram as a table onto the stack.
+ * \detail  { count=n, sum=s, [i]=n } where [i] counts values in
+ *          [2^(i-2), 2^(i-1)) and [1] counts zeros.
+ * \param   L      The lua state.
+ * \param   struct t_ael_hst*  the histogram.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_hst_push( lua_State *L, struct t_ael_hst *h )
+{
+	int i;
+
+	lua_createtable( L, T_AEL_HST_SZ, 2 );
+	lua_pushinteger( L, (lua_Integer) h->cnt );
+	lua_setfield( L, -2, "count" );
+	lua_pushinteger( L, (lua_Integer) h->sum );
+	lua_setfield( L, -2, "sum" );
+	for (i=0; i<T_AEL_HST_SZ; i++)
+	{
+		lua_pushinteger( L, (lua_Integer) h->b[ i ] );
+		lua_rawseti( L, -2, i+1 );
+	}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Add a histogram in text exposition format to a buffer.
+ * \param   luaL_Buffer*       the buffer to add to.
+ * \param   const char*        name of the metric.
+ * \param   struct t_ael_hst*  the histogram.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_hst_format( luaL_Buffer *lB, const char *name, struct t_ael_hst *h )
+{
+	char     b[ 128 ];
+	uint64_t c = 0;
+	int      i, n;
+
+	n = snprintf( b, sizeof( b ), "# TYPE %s histogram\n", name );
+	luaL_addlstring( lB, b, n );
+	for (i=0; i<T_AEL_HST_SZ-1; i++)
+	{
+		c += h->b[ i ];
+		n  = snprintf( b, sizeof( b ), "%s_bucket{le=\"%" PRIu64 "\"} %" PRIu64 "\n",
+			name, (0 == i) ? 0 : (((uint64_t) 1) << i) - 1, c );
+		luaL_addlstring( lB, b, n );
+	}
+	n = snprintf( b, sizeof( b ), "%s_bucket{le=\"+Inf\"} %" PRIu64 "\n"
+		"%s_sum %" PRIu64 "\n" "%s_count %" PRIu64 "\n",
+		name, h->cnt, name, h->sum, name, h->cnt );
+	luaL_addlstring( lB, b, n );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Count the handles and timers currently registered on the loop.
+ * \param   struct t_ael*  the loop.
+ * \param   size_t*        number of handles.
+ * \param   size_t*        number of timers.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_count( struct t_ael *ael, size_t *h, size_t *t )
+{
+	struct t_ael_tm *tr = ael->tm_head;
+	int              i;
+
+	*h = 0;
+	*t = 0;
+	for (i=0; i<=ael->max_fd; i++)
+		if (NULL != ael->fd_set[ i ] && T_AEL_NO != ael->fd_set[ i ]->t)
+			(*h)++;
+	while (NULL != tr)
+	{
+		(*t)++;
+		tr = tr->nxt;
+	}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Add the loops metrics in text exposition format to a buffer.
+ * \param   luaL_Buffer*   the buffer to add to.
+ * \param   struct t_ael*  the loop.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_metrics( luaL_Buffer *lB, struct t_ael *ael )
+{
+	char   b[ 512 ];
+	size_t h, t;
+	int    n;
+
+	t_ael_count( ael, &h, &t );
+	n = snprintf( b, sizeof( b ),
+		"# TYPE t_loop_wakeups_total counter\n"
+		"t_loop_wakeups_total %" PRIu64 "\n"
+		"# TYPE t_loop_events_total counter\n"
+		"t_loop_events_total %" PRIu64 "\n"
+		"# TYPE t_loop_timers_fired_total counter\n"
+		"t_loop_timers_fired_total %" PRIu64 "\n"
+		"# TYPE t_loop_handles gauge\n"
+		"t_loop_handles %zu\n"
+		"# TYPE t_loop_timers gauge\n"
+		"t_loop_timers %zu\n",
+		ael->sts.wkp, ael->sts.evt, ael->sts.tmr, h, t );
+	luaL_addlstring( lB, b, n );
+	t_ael_hst_format( lB, "t_loop_events_per_wakeup",           &ael->sts.epw );
+	t_ael_hst_format( lB, "t_loop_callback_duration_microseconds", &ael->sts.cbd );
+	t_ael_hst_format( lB, "t_loop_timer_lateness_microseconds",    &ael->sts.tml );
+	t_ael_hst_format( lB, "t_loop_lag_microseconds",               &ael->sts.lag );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Snapshot of the loops health counters.
+ * \param   L     The lua state.
+ * \lparam  userdata  T.Loop userdata
+ * \lreturn table     counters and histograms of the loop.
+ * \return  The number of results to be passed back to the calling Lua script.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_stats( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	size_t        h, t;
+
+	t_ael_count( ael, &h, &t );
+	lua_createtable( L, 0, 9 );
+	lua_pushinteger( L, (lua_Integer) ael->sts.wkp );
+	lua_setfield( L, -2, "wakeups" );
+	lua_pushinteger( L, (lua_Integer) ael->sts.evt );
+	lua_setfield( L, -2, "events" );
+	lua_pushinteger( L, (lua_Integer) ael->sts.tmr );
+	lua_setfield( L, -2, "timersFired" );
+	lua_pushinteger( L, (lua_Integer) h );
+	lua_setfield( L, -2, "handles" );
+	lua_pushinteger( L, (lua_Integer) t );
+	lua_setfield( L, -2, "timers" );
+	t_ael_hst_push( L, &ael->sts.epw );
+	lua_setfield( L, -2, "eventsPerWakeup" );
+	t_ael_hst_push( L, &ael->sts.cbd );
+	lua_setfield( L, -2, "callbackTime" );
+	t_ael_hst_push( L, &ael->sts.tml );
+	lua_setfield( L, -2, "timerLateness" );
+	t_ael_hst_push( L, &ael->sts.lag );
+	lua_setfield( L, -2, "lag" );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Set a hook to be called for callbacks which take longer than a threshold.
+ * \param   L     The lua state.
+ * \lparam  userdata  T.Loop userdata
+ * \lparam  number    threshold in milliseconds.
+ * \lparam  function  hook( ms, kind, id, source ); nil disables the hook.
+ * \return  The number of results to be passed back to the calling Lua script.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_onslow( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	lua_Number    ms  = luaL_optnumber( L, 2, 0 );
+
+	luaL_unref( L, LUA_REGISTRYINDEX, ael->sR );
+	ael->sR  = LUA_NOREF;
+	ael->slw = 0;
+	if (lua_isnoneornil( L, 3 ))
+		return 0;
+	luaL_checktype( L, 3, LUA_TFUNCTION );
+	luaL_argcheck( L, ms > 0, 2, "threshold must be positive" );
+	lua_settop( L, 3 );
+	ael->sR  = luaL_ref( L, LUA_REGISTRYINDEX );
+	ael->slw = (uint64_t) (ms * 1000);
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the loops current monotonic time.
+ * \detail  The time is read once per loop iteration, so calling this from a
+ *          callback doesn't cost a system call.  It is unrelated to the wall
+ *          clock time of T.Time and only good to measure time spans.
+ * \param   L     The lua state.
+ * \lparam  userdata  T.Loop userdata
+ * \lreturn number    milliseconds since an arbitrary starting point.
+ * \return  The number of results to be passed back to the calling Lua script.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_now( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+
+	if (! ael->run)
+		ael->nw = t_tim_mono( );
+	lua_pushnumber( L, (lua_Number) ael->nw / 1000000.0 );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Prints out the Loop.
  * \param   L     The lua state.
@@ -541,12 +1085,17 @@ lt_ael_showloop( lua_State *L )
 	printf( "LOOP %p TIMER LIST:\n", ael );
 	while (NULL != tr)
 	{
-		printf( "\t%d\t{%2ld:%6ld}\t%p   ", ++i,
-			tr->tv->tv_sec,  tr->tv->tv_usec,
+		printf( "\t%d\t{%6" PRId64 "ms}\t%p   ", ++i,
+			((int64_t) tr->dl - (int64_t) ael->nw) / 1000000,
 			tr->tv );
-		t_ael_getfunc( L, tr->fR );
-		t_stackPrint( L, n+1, lua_gettop( L ) );
-		lua_pop( L, lua_gettop( L ) - n );
+		if (LUA_NOREF == tr->cR)
+		{
+			t_ael_getfunc( L, tr->fR );
+			t_stackPrint( L, n+1, lua_gettop( L ) );
+			lua_pop( L, lua_gettop( L ) - n );
+		}
+		else
+			printf( "[coroutine]" );
 		printf( "\n" );
 		tr = tr->nxt;
 	}
@@ -607,6 +1156,20 @@ static const struct luaL_Reg t_ael_m [] = {
 	{ "run",            lt_ael_run },
 	{ "stop",           lt_ael_stop },
 	{ "show",           lt_ael_showloop },
+	{ "stats",          lt_ael_stats },
+	{ "onSlow",         lt_ael_onslow },
+	{ "now",            lt_ael_now },
+	{ "addSignal",      lt_ael_addsignal },
+	{ "removeSignal",   lt_ael_removesignal },
+	{ "timerFd",        lt_ael_timerfd },
+	{ "post",           lt_ael_post },
+	{ "offload",        lt_ael_offload },
+	{ "spawn",          lt_ael_spawn },
+	{ "sleep",          lt_ael_sleep },
+	{ "recv",           lt_ael_recv },
+	{ "send",           lt_ael_send },
+	{ "accept",         lt_ael_accept },
+	{ "registerPool",   lt_ael_registerpool },
 	{ NULL,   NULL }
 };
 
@@ -8,8 +8,22 @@
  * \copyright See Copyright notice at the end of t.h
  */
 
+#include <signal.h>           // sigset_t
 #include "t_net.h"
 
+#define T_AEL_HST_SZ 32         ///< number of log2 buckets in a histogram
+
+// clock to time callbacks with; CLOCK_MONOTONIC_COARSE is cheaper to read on
+// some platforms but only has a resolution of a scheduler tick
+#ifndef T_AEL_CLOCK
+#define T_AEL_CLOCK  CLOCK_MONOTONIC
+#endif
+
+// number of threads in the worker pool of a loop
+#ifndef T_AEL_WRK
+#define T_AEL_WRK    4
+#endif
+
 enum t_ael_t {
 	// 00000000
 	T_AEL_NO = 0x00,        ///< not set
@@ -22,23 +36,66 @@ enum t_ael_t {
 };
 
 
+/// operations a coroutine can hand to a completion based implementation
+enum t_ael_op {
+	T_AEL_OP_RCV,           ///< receive into memory
+	T_AEL_OP_SND,           ///< send from memory
+	T_AEL_OP_ACC,           ///< accept a connection
+	T_AEL_OP_TMO,           ///< wait for a span of time
+};
+
+
 struct t_ael_fd {
 	enum t_ael_t       t;     ///< mask, for unset, readable, writable
 	int                fd;    ///< descriptor
 	int                rR;    ///< func/arg table reference for read  event in LUA_REGISTRYINDEX
 	int                wR;    ///< func/arg table reference for write event in LUA_REGISTRYINDEX
 	int                hR;    ///< handle   reference in LUA_REGISTRYINDEX (T.Socket or Lua file handle)
+	int                rC;    ///< coroutine waiting for read  event in LUA_REGISTRYINDEX; one-shot
+	int                wC;    ///< coroutine waiting for write event in LUA_REGISTRYINDEX; one-shot
 };
 
 
 struct t_ael_tm {
 	int                fR;    ///< func/arg table reference in LUA_REGISTRYINDEX
 	int                tR;    ///< T.Time  reference in LUA_REGISTRYINDEX
-	struct timeval    *tv;    ///< time to elapse until fire (timval to work with)
+	struct timeval    *tv;    ///< T.Time the timer was added with; identifies it
+	uint64_t           dl;    ///< monotonic deadline in nanoseconds
+	int                cR;    ///< coroutine to resume instead of fR; one-shot
 	struct t_ael_tm   *nxt;   ///< next pointer for linked list
 };
 
 
+/// task executed by the loop; run is 0 if it only has to release arg
+typedef void (*t_ael_tfn)( lua_State *L, void *arg, int run );
+
+struct t_ael_tsk {
+	t_ael_tfn          fn;    ///< function to execute on the loops thread
+	void              *arg;   ///< argument to fn
+	struct t_ael_tsk  *nxt;   ///< next pointer for linked list
+};
+
+
+/// log2 bucketed histogram; bucket i counts values in [2^(i-1), 2^i)
+struct t_ael_hst {
+	uint64_t           cnt;   ///< number of recorded values
+	uint64_t           sum;   ///< sum of recorded values
+	uint64_t           b[ T_AEL_HST_SZ ];
+};
+
+
+/// health counters of a loop
+struct t_ael_sts {
+	uint64_t           wkp;   ///< poll wakeups
+	uint64_t           evt;   ///< handle events executed
+	uint64_t           tmr;   ///< timers executed
+	struct t_ael_hst   epw;   ///< events per wakeup
+	struct t_ael_hst   cbd;   ///< callback duration in microseconds
+	struct t_ael_hst   tml;   ///< timer lateness in microseconds
+	struct t_ael_hst   lag;   ///< time spent in callbacks per wakeup in microseconds
+};
+
+
 /// t_ael implementation for select based loops
 struct t_ael {
 	fd_set             rfds;
@@ -47,9 +104,25 @@ struct t_ael {
 	fd_set             wfds_w;   ///<
 	int                run;      ///< boolean indicator to start/stop the loop
 	int                max_fd;   ///< max fd
+	int                nfd;      ///< descriptors observed
+	int                nin;      ///< observed descriptors owned by the loop
 	size_t             fd_sz;    ///< how many fd to handle
 	struct t_ael_tm   *tm_head;
+	uint64_t           nw;       ///< monotonic time of this loop iteration in ns
 	struct t_ael_fd  **fd_set;   ///< array with pointers to fd_events indexed by fd
+	struct t_ael_sts   sts;      ///< loop health counters
+	uint64_t           slw;      ///< slow callback threshold in microseconds; 0=off
+	int                sR;       ///< slow callback hook reference in LUA_REGISTRYINDEX
+	int                sfd;      ///< signalfd; -1 if no signals are observed
+	sigset_t           sms;      ///< signals observed by sfd
+	int                gR;       ///< signal func/arg tables in LUA_REGISTRYINDEX
+	int                tfd;      ///< timerfd driving the timers; -1 if not used
+	uint64_t           tdl;      ///< deadline the timerfd is armed for
+	struct t_ael_tsk  *tq;       ///< posted tasks; pushed by any thread
+	int                qfd[2];   ///< task queue wakeup descriptors (read,write)
+	struct t_ael_wrk  *wrk;      ///< worker pool; created on first use
+	struct t_ael_iou  *iou;      ///< io_uring state; NULL if select() is used
+	size_t             op;       ///< operations in flight (completion based)
 };
 
 
@@ -59,16 +132,68 @@ struct t_ael *t_ael_create_ud( lua_State *L, size_t sz );
 int   lt_ael_addhandle       ( lua_State *L );
 int   lt_ael_removehandle    ( lua_State *L );
 int   lt_ael_showloop        ( lua_State *L );
+int   t_ael_sethandle        ( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t );
+void  t_ael_clearhandle      ( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t );
+void  t_ael_waithandle       ( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t );
+void  t_ael_waittimer        ( lua_State *L, struct t_ael *ael, uint64_t ns );
 
-void t_ael_executetimer     ( lua_State *L, struct t_ael *ael, struct timeval *rt );
+struct timeval *t_ael_timeout( struct t_ael *ael, struct timeval *tv );
+void t_ael_executetimers    ( lua_State *L, struct t_ael *ael );
 void t_ael_executehandle    ( lua_State *L, struct t_ael *ael, int fd, enum t_ael_t t );
 
+// metrics
+void t_ael_hst_add          ( struct t_ael_hst *h, uint64_t v );
+void t_ael_hst_push         ( lua_State *L, struct t_ael_hst *h );
+void t_ael_hst_format       ( luaL_Buffer *lB, const char *name, struct t_ael_hst *h );
+void t_ael_metrics          ( luaL_Buffer *lB, struct t_ael *ael );
+
+// t_ael_lnx.c      (signalfd and timerfd sources)
+int  lt_ael_addsignal       ( lua_State *L );
+int  lt_ael_removesignal    ( lua_State *L );
+int  lt_ael_timerfd         ( lua_State *L );
+void t_ael_armtimerfd       ( struct t_ael *ael );
+void t_ael_lnx_free         ( lua_State *L, struct t_ael *ael );
+
+// t_ael_tsk.c      (task queue)
+int  t_ael_tsk_init         ( lua_State *L, struct t_ael *ael );
+void t_ael_tsk_free         ( lua_State *L, struct t_ael *ael );
+int  t_ael_post             ( struct t_ael *ael, t_ael_tfn fn, void *arg );
+void t_ael_stop             ( struct t_ael *ael );
+int  lt_ael_post            ( lua_State *L );
+
+// t_ael_wrk.c      (worker pool)
+void t_ael_wrk_free         ( lua_State *L, struct t_ael *ael );
+int  lt_ael_offload         ( lua_State *L );
+
+// t_ael_cor.c      (coroutines)
+void t_ael_resume           ( lua_State *L, int cR, int n );
+int  lt_ael_spawn           ( lua_State *L );
+int  lt_ael_sleep           ( lua_State *L );
+int  lt_ael_recv            ( lua_State *L );
+int  lt_ael_send            ( lua_State *L );
+int  lt_ael_accept          ( lua_State *L );
+int  lt_ael_registerpool    ( lua_State *L );
+
 
 // t_ael_(impl).c   (Implementation specific functions) INTERFACE
 void t_ael_create_ud_impl   ( struct t_ael *ael );
+void t_ael_free_impl        ( lua_State *L, struct t_ael *ael );
 void t_ael_addhandle_impl   ( struct t_ael *ael, int fd, enum t_ael_t t );
 void t_ael_removehandle_impl( struct t_ael *ael, int fd, enum t_ael_t t );
+int  t_ael_resize_impl      ( struct t_ael *ael, size_t sz );
 void t_ael_addtimer_impl    ( struct t_ael *ael, struct timeval *tv );
 int  t_ael_poll_impl        ( lua_State *L, struct t_ael *ael );
+int  t_ael_submit_impl      ( lua_State *L, struct t_ael *ael, enum t_ael_op op,
+                              int fd, void *b, size_t l, uint64_t ns );
+int  t_ael_register_impl    ( struct t_ael *ael, void *b, size_t l );
+
+#ifdef T_AEL_URING
+// t_ael_sel.c      (fallback of the io_uring implementation)
+void t_ael_create_ud_impl_sel   ( struct t_ael *ael );
+void t_ael_addhandle_impl_sel   ( struct t_ael *ael, int fd, enum t_ael_t t );
+void t_ael_removehandle_impl_sel( struct t_ael *ael, int fd, enum t_ael_t t );
+int  t_ael_resize_impl_sel      ( struct t_ael *ael, size_t sz );
+int  t_ael_poll_impl_sel        ( lua_State *L, struct t_ael *ael );
+#endif
 
 
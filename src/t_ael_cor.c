@@ -0,0 +1,470 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_cor.c
+ * \brief     Coroutine interface for T.Loop.
+ *            Functions spawned on the loop run as coroutines and can wait for
+ *            sockets or time in straight line code.  Waiting registers one-shot
+ *            interest which holds a reference to the coroutine only and yields
+ *            via lua_yieldk(); the operation itself happens in the continuation
+ *            once the loop resumes the coroutine.  Implementations based on
+ *            completions (io_uring) take the operation itself instead and
+ *            resume the coroutine with its result.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t.h"
+#include "t_ael.h"
+#include "t_buf.h"
+#include "t_tim.h"
+
+#include <stdint.h>           // intptr_t
+#include <errno.h>
+#include <sys/socket.h>       // send, setsockopt
+
+
+/// key of the weak keyed set of coroutines spawned by any loop
+static const char _spawned = 0;
+
+
+/**--------------------------------------------------------------------------
+ * Resume a coroutine held by a reference in LUA_REGISTRYINDEX.
+ * \detail  The reference gets released; a coroutine which waits again takes
+ *          a new one.  Errors inside the coroutine get raised on L, just like
+ *          errors in callbacks do.
+ * \param   L    The lua state.
+ * \param   int  reference of the coroutine.
+ * \param   int  number of arguments on the coroutines stack.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_resume( lua_State *L, int cR, int n )
+{
+	lua_State *co;
+	int        st;
+
+	lua_rawgeti( L, LUA_REGISTRYINDEX, cR );
+	co = lua_tothread( L, -1 );
+	luaL_unref( L, LUA_REGISTRYINDEX, cR );
+	st = lua_resume( co, L, n );
+	if (LUA_OK != st && LUA_YIELD != st)
+	{
+		lua_xmove( co, L, 1 );
+		lua_error( L );
+	}
+	if (LUA_OK == st)
+		lua_settop( co, 0 );
+	lua_pop( L, 1 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push the set of coroutines spawned by a loop.
+ * \detail  Keys are weak so a finished coroutine gets collected as usual.
+ * \param   L    The lua state.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_spawned( lua_State *L )
+{
+	if (LUA_TTABLE == lua_rawgetp( L, LUA_REGISTRYINDEX, &_spawned ))
+		return;
+	lua_pop( L, 1 );
+	lua_newtable( L );
+	lua_createtable( L, 0, 1 );
+	lua_pushliteral( L, "k" );
+	lua_setfield( L, -2, "__mode" );
+	lua_setmetatable( L, -2 );
+	lua_pushvalue( L, -1 );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &_spawned );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make sure a waiting function runs in a coroutine the loop can resume.
+ * \detail  Being yieldable isn't enough; a coroutine resumed by Lua code would
+ *          get the loops wakeup instead of the loop resuming it.
+ * \param   L    The lua state.
+ * \param   const char*  name of the calling method.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_checkyield( lua_State *L, const char *m )
+{
+	int sp = 0;
+
+	if (lua_isyieldable( L ))
+	{
+		t_ael_spawned( L );
+		lua_pushthread( L );
+		lua_rawget( L, -2 );
+		sp = lua_toboolean( L, -1 );
+		lua_pop( L, 2 );
+	}
+	if (! sp)
+		luaL_error( L, "T.Loop.%s() must be called from a coroutine spawned by the loop", m );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run a function as a coroutine driven by the T.Loop.
+ * \detail  The function runs until it waits for the first time.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  function to run.                                      // 2
+ * \lparam  ...      parameters to function.
+ * \lreturn thread   the coroutine.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_spawn( lua_State *L )
+{
+	int        n  = lua_gettop( L ) - 2;    ///< number of arguments
+	lua_State *co;
+
+	t_ael_check_ud( L, 1, 1 );
+	luaL_checktype( L, 2, LUA_TFUNCTION );
+	co = lua_newthread( L );
+	t_ael_spawned( L );
+	lua_pushvalue( L, -2 );
+	lua_pushboolean( L, 1 );
+	lua_rawset( L, -3 );
+	lua_pop( L, 1 );
+	lua_insert( L, 2 );
+	lua_xmove( L, co, n+1 );             // function and arguments
+	lua_pushvalue( L, 2 );
+	t_ael_resume( L, luaL_ref( L, LUA_REGISTRYINDEX ), n );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Continuation of sleep(); there is nothing to return.
+ * \param   L    The lua state.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_sleep_k( lua_State *L, int status, lua_KContext ctx )
+{
+	(void) L;
+	(void) status;
+	(void) ctx;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Suspend the running coroutine for a span of time.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  mixed    milliseconds or T.Time.                      // 2
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_sleep( lua_State *L )
+{
+	struct t_ael   *ael = t_ael_check_ud( L, 1, 1 );
+	struct timeval *tv  = t_tim_check_ud( L, 2, 0 );
+	lua_Number      ms;
+	uint64_t        ns;
+
+	t_ael_checkyield( L, "sleep" );
+	if (NULL != tv)
+		ns = t_tim_getns( tv );
+	else
+	{
+		ms = luaL_checknumber( L, 2 );
+		ns = (ms > 0) ? (uint64_t) (ms * 1000000) : 0;
+	}
+	if (t_ael_submit_impl( L, ael, T_AEL_OP_TMO, -1, NULL, 0, ns ) < 0)
+		t_ael_waittimer( L, ael, ns );
+	return lua_yieldk( L, 0, 0, &t_ael_sleep_k );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Continuation of recv(); the socket is readable now.
+ * \detail  Calls the sockets own recv() or recvfrom() with the original
+ *          arguments.
+ * \param   L    The lua state.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_recv_k( lua_State *L, int status, lua_KContext ctx )
+{
+	struct t_net *s = t_net_check_ud( L, 2, 1 );
+	int           n = lua_gettop( L );
+
+	(void) status;
+	(void) ctx;
+	lua_getfield( L, 2, (T_NET_UDP == s->t) ? "recvfrom" : "recv" );
+	lua_insert( L, 2 );
+	lua_call( L, n-1, LUA_MULTRET );
+	return lua_gettop( L ) - 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Continuation of a completed receive into a T.Buffer.
+ * \detail  Returns the same values as sock:recv( buffer ).
+ * \param   L    The lua state.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_recvd_k( lua_State *L, int status, lua_KContext ctx )
+{
+	struct t_buf *buf = t_buf_check_ud( L, 3, 1 );
+	lua_Integer   r   = lua_tointeger( L, -1 );
+
+	(void) status;
+	(void) ctx;
+	if (r < 0)
+	{
+		errno = (int) -r;
+		return t_push_error( L, "Failed to recieve TCP packet" );
+	}
+	lua_pushlstring( L, (const char *) buf->b, (size_t) r );
+	lua_pushinteger( L, r );
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Receive from a socket once it is readable.
+ * \detail  Returns the same values as sock:recv() for TCP and as
+ *          sock:recvfrom() for UDP sockets.  Receiving from TCP into a fixed
+ *          size or pool T.Buffer is handed to a completion based loop as a
+ *          whole.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  userdata T.Net.TCP or T.Net.UDP.                      // 2
+ * \lparam  ...      arguments to recv()/recvfrom().
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_recv( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_net *s   = t_net_check_ud( L, 2, 1 );
+	struct t_buf *buf = t_buf_check_ud( L, 3, 0 );
+
+	t_ael_checkyield( L, "recv" );
+	if (T_NET_TCP == s->t && 3 == lua_gettop( L ) && NULL != buf &&
+	    (T_BUF_FIX == buf->t || T_BUF_POL == buf->t) &&
+	    0 == t_ael_submit_impl( L, ael, T_AEL_OP_RCV, s->fd, buf->b, buf->len, 0 ))
+		return lua_yieldk( L, 0, 0, &t_ael_recvd_k );
+	t_ael_waithandle( L, ael, s->fd, T_AEL_RD );
+	return lua_yieldk( L, 0, 0, &t_ael_recv_k );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Continuation of send(); the socket is writable now.
+ * \detail  Sends without blocking as much as possible and waits again until
+ *          all data is sent.  ctx is the number of bytes sent so far.
+ * \param   L    The lua state.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_send_k( lua_State *L, int status, lua_KContext ctx )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_net *s   = t_net_check_ud( L, 2, 1 );
+	struct t_buf *buf = t_buf_check_ud( L, 3, 0 );
+	size_t        o   = (size_t) ctx;
+	size_t        len;
+	const char   *msg;
+	ssize_t       r;
+
+	(void) status;
+	if (NULL != buf)
+	{
+		msg = (const char *) t_buf_data( buf );
+		len = buf->len;
+	}
+	else
+		msg = luaL_checklstring( L, 3, &len );
+	while (o < len)
+	{
+		r = send( s->fd, msg + o, len - o, MSG_DONTWAIT | MSG_NOSIGNAL );
+		if (r < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+		{
+			t_ael_waithandle( L, ael, s->fd, T_AEL_WR );
+			return lua_yieldk( L, 0, (lua_KContext) o, &t_ael_send_k );
+		}
+		if (r < 0 && EINTR != errno)
+			return t_push_error( L, "Failed to send message" );
+		o += (r > 0) ? (size_t) r : 0;
+	}
+	lua_pushinteger( L, (lua_Integer) o );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Continuation of a completed send; sends the rest if it was partial.
+ * \detail  ctx is the number of bytes sent before the completed send.
+ * \param   L    The lua state.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_sent_k( lua_State *L, int status, lua_KContext ctx )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_net *s   = t_net_check_ud( L, 2, 1 );
+	size_t        len;
+	const char   *msg = t_buf_checklstring( L, 3, &len );
+	lua_Integer   r   = lua_tointeger( L, -1 );
+	size_t        o   = (size_t) ctx;
+
+	(void) status;
+	lua_pop( L, 1 );
+	if (r < 0)
+	{
+		errno = (int) -r;
+		return t_push_error( L, "Failed to send message" );
+	}
+	o += (size_t) r;
+	if (o < len)
+	{
+		t_ael_submit_impl( L, ael, T_AEL_OP_SND, s->fd, (void *) (msg + o), len - o, 0 );
+		return lua_yieldk( L, 0, (lua_KContext) o, &t_ael_sent_k );
+	}
+	lua_pushinteger( L, (lua_Integer) o );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Send all of a message over a TCP socket.
+ * \detail  Yields whenever the socket buffer is full.  A string or a fixed
+ *          size or pool T.Buffer is handed to a completion based loop as a
+ *          whole.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  userdata T.Net.TCP.                                   // 2
+ * \lparam  mixed    string or T.Buffer.                          // 3
+ * \lreturn integer  number of bytes sent.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_send( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_net *s   = t_net_tcp_check_ud( L, 2, 1 );
+	struct t_buf *buf = t_buf_check_ud( L, 3, 0 );
+	size_t        len;
+	const char   *msg = t_buf_checklstring( L, 3, &len );
+
+	t_ael_checkyield( L, "send" );
+	lua_settop( L, 3 );
+	// strings, inline and pool memory stay in place while the send is in flight
+	if (len > 0 && (NULL == buf || T_BUF_FIX == buf->t || T_BUF_POL == buf->t) &&
+	    0 == t_ael_submit_impl( L, ael, T_AEL_OP_SND, s->fd, (void *) msg, len, 0 ))
+		return lua_yieldk( L, 0, 0, &t_ael_sent_k );
+	return t_ael_send_k( L, LUA_OK, 0 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Continuation of accept(); the listening socket is readable now.
+ * \param   L    The lua state.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_accept_k( lua_State *L, int status, lua_KContext ctx )
+{
+	(void) status;
+	(void) ctx;
+	return t_net_tcp_accept( L, 2 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Continuation of a completed accept.
+ * \detail  The stack holds the new descriptor and the peers T.Net.IPv4.
+ * \param   L    The lua state.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_accepted_k( lua_State *L, int status, lua_KContext ctx )
+{
+	lua_Integer   r   = lua_tointeger( L, 3 );
+	size_t        one = 1;
+	struct t_net *cli;
+
+	(void) status;
+	(void) ctx;
+	if (r < 0)
+	{
+		errno = (int) -r;
+		return t_push_error( L, "couldn't accept from socket" );
+	}
+	cli     = t_net_create_ud( L, T_NET_TCP, 0 );
+	cli->fd = (int) r;
+	if (-1 == setsockopt( cli->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) ))
+		return t_push_error( L, "couldn't make client socket reusable" );
+	lua_pushvalue( L, 4 );
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Accept a connection on a listening TCP socket once there is one.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  userdata T.Net.TCP.                                   // 2
+ * \lreturn userdata T.Net.TCP for the new connection.
+ * \lreturn userdata T.Net.IPv4 of the peer.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_accept( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_net *s   = t_net_tcp_check_ud( L, 2, 1 );
+
+	t_ael_checkyield( L, "accept" );
+	lua_settop( L, 2 );
+	if (0 == t_ael_submit_impl( L, ael, T_AEL_OP_ACC, s->fd, NULL, 0, 0 ))
+		return lua_yieldk( L, 0, 0, &t_ael_accepted_k );
+	t_ael_waithandle( L, ael, s->fd, T_AEL_RD );
+	return lua_yieldk( L, 0, 0, &t_ael_accept_k );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Register the arena of a T.Buffer.Pool with the loop.
+ * \detail  Completion based loops receive into and send from buffers of a
+ *          registered pool without mapping their pages for each operation.
+ *          The pool is kept alive as long as the loop.  Register pools before
+ *          any operation is in flight.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  userdata T.Buffer.Pool.                               // 2
+ * \lreturn boolean  true if registered; false if the loop can't use it.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_registerpool( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_buf_pol *pl  = t_buf_pol_check_ud( L, 2, 1 );
+	int               r   = t_ael_register_impl( ael, pl->a, pl->sz * pl->n );
+
+	if (r < 0)
+		return t_push_error( L, "Failed to register T.Buffer.Pool" );
+	if (r > 0)
+	{
+		if (LUA_TTABLE != lua_getuservalue( L, 1 ))
+		{
+			lua_pop( L, 1 );
+			lua_newtable( L );
+			lua_pushvalue( L, -1 );
+			lua_setuservalue( L, 1 );
+		}
+		lua_pushvalue( L, 2 );
+		lua_pushboolean( L, 1 );
+		lua_rawset( L, -3 );
+	}
+	lua_pushboolean( L, r );
+	return 1;
+}
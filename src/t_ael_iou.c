@@ -0,0 +1,582 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_iou.c
+ * \brief     io_uring specific implementation for T.Loop.
+ *            Readiness of each observed handle is requested by a one-shot
+ *            POLL_ADD.  Changes of interest are only queued into the
+ *            submission ring and get submitted together with the wait for
+ *            completions, so a wakeup costs one io_uring_enter() no matter
+ *            how many handles were re-armed.  Completions get reaped in bulk.
+ *            Coroutines hand recv, send, accept and sleep to the ring as
+ *            operations and get resumed with their result.  Memory inside
+ *            the arena of a registered T.Buffer.Pool is received into and
+ *            sent from with READ_FIXED/WRITE_FIXED.
+ *            If the kernel doesn't support io_uring (or waiting with a
+ *            timeout) the loop falls back to the select() implementation.
+ *            Build with T_AEL_URING=1.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t.h"
+#include "t_ael.h"
+#include "t_tim.h"
+
+#include <stdlib.h>           // malloc, calloc, free
+#include <string.h>           // memset
+#include <errno.h>
+#include <poll.h>             // POLLIN, POLLOUT
+#include <unistd.h>           // syscall, close
+#include <sys/mman.h>         // mmap
+#include <sys/syscall.h>
+#include <sys/uio.h>          // struct iovec
+#include <sys/socket.h>       // MSG_NOSIGNAL
+#include <netinet/in.h>       // struct sockaddr_in
+#include <linux/io_uring.h>
+#include <linux/time_types.h> // struct __kernel_timespec
+
+#define T_AEL_IOU_SZ   256                 ///< number of submission entries
+#define T_AEL_IOU_IGN  ((uint64_t) 1 << 63) ///< user_data of POLL_REMOVE
+#define T_AEL_IOU_BUF  16                  ///< max number of registered arenas
+
+
+/// an operation in flight; its address is the user_data of the completion
+/// which leaves the T_AEL_RW bits of polls clear
+struct t_ael_iop {
+	enum t_ael_op            op;
+	int                      cR;    ///< coroutine to resume in LUA_REGISTRYINDEX
+	struct __kernel_timespec ts;    ///< span of T_AEL_OP_TMO
+	struct sockaddr_in       ip;    ///< peer of T_AEL_OP_ACC
+	socklen_t                il;
+	struct t_ael_iop        *prv;   ///< outstanding operations
+	struct t_ael_iop        *nxt;
+};
+
+
+/// the rings shared with the kernel
+struct t_ael_iou {
+	int                   fd;
+	unsigned             *sh;    ///< submission ring head
+	unsigned             *st;    ///< submission ring tail
+	unsigned             *sm;    ///< submission ring mask
+	unsigned             *sa;    ///< submission ring index array
+	struct io_uring_sqe  *sqe;
+	unsigned             *ch;    ///< completion ring head
+	unsigned             *ct;    ///< completion ring tail
+	unsigned             *cm;    ///< completion ring mask
+	struct io_uring_cqe  *cqe;
+	void                 *sp;    ///< mapped submission ring
+	size_t                ss;
+	void                 *cp;    ///< mapped completion ring
+	size_t                cs;
+	size_t                es;    ///< size of the mapped submission entries
+	unsigned              pnd;   ///< entries queued but not submitted yet
+	unsigned char        *arm;   ///< poll outstanding per fd (enum t_ael_t)
+	struct t_ael_iop     *op;    ///< operations in flight
+	struct iovec          rb[ T_AEL_IOU_BUF ];  ///< registered arenas
+	unsigned              nrb;
+};
+
+
+/**--------------------------------------------------------------------------
+ * Submit queued entries and optionally wait for completions.
+ * \param   struct t_ael_iou*  the ring.
+ * \param   unsigned           number of completions to wait for.
+ * \param   struct timespec*   maximum time to wait; NULL for indefinitely.
+ * \return  int  result of io_uring_enter().
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_iou_enter( struct t_ael_iou *iu, unsigned w, struct timespec *ts )
+{
+	struct io_uring_getevents_arg ga;
+	unsigned                      f = (w > 0) ? IORING_ENTER_GETEVENTS : 0;
+	int                           r;
+
+	memset( &ga, 0, sizeof( struct io_uring_getevents_arg ) );
+	if (NULL != ts)
+	{
+		ga.ts = (uint64_t) (uintptr_t) ts;
+		f    |= IORING_ENTER_EXT_ARG;
+	}
+	r = syscall( __NR_io_uring_enter, iu->fd, iu->pnd, w, f,
+	             (NULL != ts) ? (void *) &ga : NULL,
+	             (NULL != ts) ? sizeof( ga ) : 0 );
+	if (r > 0)
+		iu->pnd -= ((unsigned) r > iu->pnd) ? iu->pnd : (unsigned) r;
+	return r;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the next free submission entry.
+ * \detail  Submits the queued entries if the ring is full.
+ * \param   struct t_ael_iou*  the ring.
+ * \return  struct io_uring_sqe*  cleared entry.
+ * --------------------------------------------------------------------------*/
+static struct io_uring_sqe
+*t_ael_iou_sqe( struct t_ael_iou *iu )
+{
+	struct io_uring_sqe *sqe;
+	unsigned             t = *iu->st;
+
+	while (t - __atomic_load_n( iu->sh, __ATOMIC_ACQUIRE ) >= T_AEL_IOU_SZ)
+		t_ael_iou_enter( iu, 0, NULL );
+	sqe = &(iu->sqe[ t & *iu->sm ]);
+	memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+	iu->sa[ t & *iu->sm ] = t & *iu->sm;
+	__atomic_store_n( iu->st, t+1, __ATOMIC_RELEASE );
+	iu->pnd++;
+	return sqe;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Queue a one-shot poll for a handle unless there is one outstanding.
+ * \param   struct t_ael_iou*  the ring.
+ * \param   int                descriptor.
+ * \param   enum t_ael_t       read or write.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_iou_arm( struct t_ael_iou *iu, int fd, enum t_ael_t t )
+{
+	struct io_uring_sqe *sqe;
+
+	if (iu->arm[ fd ] & t)
+		return;
+	sqe                = t_ael_iou_sqe( iu );
+	sqe->opcode        = IORING_OP_POLL_ADD;
+	sqe->fd            = fd;
+	sqe->poll32_events = (T_AEL_RD == t) ? POLLIN : POLLOUT;
+	sqe->user_data     = ((uint64_t) fd << 2) | t;
+	iu->arm[ fd ]     |= t;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Release the io_uring of a loop.
+ * \detail  Closing the ring cancels the operations in flight.
+ * \param   struct t_ael*.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_iou_free( struct t_ael *ael )
+{
+	struct t_ael_iou *iu = ael->iou;
+
+	if (NULL == iu)
+		return;
+	if (NULL != iu->sqe && MAP_FAILED != (void *) iu->sqe)
+		munmap( iu->sqe, iu->es );
+	if (NULL != iu->cp && MAP_FAILED != iu->cp && iu->cp != iu->sp)
+		munmap( iu->cp, iu->cs );
+	if (NULL != iu->sp && MAP_FAILED != iu->sp)
+		munmap( iu->sp, iu->ss );
+	close( iu->fd );
+	free( iu->arm );
+	free( iu );
+	ael->iou = NULL;
+}
+
+
+/**--------------------------------------------------------------------------
+ * io_uring specific initialization of t_ael.
+ * \detail  Sets up the select() state as well to fall back to.
+ * \param   struct t_ael * pointer to new userdata on Lua Stack
+ * --------------------------------------------------------------------------*/
+void
+t_ael_create_ud_impl( struct t_ael *ael )
+{
+	struct io_uring_params  p;
+	struct t_ael_iou       *iu;
+	int                     fd;
+
+	t_ael_create_ud_impl_sel( ael );
+	ael->iou = NULL;
+	memset( &p, 0, sizeof( struct io_uring_params ) );
+	if ((fd = syscall( __NR_io_uring_setup, T_AEL_IOU_SZ, &p )) < 0)
+		return;
+	if (! (p.features & IORING_FEAT_EXT_ARG) ||
+	    NULL == (iu = (struct t_ael_iou *) calloc( 1, sizeof( struct t_ael_iou ) )))
+	{
+		close( fd );
+		return;
+	}
+	iu->fd = fd;
+	iu->ss = p.sq_off.array + p.sq_entries * sizeof( unsigned );
+	iu->cs = p.cq_off.cqes  + p.cq_entries * sizeof( struct io_uring_cqe );
+	iu->es = p.sq_entries * sizeof( struct io_uring_sqe );
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		iu->ss = iu->cs = (iu->cs > iu->ss) ? iu->cs : iu->ss;
+	iu->sp  = mmap( NULL, iu->ss, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                fd, IORING_OFF_SQ_RING );
+	iu->cp  = (p.features & IORING_FEAT_SINGLE_MMAP)
+		? iu->sp
+		: mmap( NULL, iu->cs, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		        fd, IORING_OFF_CQ_RING );
+	iu->sqe = (struct io_uring_sqe *) mmap( NULL, iu->es, PROT_READ | PROT_WRITE,
+	                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+	iu->arm = (unsigned char *) calloc( ael->fd_sz+1, 1 );
+	if (MAP_FAILED == iu->sp || MAP_FAILED == iu->cp ||
+	    MAP_FAILED == (void *) iu->sqe || NULL == iu->arm)
+	{
+		ael->iou = iu;
+		t_ael_iou_free( ael );
+		return;
+	}
+	iu->sh  = (unsigned *) ((char *) iu->sp + p.sq_off.head);
+	iu->st  = (unsigned *) ((char *) iu->sp + p.sq_off.tail);
+	iu->sm  = (unsigned *) ((char *) iu->sp + p.sq_off.ring_mask);
+	iu->sa  = (unsigned *) ((char *) iu->sp + p.sq_off.array);
+	iu->ch  = (unsigned *) ((char *) iu->cp + p.cq_off.head);
+	iu->ct  = (unsigned *) ((char *) iu->cp + p.cq_off.tail);
+	iu->cm  = (unsigned *) ((char *) iu->cp + p.cq_off.ring_mask);
+	iu->cqe = (struct io_uring_cqe *) ((char *) iu->cp + p.cq_off.cqes);
+	ael->iou = iu;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Release the io_uring of a loop and the operations which were in flight.
+ * \param   L              The lua state.
+ * \param   struct t_ael*.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_free_impl( lua_State *L, struct t_ael *ael )
+{
+	struct t_ael_iop *op, *nx;
+
+	if (NULL == ael->iou)
+		return;
+	op = ael->iou->op;
+	t_ael_iou_free( ael );
+	while (NULL != op)
+	{
+		nx = op->nxt;
+		luaL_unref( L, LUA_REGISTRYINDEX, op->cR );
+		free( op );
+		op = nx;
+	}
+	ael->op = 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Add a File/Socket event handler to the T.Loop.
+ * \param   struct t_ael*.
+ * \param   int          fd.
+ * \param   enum t_ael_t t - direction of socket to be observed.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_addhandle_impl( struct t_ael *ael, int fd, enum t_ael_t t )
+{
+	t_ael_addhandle_impl_sel( ael, fd, t );
+	if (NULL == ael->iou)
+		return;
+	if (t & T_AEL_RD)    t_ael_iou_arm( ael->iou, fd, T_AEL_RD );
+	if (t & T_AEL_WR)    t_ael_iou_arm( ael->iou, fd, T_AEL_WR );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make room for descriptors up to sz.
+ * \param   struct t_ael*.
+ * \param   size_t       highest descriptor to be observed.
+ * \return  int  0 on success, -1 on failure.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_resize_impl( struct t_ael *ael, size_t sz )
+{
+	unsigned char *a;
+
+	if (t_ael_resize_impl_sel( ael, sz ) < 0)
+		return -1;
+	if (NULL == ael->iou)
+		return 0;
+	if (NULL == (a = (unsigned char *) realloc( ael->iou->arm, sz+1 )))
+		return -1;
+	memset( a + ael->fd_sz+1, 0, sz - ael->fd_sz );
+	ael->iou->arm = a;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove a File/Socket event handler to the T.Loop.
+ * \detail  Outstanding polls get cancelled; their completion is ignored
+ *          unless the interest got renewed in the meantime.
+ * \param   struct t_ael*.
+ * \param   int          fd.
+ * \param   enum t_ael_t t - direction of socket to be observed.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_removehandle_impl( struct t_ael *ael, int fd, enum t_ael_t t )
+{
+	struct io_uring_sqe *sqe;
+	int                  d;
+
+	t_ael_removehandle_impl_sel( ael, fd, t );
+	if (NULL == ael->iou)
+		return;
+	for (d=T_AEL_RD; d<=T_AEL_WR; d<<=1)
+		if (t & d && ael->iou->arm[ fd ] & d)
+		{
+			sqe            = t_ael_iou_sqe( ael->iou );
+			sqe->opcode    = IORING_OP_POLL_REMOVE;
+			sqe->addr      = ((uint64_t) fd << 2) | d;
+			sqe->user_data = T_AEL_IOU_IGN;
+		}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Find the registered arena holding a range of memory.
+ * \param   struct t_ael_iou*  the ring.
+ * \param   void*              memory.
+ * \param   size_t             length of the memory.
+ * \return  int  index of the registered arena or -1 if there is none.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_iou_fixed( struct t_ael_iou *iu, void *b, size_t l )
+{
+	unsigned char *p = (unsigned char *) b;
+	unsigned char *a;
+	unsigned       i;
+
+	for (i=0; i<iu->nrb; i++)
+	{
+		a = (unsigned char *) iu->rb[ i ].iov_base;
+		if (p >= a && p + l <= a + iu->rb[ i ].iov_len)
+			return (int) i;
+	}
+	return -1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Queue an operation on behalf of the running coroutine.
+ * \detail  The coroutine has to yield afterwards.  Once the operation is
+ *          complete it gets resumed with the result, which is the return
+ *          value of the equivalent system call or -errno.  Accepting resumes
+ *          with the peers T.Net.IPv4 as second value.  Memory must stay in
+ *          place until the operation is complete.
+ * \param   L              The lua state.
+ * \param   struct t_ael*.
+ * \param   enum t_ael_op  operation.
+ * \param   int            descriptor.
+ * \param   void*          memory to receive into or send from.
+ * \param   size_t         length of the memory.
+ * \param   uint64_t       nanoseconds to wait for T_AEL_OP_TMO.
+ * \return  int  0 if queued; -1 if the loop runs on select().
+ * --------------------------------------------------------------------------*/
+int
+t_ael_submit_impl( lua_State *L, struct t_ael *ael, enum t_ael_op op,
+                   int fd, void *b, size_t l, uint64_t ns )
+{
+	struct t_ael_iou    *iu = ael->iou;
+	struct t_ael_iop    *io;
+	struct io_uring_sqe *sqe;
+	int                  x;
+
+	if (NULL == iu)
+		return -1;
+	if (NULL == (io = (struct t_ael_iop *) malloc( sizeof( struct t_ael_iop ) )))
+		return luaL_error( L, "Failed to allocate operation" );
+	io->op = op;
+	sqe    = t_ael_iou_sqe( iu );
+	sqe->fd = fd;
+	switch (op)
+	{
+		case T_AEL_OP_RCV:
+		case T_AEL_OP_SND:
+			sqe->addr = (uint64_t) (uintptr_t) b;
+			sqe->len  = (uint32_t) l;
+			if ((x = t_ael_iou_fixed( iu, b, l )) > -1)
+			{
+				sqe->opcode    = (T_AEL_OP_RCV == op) ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+				sqe->buf_index = (uint16_t) x;
+			}
+			else
+			{
+				sqe->opcode    = (T_AEL_OP_RCV == op) ? IORING_OP_RECV : IORING_OP_SEND;
+				sqe->msg_flags = (T_AEL_OP_SND == op) ? MSG_NOSIGNAL : 0;
+			}
+			break;
+		case T_AEL_OP_ACC:
+			io->il      = sizeof( struct sockaddr_in );
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->addr   = (uint64_t) (uintptr_t) &io->ip;
+			sqe->addr2  = (uint64_t) (uintptr_t) &io->il;
+			break;
+		case T_AEL_OP_TMO:
+			io->ts.tv_sec  = (long long) (ns / 1000000000);
+			io->ts.tv_nsec = (long long) (ns % 1000000000);
+			sqe->fd        = -1;
+			sqe->opcode    = IORING_OP_TIMEOUT;
+			sqe->addr      = (uint64_t) (uintptr_t) &io->ts;
+			sqe->len       = 1;
+			break;
+	}
+	sqe->user_data = (uint64_t) (uintptr_t) io;
+	lua_pushthread( L );
+	io->cR  = luaL_ref( L, LUA_REGISTRYINDEX );
+	io->prv = NULL;
+	io->nxt = iu->op;
+	if (NULL != iu->op)
+		iu->op->prv = io;
+	iu->op  = io;
+	ael->op++;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Register memory for READ_FIXED/WRITE_FIXED operations.
+ * \detail  The kernel only takes the whole table of registered memory at
+ *          once, so the table gets replaced.  Older kernels wait for all
+ *          requests in flight when doing that, hence registering fails with
+ *          EBUSY while operations are outstanding.
+ * \param   struct t_ael*.
+ * \param   void*          memory to register.
+ * \param   size_t         length of the memory.
+ * \return  int  1 if registered; 0 if the loop runs on select(); -1 on
+ *               failure with errno set.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_register_impl( struct t_ael *ael, void *b, size_t l )
+{
+	struct t_ael_iou *iu = ael->iou;
+	unsigned          i;
+	int               e;
+
+	if (NULL == iu)
+		return 0;
+	for (i=0; i<iu->nrb; i++)
+		if (b == iu->rb[ i ].iov_base)
+			return 1;
+	if (T_AEL_IOU_BUF == iu->nrb || NULL != iu->op)
+	{
+		errno = (NULL != iu->op) ? EBUSY : ENOBUFS;
+		return -1;
+	}
+	if (iu->nrb > 0)
+		syscall( __NR_io_uring_register, iu->fd, IORING_UNREGISTER_BUFFERS, NULL, 0 );
+	iu->rb[ iu->nrb ].iov_base = b;
+	iu->rb[ iu->nrb ].iov_len  = l;
+	if (syscall( __NR_io_uring_register, iu->fd, IORING_REGISTER_BUFFERS,
+	             iu->rb, iu->nrb + 1 ) < 0)
+	{
+		e = errno;
+		if (iu->nrb > 0)
+			syscall( __NR_io_uring_register, iu->fd, IORING_REGISTER_BUFFERS,
+			         iu->rb, iu->nrb );
+		errno = e;
+		return -1;
+	}
+	iu->nrb++;
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Resume the coroutine of a completed operation.
+ * \param   L                  The lua state.
+ * \param   struct t_ael*      the loop.
+ * \param   struct t_ael_iop*  the operation.
+ * \param   int                result of the operation.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_iou_complete( lua_State *L, struct t_ael *ael, struct t_ael_iop *io, int res )
+{
+	struct t_ael_iou   *iu = ael->iou;
+	struct sockaddr_in *ip;
+	lua_State          *co;
+	int                 cR = io->cR;
+	int                 n  = 1;
+
+	if (NULL != io->prv)
+		io->prv->nxt = io->nxt;
+	else
+		iu->op = io->nxt;
+	if (NULL != io->nxt)
+		io->nxt->prv = io->prv;
+	ael->op--;
+	// the reference keeps the coroutine alive until it is resumed
+	lua_rawgeti( L, LUA_REGISTRYINDEX, cR );
+	co = lua_tothread( L, -1 );
+	lua_pop( L, 1 );
+	// an expired timeout is what sleeping waits for
+	lua_pushinteger( co, (T_AEL_OP_TMO == io->op && -ETIME == res) ? 0 : res );
+	if (T_AEL_OP_ACC == io->op && res > -1)
+	{
+		ip  = t_net_ip4_create_ud( co );
+		*ip = io->ip;
+		n++;
+	}
+	free( io );
+	t_ael_resume( L, cR, n );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Submit queued polls, wait for completions and execute the ready handles.
+ * \detail  Completed operations resume their coroutines.
+ * \param   L              The lua state.
+ * \param   struct t_ael   The loop struct.
+ * \return  number of completions reaped; negative on failure.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_poll_impl( lua_State *L, struct t_ael *ael )
+{
+	struct t_ael_iou *iu = ael->iou;
+	struct timeval    to;
+	struct timeval   *tv;
+	struct timespec   ts;
+	uint64_t          ud;
+	int               res, fd, c = 0;
+	enum t_ael_t      t;
+	unsigned          h;
+
+	if (NULL == iu)
+		return t_ael_poll_impl_sel( L, ael );
+
+	ael->nw = t_tim_mono( );
+	if (NULL != (tv = t_ael_timeout( ael, &to )))
+	{
+		ts.tv_sec  = tv->tv_sec;
+		ts.tv_nsec = tv->tv_usec * 1000;
+	}
+	if (t_ael_iou_enter( iu, 1, (NULL != tv) ? &ts : NULL ) < 0 &&
+	    ETIME != errno && EINTR != errno)
+		return -1;
+	ael->nw = t_tim_mono( );
+
+	h = *iu->ch;
+	while (h != __atomic_load_n( iu->ct, __ATOMIC_ACQUIRE ))
+	{
+		ud  = iu->cqe[ h & *iu->cm ].user_data;
+		res = iu->cqe[ h & *iu->cm ].res;
+		__atomic_store_n( iu->ch, ++h, __ATOMIC_RELEASE );
+		if (T_AEL_IOU_IGN == ud)
+			continue;
+		c++;
+		if (0 == (ud & T_AEL_RW))
+		{
+			t_ael_iou_complete( L, ael, (struct t_ael_iop *) (uintptr_t) ud, res );
+			continue;
+		}
+		fd  = (int) (ud >> 2);
+		t   = (enum t_ael_t) (ud & T_AEL_RW);
+		iu->arm[ fd ] &= ~t;
+		if (NULL == ael->fd_set[ fd ] || ! (ael->fd_set[ fd ]->t & t))
+			continue;
+		// one-shot; re-arm before executing so an error raised by the
+		// callback doesn't lose the interest; removing the handle cancels it
+		t_ael_iou_arm( iu, fd, t );
+		if (res > 0)
+			t_ael_executehandle( L, ael, fd, t );
+	}
+	// deal with timers; handle traffic must not starve them
+	t_ael_executetimers( L, ael );
+
+	return c;
+}
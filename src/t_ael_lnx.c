@@ -0,0 +1,338 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_lnx.c
+ * \brief     Linux specific event sources for T.Loop.
+ *            Signals are delivered through a signalfd and timers can be driven
+ *            by a timerfd.  Both descriptors are registered as ordinary read
+ *            handles so they travel the same readiness path as sockets and
+ *            don't require any extra wakeups or async-signal-safe handlers.
+ *            On other platforms the methods raise an error.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t.h"
+#include "t_ael.h"
+
+#include <string.h>           // strcmp
+#include <unistd.h>           // read, close
+#ifdef __linux__
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+
+/// signals which can be addressed by name
+static const struct {
+	const char *n;
+	int         s;
+} t_ael_sig_names[] = {
+	{ "SIGHUP",   SIGHUP   },
+	{ "SIGINT",   SIGINT   },
+	{ "SIGQUIT",  SIGQUIT  },
+	{ "SIGUSR1",  SIGUSR1  },
+	{ "SIGUSR2",  SIGUSR2  },
+	{ "SIGPIPE",  SIGPIPE  },
+	{ "SIGALRM",  SIGALRM  },
+	{ "SIGTERM",  SIGTERM  },
+	{ "SIGCHLD",  SIGCHLD  },
+	{ "SIGWINCH", SIGWINCH },
+	{ NULL,       0        }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Get a signal number from a number or a name such as "SIGHUP" or "HUP".
+ * \param   L    The lua state.
+ * \param   int  stack position of the signal.
+ * \return  int  signal number.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_checksignal( lua_State *L, int pos )
+{
+	const char *n;
+	int         i;
+
+	if (LUA_TNUMBER == lua_type( L, pos ))
+	{
+		i = (int) luaL_checkinteger( L, pos );
+		luaL_argcheck( L, i > 0 && i < NSIG && SIGKILL != i && SIGSTOP != i,
+		               pos, "invalid signal" );
+		return i;
+	}
+	n = luaL_checkstring( L, pos );
+	for (i=0; NULL != t_ael_sig_names[ i ].n; i++)
+		if (0 == strcmp( n, t_ael_sig_names[ i ].n ) ||
+		    0 == strcmp( n, t_ael_sig_names[ i ].n + 3 ))
+			return t_ael_sig_names[ i ].s;
+	return luaL_argerror( L, pos, "unknown signal name" );
+}
+
+
+#ifdef __linux__
+/**--------------------------------------------------------------------------
+ * Read handler for the signalfd.
+ * \detail  Drains all pending signals and executes the function registered
+ *          for each of them as fn( ..., signal ).
+ * \param   L    The lua state.
+ * \lparam  lightuserdata  struct t_ael* of the loop.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_readsignal( lua_State *L )
+{
+	struct t_ael            *ael = (struct t_ael *) lua_touserdata( L, 1 );
+	struct signalfd_siginfo  si[ 8 ];
+	ssize_t                  r;
+	int                      i, j, n;
+
+	while ((r = read( ael->sfd, si, sizeof( si ) )) > 0)
+		for (i=0; i < r / (ssize_t) sizeof( struct signalfd_siginfo ); i++)
+		{
+			lua_rawgeti( L, LUA_REGISTRYINDEX, ael->gR );
+			if (LUA_TTABLE != lua_rawgeti( L, -1, si[ i ].ssi_signo ))
+			{
+				lua_pop( L, 2 );
+				continue;
+			}
+			n = lua_rawlen( L, -1 );
+			for (j=0; j<n; j++)
+				lua_rawgeti( L, -1-j, j+1 );
+			lua_pushinteger( L, si[ i ].ssi_signo );
+			lua_call( L, n, 0 );
+			lua_pop( L, 2 );
+		}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read handler for the timerfd.
+ * \detail  Only consumes the expiration; due timers get executed after the
+ *          handles of each wakeup anyways.
+ * \param   L    The lua state.
+ * \lparam  lightuserdata  struct t_ael* of the loop.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_readtimer( lua_State *L )
+{
+	struct t_ael *ael = (struct t_ael *) lua_touserdata( L, 1 );
+	uint64_t      x;
+
+	ael->tdl = 0;
+	while (read( ael->tfd, &x, sizeof( x ) ) > 0);
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Register a descriptor owned by the loop with a C read handler.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * \param   int            descriptor.
+ * \param   lua_CFunction  the read handler.
+ * \return  int  0 on success, -1 if the loop can't hold the descriptor.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_addinternal( lua_State *L, struct t_ael *ael, int fd, lua_CFunction f )
+{
+	lua_pushnil( L );                  // no handle; the loop owns the fd
+	lua_createtable( L, 2, 0 );
+	lua_pushcfunction( L, f );
+	lua_rawseti( L, -2, 1 );
+	lua_pushlightuserdata( L, ael );
+	lua_rawseti( L, -2, 2 );
+	if (t_ael_sethandle( L, ael, fd, T_AEL_RD ) < 0)
+		return -1;
+	ael->nin++;
+	return 0;
+}
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Arm the timerfd for the first timer in the list.
+ * \detail  Only touches the timerfd if the head deadline has changed since it
+ *          was armed last.
+ * \param   struct t_ael*  the loop.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_armtimerfd( struct t_ael *ael )
+{
+#ifdef __linux__
+	struct itimerspec its;
+	uint64_t          dl = (NULL == ael->tm_head) ? 0 : ael->tm_head->dl;
+
+	if (dl == ael->tdl)
+		return;
+	memset( &its, 0, sizeof( struct itimerspec ) );
+	// a zero it_value would disarm a timer which is due right now
+	dl = (NULL != ael->tm_head && 0 == dl) ? 1 : dl;
+	its.it_value.tv_sec  = dl / 1000000000;
+	its.it_value.tv_nsec = dl % 1000000000;
+	timerfd_settime( ael->tfd, TFD_TIMER_ABSTIME, &its, NULL );
+	ael->tdl = dl;
+#else
+	(void) ael;
+#endif
+}
+
+
+/**--------------------------------------------------------------------------
+ * Add a signal handler to the T.Loop.
+ * \detail  The signal gets blocked for the process and delivered through a
+ *          signalfd.  Adding a signal again replaces the function.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  mixed    signal number or name such as "SIGHUP".      // 2
+ * \lparam  function executed as fn( ..., signal ) when raised.   // 3
+ * \lparam  ...      parameters to function when executed.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_addsignal( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	int           sig = t_ael_checksignal( L, 2 );
+#ifdef __linux__
+	int           n   = lua_gettop( L ) + 1;    ///< iterator for arguments
+	sigset_t      ms;
+
+	luaL_checktype( L, 3, LUA_TFUNCTION );
+	sigemptyset( &ms );
+	sigaddset( &ms, sig );
+	sigaddset( &ael->sms, sig );
+	if (sigprocmask( SIG_BLOCK, &ms, NULL ) < 0 ||
+	    (ael->sfd = signalfd( ael->sfd, &ael->sms, SFD_NONBLOCK | SFD_CLOEXEC )) < 0)
+	{
+		sigdelset( &ael->sms, sig );
+		return t_push_error( L, "Failed to observe signal %d", sig );
+	}
+	if (LUA_NOREF == ael->gR)
+	{
+		lua_newtable( L );
+		ael->gR = luaL_ref( L, LUA_REGISTRYINDEX );
+	}
+	if (((size_t) ael->sfd > ael->fd_sz || NULL == ael->fd_set[ ael->sfd ]) &&
+	    t_ael_addinternal( L, ael, ael->sfd, &t_ael_readsignal ) < 0)
+	{
+		sigdelset( &ael->sms, sig );
+		return t_push_error( L, "Failed to observe signal %d", sig );
+	}
+
+	lua_rawgeti( L, LUA_REGISTRYINDEX, ael->gR );
+	lua_createtable( L, n-3, 0 );  // create function/parameter table
+	lua_insert( L, 3 );
+	// Stack: ael,sig,TABLE,func,...,signals
+	lua_insert( L, 3 );
+	// Stack: ael,sig,signals,TABLE,func,...
+	while (n > 3)
+		lua_rawseti( L, 4, (n--)-3 );   // add arguments and function (pops each item)
+	lua_rawseti( L, 3, sig );
+	return 0;
+#else
+	(void) ael;
+	return luaL_error( L, "addSignal() is not supported on this platform (signal %d)", sig );
+#endif
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove a signal handler from the T.Loop.
+ * \detail  Unblocks the signal, which restores its default disposition.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  mixed    signal number or name such as "SIGHUP".      // 2
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_removesignal( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	int           sig = t_ael_checksignal( L, 2 );
+	sigset_t      ms;
+
+	if (! sigismember( &ael->sms, sig ))
+		return 0;
+	sigdelset( &ael->sms, sig );
+	lua_rawgeti( L, LUA_REGISTRYINDEX, ael->gR );
+	lua_pushnil( L );
+	lua_rawseti( L, -2, sig );
+#ifdef __linux__
+	signalfd( ael->sfd, &ael->sms, 0 );
+#endif
+	sigemptyset( &ms );
+	sigaddset( &ms, sig );
+	sigprocmask( SIG_UNBLOCK, &ms, NULL );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drive the timers of the T.Loop by a timerfd instead of the poll timeout.
+ * \detail  The timerfd is armed for the absolute monotonic deadline in
+ *          nanosecond resolution whereas the poll timeout is relative and
+ *          limited to what the backend accepts.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  boolean  enable or disable.                           // 2
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_timerfd( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	int           on  = lua_toboolean( L, 2 );
+
+	if (on && ael->tfd < 0)
+	{
+#ifdef __linux__
+		ael->tfd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+		if (ael->tfd < 0)
+			return t_push_error( L, "Failed to create timerfd" );
+		ael->tdl = 0;
+		if (t_ael_addinternal( L, ael, ael->tfd, &t_ael_readtimer ) < 0)
+		{
+			close( ael->tfd );
+			ael->tfd = -1;
+			return t_push_error( L, "Failed to observe timerfd" );
+		}
+#else
+		return luaL_error( L, "timerFd() is not supported on this platform" );
+#endif
+	}
+	else if (! on && ael->tfd > -1)
+	{
+		t_ael_clearhandle( L, ael, ael->tfd, T_AEL_RD );
+		ael->nin--;
+		close( ael->tfd );
+		ael->tfd = -1;
+	}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Release the signalfd and the timerfd of a loop.
+ * \detail  Signals observed by the loop get unblocked again.  The handles
+ *          themselves are released with all other handles of the loop.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_lnx_free( lua_State *L, struct t_ael *ael )
+{
+	if (ael->sfd > -1)
+	{
+		sigprocmask( SIG_UNBLOCK, &ael->sms, NULL );
+		close( ael->sfd );
+	}
+	if (ael->tfd > -1)
+		close( ael->tfd );
+	luaL_unref( L, LUA_REGISTRYINDEX, ael->gR );
+	ael->sfd = -1;
+	ael->tfd = -1;
+	ael->gR  = LUA_NOREF;
+}
@@ -15,10 +15,16 @@
 
 #include "t.h"
 #include "t_ael.h"
+#include "t_tim.h"
 
 #include <string.h>           // memcpy
-#ifndef _WIN32
-#include <sys/time.h>         // gettimeofday
+#include <errno.h>            // errno, EMFILE
+
+// the io_uring implementation owns the interface and falls back to select()
+#ifdef T_AEL_URING
+#define T_AEL_SEL( fn )  fn##_sel
+#else
+#define T_AEL_SEL( fn )  fn
 #endif
 
 
@@ -28,7 +34,7 @@
  * \return  void
  * --------------------------------------------------------------------------*/
 void
-t_ael_create_ud_impl( struct t_ael *ael )
+T_AEL_SEL( t_ael_create_ud_impl )( struct t_ael *ael )
 {
 	FD_ZERO( &ael->rfds );
 	FD_ZERO( &ael->wfds );
@@ -44,7 +50,7 @@ t_ael_create_ud_impl( struct t_ael *ael )
  * \param   enum t_ael_t t - direction of socket to be observed.
  * --------------------------------------------------------------------------*/
 void
-t_ael_addhandle_impl( struct t_ael *ael, int fd, enum t_ael_t t )
+T_AEL_SEL( t_ael_addhandle_impl )( struct t_ael *ael, int fd, enum t_ael_t t )
 {
 	if (t & T_AEL_RD)    FD_SET( fd, &ael->rfds );
 	if (t & T_AEL_WR)    FD_SET( fd, &ael->wfds );
@@ -58,13 +64,31 @@ t_ael_addhandle_impl( struct t_ael *ael, int fd, enum t_ael_t t )
  * \param   enum t_ael_t t - direction of socket to be observed.
  * --------------------------------------------------------------------------*/
 void
-t_ael_removehandle_impl( struct t_ael *ael, int fd, enum t_ael_t t )
+T_AEL_SEL( t_ael_removehandle_impl )( struct t_ael *ael, int fd, enum t_ael_t t )
 {
 	if (t & T_AEL_RD)    FD_CLR( fd, &ael->rfds );
 	if (t & T_AEL_WR)    FD_CLR( fd, &ael->wfds );
 }
 
 
+/**--------------------------------------------------------------------------
+ * Make room for descriptors up to sz.
+ * \detail  The fd_set of select() is fixed at FD_SETSIZE descriptors.
+ * \param   struct t_ael*.
+ * \param   size_t       highest descriptor to be observed.
+ * \return  int  0 on success, -1 if select() can't observe that many.
+ * --------------------------------------------------------------------------*/
+int
+T_AEL_SEL( t_ael_resize_impl )( struct t_ael *ael, size_t sz )
+{
+	(void) ael;
+	if (sz < FD_SETSIZE)
+		return 0;
+	errno = EMFILE;
+	return -1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Add an Timer event handler to the T.Loop.
  * \param   L        The lua state.
@@ -80,6 +104,64 @@ t_ael_removehandle_impl( struct t_ael *ael, int fd, enum t_ael_t t )
 //}
 
 
+#ifndef T_AEL_URING
+/**--------------------------------------------------------------------------
+ * Select() has no state to release.
+ * \param   L              The lua state.
+ * \param   struct t_ael*.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_free_impl( lua_State *L, struct t_ael *ael )
+{
+	(void) L;
+	(void) ael;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Select() only reports readiness; operations are done by the caller.
+ * \param   L              The lua state.
+ * \param   struct t_ael*.
+ * \param   enum t_ael_op  operation.
+ * \param   int            descriptor.
+ * \param   void*          memory to receive into or send from.
+ * \param   size_t         length of the memory.
+ * \param   uint64_t       nanoseconds to wait for T_AEL_OP_TMO.
+ * \return  int  -1; the caller has to wait for readiness instead.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_submit_impl( lua_State *L, struct t_ael *ael, enum t_ael_op op,
+                   int fd, void *b, size_t l, uint64_t ns )
+{
+	(void) L;
+	(void) ael;
+	(void) op;
+	(void) fd;
+	(void) b;
+	(void) l;
+	(void) ns;
+	return -1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Select() has no use for registered memory.
+ * \param   struct t_ael*.
+ * \param   void*          memory to register.
+ * \param   size_t         length of the memory.
+ * \return  int  0; nothing got registered.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_register_impl( struct t_ael *ael, void *b, size_t l )
+{
+	(void) ael;
+	(void) b;
+	(void) l;
+	return 0;
+}
+#endif
+
+
 /**--------------------------------------------------------------------------
  * Set up a select call for all events in the T.Loop
  * \param   L              The lua state.
@@ -87,15 +169,15 @@ t_ael_removehandle_impl( struct t_ael *ael, int fd, enum t_ael_t t )
  * \return  number returns from select.
  * --------------------------------------------------------------------------*/
 int
-t_ael_poll_impl( lua_State *L, struct t_ael *ael )
+T_AEL_SEL( t_ael_poll_impl )( lua_State *L, struct t_ael *ael )
 {
 	int              i,r;
+	struct timeval   to;           ///< select() may modify the timeout
 	struct timeval  *tv;
-	struct timeval   rt;           ///< timer to calculate runtime over this poll
 	enum t_ael_t     t;            ///< handle action per fd (read/write/either)
 
-	gettimeofday( &rt, 0 );
-	tv  = (NULL != ael->tm_head) ? ael->tm_head->tv : NULL;
+	ael->nw = t_tim_mono( );
+	tv      = t_ael_timeout( ael, &to );
 
 	memcpy( &ael->rfds_w, &ael->rfds, sizeof( fd_set ) );
 	memcpy( &ael->wfds_w, &ael->wfds, sizeof( fd_set ) );
@@ -105,25 +187,25 @@ t_ael_poll_impl( lua_State *L, struct t_ael *ael )
 	if (r<0)
 		return r;
 
-	if (0==r) // deal with timer
-		t_ael_executetimer( L, ael, &rt );
-	else      // deal with sockets/file handles
-		for( i=0; r>0 && i <= ael->max_fd; i++ )
+	ael->nw = t_tim_mono( );
+	// deal with sockets/file handles
+	for( i=0; r>0 && i <= ael->max_fd; i++ )
+	{
+		if (NULL == ael->fd_set[ i ])
+			continue;
+		t = T_AEL_NO;
+		if (ael->fd_set[ i ]->t & T_AEL_RD  &&  FD_ISSET( i, &ael->rfds_w ))
+			t |= T_AEL_RD;
+		if (ael->fd_set[ i ]->t & T_AEL_WR  &&  FD_ISSET( i, &ael->wfds_w ))
+			t |= T_AEL_WR;
+		if (T_AEL_NO != t)
 		{
-			if (NULL == ael->fd_set[ i ])
-				continue;
-			t = T_AEL_NO;
-			if (ael->fd_set[ i ]->t & T_AEL_RD  &&  FD_ISSET( i, &ael->rfds_w ))
-				t |= T_AEL_RD;
-			if (ael->fd_set[ i ]->t & T_AEL_WR  &&  FD_ISSET( i, &ael->wfds_w ))
-				t |= T_AEL_WR;
-			if (T_AEL_NO != t)
-			{
-				t_ael_executehandle( L, ael, i, t );
-				r--;
-			}
+			t_ael_executehandle( L, ael, i, t );
+			r--;
 		}
+	}
+	// deal with timers; handle traffic must not starve them
+	t_ael_executetimers( L, ael );
 
 	return r;
 }
-
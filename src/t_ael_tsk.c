@@ -0,0 +1,282 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_tsk.c
+ * \brief     Task queue for T.Loop.
+ *            Any thread can hand C tasks to a running loop.  The queue is a
+ *            lock-free multi producer/single consumer stack which the loop
+ *            swaps out as a whole and executes in posting order.  An eventfd
+ *            (a pipe where eventfd is not available) is registered as a read
+ *            handle on the loop and only gets signalled when the queue goes
+ *            from empty to non-empty, so a batch of tasks costs one wakeup.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t.h"
+#include "t_ael.h"
+
+#include <stdlib.h>           // malloc, free
+#include <stdint.h>           // intptr_t
+#include <unistd.h>           // read, write, close
+#include <fcntl.h>            // fcntl
+#include <errno.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Signal the loop that there is work.
+ * \param   struct t_ael*  the loop.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_wake( struct t_ael *ael )
+{
+	uint64_t x = 1;
+	ssize_t  r;
+
+	do
+		r = write( ael->qfd[ 1 ], &x, sizeof( x ) );
+	while (r < 0 && EINTR == errno);
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute a single task in protected mode.
+ * \param   L    The lua state.
+ * \lparam  lightuserdata  struct t_ael_tsk* to execute.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_runtask( lua_State *L )
+{
+	struct t_ael_tsk *tk = (struct t_ael_tsk *) lua_touserdata( L, 1 );
+
+	tk->fn( L, tk->arg, 1 );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute all queued tasks.
+ * \detail  Read handler of the queues descriptor.  Takes the whole stack at
+ *          once and reverses it so tasks run in the order they were posted.
+ *          Tasks posted while executing are picked up by the next wakeup.
+ *          Each task runs protected so a failing task doesn't leak the rest
+ *          of the detached batch; the first error gets re-raised after the
+ *          batch is drained.
+ * \param   L    The lua state.
+ * \lparam  lightuserdata  struct t_ael* of the loop.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_runtasks( lua_State *L )
+{
+	struct t_ael     *ael = (struct t_ael *) lua_touserdata( L, 1 );
+	struct t_ael_tsk *tk, *nx, *rv = NULL;
+	uint64_t          x;
+	int               e   = 0;         ///< got an error; it's on top of stack
+
+	// reset the descriptor before taking the queue; a task posted after the
+	// exchange finds the queue empty and signals again
+	while (read( ael->qfd[ 0 ], &x, sizeof( x ) ) > 0);
+	tk = __atomic_exchange_n( &ael->tq, NULL, __ATOMIC_ACQUIRE );
+	while (NULL != tk)
+	{
+		nx      = tk->nxt;
+		tk->nxt = rv;
+		rv      = tk;
+		tk      = nx;
+	}
+	while (NULL != rv)
+	{
+		nx = rv->nxt;
+		lua_pushcfunction( L, &t_ael_runtask );
+		lua_pushlightuserdata( L, rv );
+		if (LUA_OK != lua_pcall( L, 1, 0, 0 ))
+		{
+			if (e)
+				lua_pop( L, 1 );        // keep the first error only
+			e = 1;
+		}
+		free( rv );
+		rv = nx;
+	}
+	return (e) ? lua_error( L ) : 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create the queues descriptor and register it on the loop.
+ * \detail  Must be called from the loops thread before the loop is handed to
+ *          any other thread which might post to it.  Calling it again is a
+ *          no-op.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * \return  int  0 on success, -1 on failure.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_tsk_init( lua_State *L, struct t_ael *ael )
+{
+	if (ael->qfd[ 0 ] > -1)
+		return 0;
+#ifdef __linux__
+	ael->qfd[ 0 ] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	if (ael->qfd[ 0 ] < 0)
+		return -1;
+	ael->qfd[ 1 ] = ael->qfd[ 0 ];
+#else
+	if (pipe( ael->qfd ) < 0)
+		return -1;
+	fcntl( ael->qfd[ 0 ], F_SETFL, O_NONBLOCK );
+	fcntl( ael->qfd[ 1 ], F_SETFL, O_NONBLOCK );
+#endif
+	lua_pushnil( L );                  // no handle; the loop owns the fd
+	lua_createtable( L, 2, 0 );
+	lua_pushcfunction( L, &t_ael_runtasks );
+	lua_rawseti( L, -2, 1 );
+	lua_pushlightuserdata( L, ael );
+	lua_rawseti( L, -2, 2 );
+	if (t_ael_sethandle( L, ael, ael->qfd[ 0 ], T_AEL_RD ) < 0)
+	{
+		close( ael->qfd[ 0 ] );
+		if (ael->qfd[ 1 ] != ael->qfd[ 0 ])
+			close( ael->qfd[ 1 ] );
+		ael->qfd[ 0 ] = -1;
+		ael->qfd[ 1 ] = -1;
+		return -1;
+	}
+	ael->nin++;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Post a task to the loop.
+ * \detail  Safe to call from any thread once t_ael_tsk_init() has been run.
+ *          fn( L, arg, 1 ) gets executed on the loops thread during one of the
+ *          next wakeups.  If the loop gets collected before the task ran it
+ *          is called as fn( L, arg, 0 ) to release arg only.
+ * \param   struct t_ael*  the loop.
+ * \param   t_ael_tfn      function to execute.
+ * \param   void*          argument passed to the function.
+ * \return  int  0 on success, -1 on failure.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_post( struct t_ael *ael, t_ael_tfn fn, void *arg )
+{
+	struct t_ael_tsk *tk = (struct t_ael_tsk *) malloc( sizeof( struct t_ael_tsk ) );
+
+	if (NULL == tk)
+		return -1;
+	tk->fn  = fn;
+	tk->arg = arg;
+	tk->nxt = __atomic_load_n( &ael->tq, __ATOMIC_RELAXED );
+	while (! __atomic_compare_exchange_n( &ael->tq, &tk->nxt, tk, 1,
+	                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED ));
+	if (NULL == tk->nxt)
+		t_ael_wake( ael );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Stop the loop.
+ * \detail  Safe to call from any thread.  If the loop has a task queue it gets
+ *          woken up so it doesn't wait for the next event to notice.
+ * \param   struct t_ael*  the loop.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_stop( struct t_ael *ael )
+{
+	__atomic_store_n( &ael->run, 0, __ATOMIC_RELEASE );
+	if (ael->qfd[ 1 ] > -1)
+		t_ael_wake( ael );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Task calling a Lua function posted by loop:post().
+ * \param   L    The lua state.
+ * \param   void*  registry reference of the func/arg table.
+ * \param   int    execute or only release.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_calltask( lua_State *L, void *arg, int run )
+{
+	int r = (int) (intptr_t) arg;
+	int j, n;
+
+	if (run)
+		lua_rawgeti( L, LUA_REGISTRYINDEX, r );
+	// release before calling; the function might raise an error
+	luaL_unref( L, LUA_REGISTRYINDEX, r );
+	if (run)
+	{
+		n = lua_rawlen( L, -1 );
+		for (j=0; j<n; j++)
+			lua_rawgeti( L, -1-j, j+1 );
+		lua_call( L, n-1, 0 );
+		lua_pop( L, 1 );
+	}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute a function on one of the next wakeups of the T.Loop.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  function to be executed.                              // 2
+ * \lparam  ...      parameters to function when executed.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_post( lua_State *L )
+{
+	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
+	int           n   = lua_gettop( L ) + 1;    ///< iterator for arguments
+	int           r;
+
+	luaL_checktype( L, 2, LUA_TFUNCTION );
+	if (t_ael_tsk_init( L, ael ) < 0)
+		return t_push_error( L, "Failed to create task queue" );
+	lua_createtable( L, n-2, 0 );  // create function/parameter table
+	lua_insert( L, 2 );
+	while (n > 2)
+		lua_rawseti( L, 2, (n--)-2 );   // add arguments and function (pops each item)
+	r = luaL_ref( L, LUA_REGISTRYINDEX );
+	if (t_ael_post( ael, &t_ael_calltask, (void *) (intptr_t) r ) < 0)
+	{
+		luaL_unref( L, LUA_REGISTRYINDEX, r );
+		return t_push_error( L, "Failed to post task" );
+	}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Release the task queue of a loop.
+ * \detail  Tasks which didn't run yet are only released.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_tsk_free( lua_State *L, struct t_ael *ael )
+{
+	struct t_ael_tsk *nx, *tk = __atomic_exchange_n( &ael->tq, NULL, __ATOMIC_ACQUIRE );
+
+	while (NULL != tk)
+	{
+		nx = tk->nxt;
+		tk->fn( L, tk->arg, 0 );
+		free( tk );
+		tk = nx;
+	}
+	if (ael->qfd[ 0 ] > -1)
+		close( ael->qfd[ 0 ] );
+	if (ael->qfd[ 1 ] > -1 && ael->qfd[ 1 ] != ael->qfd[ 0 ])
+		close( ael->qfd[ 1 ] );
+	ael->qfd[ 0 ] = -1;
+	ael->qfd[ 1 ] = -1;
+}
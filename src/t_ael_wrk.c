@@ -0,0 +1,593 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_wrk.c
+ * \brief     Worker pool for T.Loop.
+ *            Blocking or CPU heavy jobs get handed to a fixed number of
+ *            threads owned by the loop.  Only a fixed set of C jobs can be
+ *            offloaded; the workers never touch the Lua state.  Inputs are
+ *            copied into the job, a T.Buffer to read into is anchored in the
+ *            registry while the job is in flight and finished jobs travel
+ *            back through the loops task queue where the Lua callback gets
+ *            executed.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t.h"
+#include "t_ael.h"
+#include "t_buf.h"
+#include "t_enc.h"
+
+#include <stdlib.h>           // malloc, free
+#include <string.h>           // memcpy, strerror
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>           // pthread_sigmask
+#include <fcntl.h>            // open
+#include <unistd.h>           // read, write, pread, close
+#include <sys/stat.h>         // fstat
+#include <netdb.h>            // getaddrinfo
+#include <crypt.h>            // crypt_r
+
+
+/// jobs which can be offloaded to the workers
+enum t_ael_job_t {
+	T_AEL_JOB_RD,           ///< read a file into a string or T.Buffer
+	T_AEL_JOB_WR,           ///< write a string or T.Buffer to a file
+	T_AEL_JOB_CRY,          ///< crypt() a password
+	T_AEL_JOB_B6E,          ///< Base64 encode
+	T_AEL_JOB_B6D,          ///< Base64 decode
+	T_AEL_JOB_RSV,          ///< resolve a host name to IPv4 addresses
+	T_AEL_JOB_CRC,          ///< CRC checksum with a T.Encode.Crc
+};
+
+static const char *const t_ael_job_lst[] = {
+	"read",
+	"write",
+	"crypt",
+	"b64encode",
+	"b64decode",
+	"resolve",
+	"crc",
+	NULL
+};
+
+
+/// a job in flight
+struct t_ael_job {
+	enum t_ael_job_t   t;     ///< kind of job
+	struct t_ael      *ael;   ///< loop to complete on
+	int                fR;    ///< callback reference in LUA_REGISTRYINDEX
+	int                aR;    ///< T.Buffer read into; in LUA_REGISTRYINDEX
+	const char        *a1;    ///< first input (path, data, password, host)
+	size_t             l1;
+	const char        *a2;    ///< second input (data, salt, CRC state)
+	size_t             l2;
+	unsigned char     *b;     ///< fixed T.Buffer memory to read into
+	size_t             bl;
+	long               o;     ///< offset, append flag, port or checksum
+	char              *r;     ///< result produced by the worker
+	size_t             rl;
+	ssize_t            n;     ///< numeric result; < 0 on failure
+	int                err;   ///< errno of a failed job
+	const char        *es;    ///< error message of a failed job if not errno
+	struct t_ael_job  *nxt;   ///< next pointer for linked list
+};
+
+
+/// the pool; jobs get queued FIFO under the mutex
+struct t_ael_wrk {
+	pthread_mutex_t    mx;
+	pthread_cond_t     cv;
+	struct t_ael_job  *hd;    ///< next job to run
+	struct t_ael_job  *tl;    ///< last job queued
+	int                stp;   ///< boolean indicator to stop the workers
+	int                n;     ///< number of threads
+	pthread_t          th[ T_AEL_WRK ];
+};
+
+
+/**--------------------------------------------------------------------------
+ * Read a file into the T.Buffer of the job or into a new string.
+ * \param   struct t_ael_job*  the job.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_job_read( struct t_ael_job *jb )
+{
+	struct stat st;
+	ssize_t     r  = 0;
+	size_t      sz;
+	char       *g;            ///< grown result
+	int         fd = open( jb->a1, O_RDONLY | O_CLOEXEC );
+
+	if (fd < 0)
+		goto fail;
+	if (NULL != jb->b)
+	{
+		for (jb->n=0; (size_t) jb->n < jb->bl; jb->n += r)
+			if ((r = pread( fd, jb->b + jb->n, jb->bl - jb->n, jb->o + jb->n )) <= 0)
+				break;
+	}
+	else
+	{
+		if (fstat( fd, &st ) < 0)
+			goto fail;
+		// files in /proc and alike claim a size of 0
+		sz    = (st.st_size > 0) ? (size_t) st.st_size : 4096;
+		jb->r = (char *) malloc( sz );
+		for (jb->rl=0; NULL != jb->r; jb->rl += r)
+		{
+			if (jb->rl == sz)
+			{
+				if (NULL == (g = (char *) realloc( jb->r, (sz *= 2) )))
+					free( jb->r );
+				jb->r = g;
+			}
+			if (NULL == jb->r || (r = read( fd, jb->r + jb->rl, sz - jb->rl )) <= 0)
+				break;
+		}
+		if (NULL == jb->r)
+			errno = ENOMEM;
+		jb->n = (NULL == jb->r) ? -1 : (ssize_t) jb->rl;
+	}
+	if (r < 0 && (NULL == jb->b || 0 == jb->n))
+		goto fail;
+	close( fd );
+	return;
+fail:
+	jb->n   = -1;
+	jb->err = errno;
+	if (fd > -1)
+		close( fd );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Write the data of the job to a file.
+ * \param   struct t_ael_job*  the job.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_job_write( struct t_ael_job *jb )
+{
+	ssize_t r;
+	int     fd = open( jb->a1, O_WRONLY | O_CREAT | O_CLOEXEC |
+	                           ((jb->o) ? O_APPEND : O_TRUNC), 0644 );
+
+	jb->n = -1;
+	if (fd < 0)
+	{
+		jb->err = errno;
+		return;
+	}
+	for (jb->n=0; (size_t) jb->n < jb->l2; jb->n += r)
+		if ((r = write( fd, jb->a2 + jb->n, jb->l2 - jb->n )) < 0)
+		{
+			if (EINTR == errno)
+			{
+				r = 0;
+				continue;
+			}
+			jb->n   = -1;
+			jb->err = errno;
+			break;
+		}
+	close( fd );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run the encoders of a job.
+ * \param   struct t_ael_job*  the job.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_job_encode( struct t_ael_job *jb )
+{
+	struct crypt_data *cd;
+	const char        *c;
+
+	if (T_AEL_JOB_CRY == jb->t)
+	{
+		cd = (struct crypt_data *) calloc( 1, sizeof( struct crypt_data ) );
+		c  = (NULL == cd) ? NULL : crypt_r( jb->a1, jb->a2, cd );
+		if (NULL != c && '*' != *c)
+		{
+			jb->rl = strlen( c );
+			jb->r  = (char *) malloc( jb->rl );
+			if (NULL != jb->r)
+				memcpy( jb->r, c, jb->rl );
+		}
+		else
+			jb->es = "crypt() failed";
+		free( cd );
+	}
+	else
+	{
+		jb->rl = t_enc_b64_size( jb->l1, T_AEL_JOB_B6E == jb->t );
+		jb->r  = (char *) malloc( jb->rl + 1 );  // malloc( 0 ) may give NULL
+		if (NULL != jb->r)
+		{
+			if (T_AEL_JOB_B6E == jb->t)
+				t_enc_b64_enc( jb->a1, jb->r, jb->l1 );
+			else
+			{
+				// input is a multiple of 4; up to 2 '=' pad the last quantum
+				t_enc_b64_dec( jb->a1, jb->r, jb->l1 );
+				for (c=jb->a1+jb->l1; c>jb->a1 && '=' == *(c-1) && jb->a1+jb->l1-c < 2; c--)
+					jb->rl--;
+			}
+		}
+	}
+	if (NULL == jb->r)
+	{
+		jb->n   = -1;
+		jb->err = ENOMEM;
+	}
+	else
+		jb->n   = (ssize_t) jb->rl;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Calculate the CRC checksum of the data of a job.
+ * \detail  Runs on a copy of the T.Encode.Crc state taken when the job was
+ *          offloaded; the instance itself doesn't advance.
+ * \param   struct t_ael_job*  the job.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_job_crc( struct t_ael_job *jb )
+{
+	struct t_enc_crc crc;
+
+	// the copy behind the job isn't aligned
+	memcpy( &crc, jb->a2, sizeof( struct t_enc_crc ) );
+	jb->o = crc.calc( &crc, jb->a1, jb->l1 );
+	jb->n = 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Resolve the host name of a job into an array of struct sockaddr_in.
+ * \param   struct t_ael_job*  the job.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_job_resolve( struct t_ael_job *jb )
+{
+	struct addrinfo     hints;
+	struct addrinfo    *res, *ai;
+	struct sockaddr_in *ip;
+	int                 rc;
+
+	memset( &hints, 0, sizeof( struct addrinfo ) );
+	hints.ai_family   = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (0 != (rc = getaddrinfo( jb->a1, NULL, &hints, &res )))
+	{
+		jb->n  = -1;
+		jb->es = gai_strerror( rc );
+		return;
+	}
+	for (jb->n=0, ai=res; NULL != ai; ai=ai->ai_next)
+		jb->n++;
+	jb->r  = (char *) malloc( jb->n * sizeof( struct sockaddr_in ) );
+	ip     = (struct sockaddr_in *) jb->r;
+	for (ai=res; NULL != ip && NULL != ai; ai=ai->ai_next, ip++)
+	{
+		memcpy( ip, ai->ai_addr, sizeof( struct sockaddr_in ) );
+		ip->sin_port = htons( (uint16_t) jb->o );
+	}
+	freeaddrinfo( res );
+	if (NULL == jb->r && jb->n > 0)
+	{
+		jb->n   = -1;
+		jb->err = ENOMEM;
+	}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Complete a job on the loops thread.
+ * \detail  Releases the job before calling back so an error raised by the
+ *          callback doesn't leak it.  The callback gets the result or nil and
+ *          an error message.
+ * \param   L    The lua state.
+ * \param   void*  the job.
+ * \param   int    execute or only release.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_job_done( lua_State *L, void *arg, int run )
+{
+	struct t_ael_job   *jb = (struct t_ael_job *) arg;
+	struct sockaddr_in *ip;
+	int                 n  = 1;
+	ssize_t             i;
+
+	jb->ael->op--;
+	if (run)
+	{
+		lua_rawgeti( L, LUA_REGISTRYINDEX, jb->fR );
+		if (jb->n < 0)
+		{
+			lua_pushnil( L );
+			lua_pushstring( L, (NULL != jb->es) ? jb->es : strerror( jb->err ) );
+			n = 2;
+		}
+		else if (T_AEL_JOB_RSV == jb->t)
+		{
+			lua_createtable( L, jb->n, 0 );
+			for (i=0; i<jb->n; i++)
+			{
+				ip  = t_net_ip4_create_ud( L );
+				*ip = ((struct sockaddr_in *) jb->r)[ i ];
+				lua_rawseti( L, -2, i+1 );
+			}
+		}
+		else if (T_AEL_JOB_CRC == jb->t)
+			lua_pushinteger( L, (lua_Integer) jb->o );
+		else if (NULL != jb->r)
+			lua_pushlstring( L, jb->r, jb->rl );
+		else
+			lua_pushinteger( L, (lua_Integer) jb->n );
+	}
+	luaL_unref( L, LUA_REGISTRYINDEX, jb->fR );
+	luaL_unref( L, LUA_REGISTRYINDEX, jb->aR );
+	free( jb->r );
+	free( jb );
+	if (run)
+		lua_call( L, n, 0 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Worker thread; runs jobs until the pool gets stopped.
+ * \param   void*  the pool.
+ * \return  void*  NULL.
+ * --------------------------------------------------------------------------*/
+static void
+*t_ael_wrk_run( void *arg )
+{
+	struct t_ael_wrk *wk = (struct t_ael_wrk *) arg;
+	struct t_ael_job *jb;
+
+	pthread_mutex_lock( &wk->mx );
+	while (1)
+	{
+		while (NULL == wk->hd && ! wk->stp)
+			pthread_cond_wait( &wk->cv, &wk->mx );
+		if (wk->stp)
+			break;
+		jb     = wk->hd;
+		wk->hd = jb->nxt;
+		if (NULL == wk->hd)
+			wk->tl = NULL;
+		pthread_mutex_unlock( &wk->mx );
+
+		switch (jb->t)
+		{
+			case T_AEL_JOB_RD:  t_ael_job_read( jb );    break;
+			case T_AEL_JOB_WR:  t_ael_job_write( jb );   break;
+			case T_AEL_JOB_RSV: t_ael_job_resolve( jb ); break;
+			case T_AEL_JOB_CRC: t_ael_job_crc( jb );     break;
+			default:            t_ael_job_encode( jb );  break;
+		}
+		// only fails if out of memory; the job is lost then
+		t_ael_post( jb->ael, &t_ael_job_done, jb );
+
+		pthread_mutex_lock( &wk->mx );
+	}
+	pthread_mutex_unlock( &wk->mx );
+	return NULL;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create the worker pool of a loop.
+ * \detail  The workers block all signals so signals observed by the loop
+ *          via signalfd can't get consumed by a worker.  If no thread can be
+ *          started the loop stays without a pool so the next call retries.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * \return  int  0 on success, -1 on failure.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_wrk_init( lua_State *L, struct t_ael *ael )
+{
+	struct t_ael_wrk *wk;
+	sigset_t          ms, om;
+
+	if (NULL != ael->wrk)
+		return 0;
+	if (t_ael_tsk_init( L, ael ) < 0)
+		return -1;
+	if (NULL == (wk = (struct t_ael_wrk *) malloc( sizeof( struct t_ael_wrk ) )))
+		return -1;
+	pthread_mutex_init( &wk->mx, NULL );
+	pthread_cond_init( &wk->cv, NULL );
+	wk->hd  = NULL;
+	wk->tl  = NULL;
+	wk->stp = 0;
+	sigfillset( &ms );
+	pthread_sigmask( SIG_SETMASK, &ms, &om );
+	for (wk->n=0; wk->n < T_AEL_WRK; wk->n++)
+		if (0 != pthread_create( &wk->th[ wk->n ], NULL, &t_ael_wrk_run, wk ))
+			break;
+	pthread_sigmask( SIG_SETMASK, &om, NULL );
+	if (0 == wk->n)
+	{
+		pthread_mutex_destroy( &wk->mx );
+		pthread_cond_destroy( &wk->cv );
+		free( wk );
+		return -1;
+	}
+	ael->wrk = wk;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Stop and release the worker pool of a loop.
+ * \detail  Waits for running jobs to finish; jobs which didn't start yet are
+ *          only released.  Finished jobs are released with the task queue.
+ * \param   L    The lua state.
+ * \param   struct t_ael*  the loop.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_wrk_free( lua_State *L, struct t_ael *ael )
+{
+	struct t_ael_wrk *wk = ael->wrk;
+	struct t_ael_job *jb;
+	int               i;
+
+	if (NULL == wk)
+		return;
+	pthread_mutex_lock( &wk->mx );
+	wk->stp = 1;
+	pthread_cond_broadcast( &wk->cv );
+	pthread_mutex_unlock( &wk->mx );
+	for (i=0; i<wk->n; i++)
+		pthread_join( wk->th[ i ], NULL );
+	while (NULL != (jb = wk->hd))
+	{
+		wk->hd = jb->nxt;
+		t_ael_job_done( L, jb, 0 );
+	}
+	pthread_mutex_destroy( &wk->mx );
+	pthread_cond_destroy( &wk->cv );
+	free( wk );
+	ael->wrk = NULL;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run a job on the worker pool and call back on the loop when done.
+ * \detail  Jobs and their arguments:
+ *          "read",      path [, T.Buffer [, offset]] -> string or #bytes read
+ *          "write",     path, data [, append]        -> #bytes written
+ *          "crypt",     password, salt               -> hash
+ *          "b64encode", data                         -> string
+ *          "b64decode", data                         -> string
+ *          "resolve",   host [, port]                -> { T.Net.IPv4, ... }
+ *          "crc",       T.Encode.Crc, data           -> checksum
+ *          data can be a string or a T.Buffer; a T.Buffer to read into must
+ *          be of fixed size.  Base64 input to decode must be a multiple of 4
+ *          long after removing line breaks.  On failure the callback gets
+ *          nil and an error message.
+ * \param   L  The lua state.
+ * \lparam  userdata T.Loop.                                      // 1
+ * \lparam  string   name of the job.                             // 2
+ * \lparam  ...      arguments to the job.
+ * \lparam  function callback( result ) executed on the loop.     // last
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_ael_offload( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );
+	int               n   = lua_gettop( L );
+	struct t_buf     *buf;
+	struct t_ael_job *jb;
+	struct t_ael_job  j;
+	const char       *s1;           ///< first input as passed in
+	const char       *s2  = NULL;   ///< second input as passed in
+	size_t            l1;           ///< length of s1
+	char             *d;
+	size_t            i;
+
+	memset( &j, 0, sizeof( struct t_ael_job ) );
+	j.t = (enum t_ael_job_t) luaL_checkoption( L, 2, NULL, t_ael_job_lst );
+	luaL_checktype( L, n, LUA_TFUNCTION );
+	luaL_argcheck( L, n > 3, 3, "job arguments expected" );
+	switch (j.t)
+	{
+		case T_AEL_JOB_RD:
+			s1 = luaL_checklstring( L, 3, &l1 );
+			if (n > 4 && NULL != (buf = t_buf_check_ud( L, 4, 1 )))
+			{
+				// only inline memory stays put while the worker writes to it
+				luaL_argcheck( L, T_BUF_FIX == buf->t, 4, "fixed size T.Buffer expected" );
+				j.o  = (n > 5) ? (long) luaL_checkinteger( L, 5 ) : 0;
+				luaL_argcheck( L, j.o >= 0, 5, "offset must not be negative" );
+				j.b  = buf->b;
+				j.bl = buf->len;
+			}
+			break;
+		case T_AEL_JOB_WR:
+			s1   = luaL_checklstring( L, 3, &l1 );
+			s2   = t_buf_checklstring( L, 4, &j.l2 );
+			j.o  = (n > 5) ? lua_toboolean( L, 5 ) : 0;
+			break;
+		case T_AEL_JOB_CRY:
+			s1   = luaL_checklstring( L, 3, &l1 );
+			s2   = luaL_checklstring( L, 4, &j.l2 );
+			break;
+		case T_AEL_JOB_RSV:
+			s1   = luaL_checklstring( L, 3, &l1 );
+			j.o  = (n > 4) ? (long) luaL_checkinteger( L, 4 ) : 0;
+			break;
+		case T_AEL_JOB_CRC:
+			s2   = (const char *) t_enc_crc_check_ud( L, 3 );
+			j.l2 = sizeof( struct t_enc_crc );
+			s1   = t_buf_checklstring( L, 4, &l1 );
+			break;
+		default:
+			s1   = t_buf_checklstring( L, 3, &l1 );
+			break;
+	}
+	j.l1 = l1;
+	if (T_AEL_JOB_B6D == j.t)
+	{
+		// line breaks get dropped when copying the input
+		for (i=0; i<l1; i++)
+			if ('\n' == s1[ i ] || '\r' == s1[ i ])
+				j.l1--;
+		luaL_argcheck( L, 0 == j.l1 % 4, 3, "Base64 length must be a multiple of 4" );
+	}
+	if (t_ael_wrk_init( L, ael ) < 0)
+		return t_push_error( L, "Failed to start worker pool" );
+	// the inputs get copied behind the job; the memory of a T.Buffer can move
+	// or get reused while the job is in flight
+	jb = (struct t_ael_job *) malloc( sizeof( struct t_ael_job ) + j.l1 + j.l2 + 2 );
+	if (NULL == jb)
+		return t_push_error( L, "Failed to allocate job" );
+	*jb     = j;
+	jb->ael = ael;
+	d       = (char *) (jb + 1);
+	jb->a1  = d;
+	if (T_AEL_JOB_B6D == j.t)
+	{
+		for (i=0; i<l1; i++)
+			if ('\n' != s1[ i ] && '\r' != s1[ i ])
+				*(d++) = s1[ i ];
+	}
+	else
+	{
+		memcpy( d, s1, l1 );
+		d += l1;
+	}
+	*(d++)  = '\0';
+	jb->a2  = d;
+	if (NULL != s2)
+		memcpy( d, s2, j.l2 );
+	d[ j.l2 ] = '\0';
+
+	// pin the T.Buffer to read into until the job completes
+	jb->aR = LUA_NOREF;
+	if (NULL != j.b)
+	{
+		lua_pushvalue( L, 4 );
+		jb->aR = luaL_ref( L, LUA_REGISTRYINDEX );
+	}
+	lua_pushvalue( L, n );
+	jb->fR = luaL_ref( L, LUA_REGISTRYINDEX );
+
+	ael->op++;                         // keeps the loop running until done
+	pthread_mutex_lock( &ael->wrk->mx );
+	if (NULL == ael->wrk->tl)
+		ael->wrk->hd = jb;
+	else
+		ael->wrk->tl->nxt = jb;
+	ael->wrk->tl = jb;
+	pthread_cond_signal( &ael->wrk->cv );
+	pthread_mutex_unlock( &ael->wrk->mx );
+	return 0;
+}
@@ -18,6 +18,8 @@
 #include "t_buf.h"
 
 
+static struct t_buf *t_buf_create_ol( lua_State *L, enum t_buf_t t, size_t cap );
+
 // --------------------------------- HELPERS Functions
 
 /** -------------------------------------------------------------------------
@@ -47,6 +49,220 @@ t_buf * t_buf_getbuffer( lua_State *L, int pB, int pP, int *pos )
 
 
 
+/**--------------------------------------------------------------------------
+ * Reverse a range of bytes in place.
+ * \param   b     first byte.
+ * \param   e     one past the last byte.
+ *  -------------------------------------------------------------------------*/
+static void
+t_buf_reverse( unsigned char *b, unsigned char *e )
+{
+	for (; b < --e; b++)
+		TSWAP( unsigned char, *b, *e );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Rotate the storage of a ring buffer so the content starts at b[0].
+ * \detail  Works in place without allocating by reversing both parts and
+ *          then the whole storage.
+ * \param   buf   pointer to the ring buffer.
+ *  -------------------------------------------------------------------------*/
+static void
+t_buf_linearize( struct t_buf *buf )
+{
+	if (0 == buf->rd)
+		return;
+	t_buf_reverse( buf->b, buf->b + buf->rd );
+	t_buf_reverse( buf->b + buf->rd, buf->b + buf->cap );
+	t_buf_reverse( buf->b, buf->b + buf->cap );
+	buf->rd = 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Point a slice to the current memory of its parent.
+ * \detail  A growable parent may have moved its memory since last access.
+ * \param   buf   pointer to the buffer.
+ *  -------------------------------------------------------------------------*/
+static void
+t_buf_follow( struct t_buf *buf )
+{
+	if (T_BUF_SLC == buf->t)
+		buf->b = buf->p->b + buf->rd;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get a pointer to the content of a buffer.
+ * \detail  The content is buf->len bytes long.  A ring buffer whose content
+ *          wraps around the end of the storage gets linearized first.
+ * \param   buf   pointer to the buffer.
+ * \return  unsigned char* pointer to the first byte of content.
+ *  -------------------------------------------------------------------------*/
+unsigned char
+*t_buf_data( struct t_buf *buf )
+{
+	t_buf_follow( buf );
+	if (T_BUF_RNG != buf->t)
+		return buf->b;
+	if (buf->rd + buf->len > buf->cap)
+		t_buf_linearize( buf );
+	return buf->b + buf->rd;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the bytes of a T.Buffer or a Lua string on the stack.
+ * \detail  Works like luaL_checklstring() but also accepts any T.Buffer.
+ * \param   L     the Lua State.
+ * \param   pos   position on the stack.
+ * \param   len   pointer to size_t gets the length assigned.
+ * \return  const char* pointer to the bytes.
+ *  -------------------------------------------------------------------------*/
+const char
+*t_buf_checklstring( lua_State *L, int pos, size_t *len )
+{
+	struct t_buf *buf = t_buf_check_ud( L, pos, 0 );
+
+	if (NULL == buf)
+		return luaL_checklstring( L, pos, len );
+	*len = buf->len;
+	return (const char *) t_buf_data( buf );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get a pointer to n contiguous bytes of content at offset o.
+ * \detail  For ring buffers the offset is relative to the read cursor and the
+ *          storage only gets linearized if the range wraps.
+ * \param   buf   pointer to the buffer.
+ * \param   o     offset in the content.
+ * \param   n     number of bytes.
+ * \return  unsigned char* pointer to the bytes or NULL if out of range.
+ *  -------------------------------------------------------------------------*/
+unsigned char
+*t_buf_ptr( struct t_buf *buf, size_t o, size_t n )
+{
+	size_t p;
+
+	if (o > buf->len || n > buf->len - o)
+		return NULL;
+	t_buf_follow( buf );
+	if (T_BUF_RNG != buf->t)
+		return buf->b + o;
+	p = buf->rd + o;
+	if (p < buf->cap && p + n > buf->cap)
+	{
+		t_buf_linearize( buf );
+		p = o;
+	}
+	return buf->b + p % buf->cap;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make sure a growable buffer can hold at least n bytes.
+ * \detail  The capacity grows by doubling.  Raises an error if a buffer of any
+ *          other type is too small.
+ * \param   L     the Lua State.
+ * \param   buf   pointer to the buffer.
+ * \param   n     number of bytes needed.
+ *  -------------------------------------------------------------------------*/
+void
+t_buf_reserve( lua_State *L, struct t_buf *buf, size_t n )
+{
+	size_t         c = (buf->cap > 0) ? buf->cap : 16;
+	unsigned char *b;
+
+	if (n <= (T_BUF_ISFIXED( buf ) ? buf->len : buf->cap))
+		return;
+	if (T_BUF_GRW != buf->t)
+		luaL_error( L, "T.Buffer of %d bytes can't hold %d bytes",
+			(int) (T_BUF_ISFIXED( buf ) ? buf->len : buf->cap), (int) n );
+	while (c < n)
+		c *= 2;
+	if (NULL == (b = (unsigned char *) realloc( buf->b, c )))
+		luaL_error( L, "Failed to grow T.Buffer to %d bytes", (int) c );
+	buf->b   = b;
+	buf->cap = c;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check buffer, offset and length on the stack and get the writable region.
+ * \detail  Fixed buffers offer the range within their length.  Growable
+ *          buffers append by default and grow to fit maxlen, which defaults
+ *          to the spare capacity or BUFSIZ.  Ring buffers always write behind
+ *          their content into the free space which may wrap around.
+ * \param   L     the Lua State.
+ * \param   pB    position on stack which is buffer.
+ * \param   pO    position on stack which is the offset (zero based, opt).
+ * \param   pL    position on stack which is the maximum length (opt).
+ * \param   sp    pointer to the span to fill.
+ * \return  struct t_buf* pointer to validated buffer.
+ *  -------------------------------------------------------------------------*/
+struct t_buf
+*t_buf_wspan( lua_State *L, int pB, int pO, int pL, struct t_buf_spn *sp )
+{
+	struct t_buf *buf = t_buf_check_ud( L, pB, 1 );
+	lua_Integer   ofs = luaL_optinteger( L, pO, T_BUF_ISFIXED( buf ) ? 0 : (lua_Integer) buf->len );
+	lua_Integer   mx;
+	size_t        av, w;
+
+	luaL_argcheck( L, 0 <= ofs && ofs <= (lua_Integer) buf->len, pO,
+		                 "T.Buffer offset must be >= 0 and <= #buffer" );
+	luaL_argcheck( L, T_BUF_RNG != buf->t || ofs == (lua_Integer) buf->len, pO,
+		                 "T.Buffer in ring mode only writes behind its content" );
+	switch (buf->t)
+	{
+		case T_BUF_GRW: av = (buf->cap > (size_t) ofs) ? buf->cap - ofs : BUFSIZ; break;
+		case T_BUF_RNG: av = buf->cap - buf->len;                                break;
+		default:        av = buf->len - ofs;
+	}
+	mx = luaL_optinteger( L, pL, (lua_Integer) av );
+	luaL_argcheck( L, 0 <= mx, pL, "length must not be negative" );
+	if (T_BUF_GRW == buf->t)
+		t_buf_reserve( L, buf, ofs + mx );
+	else if ((size_t) mx > av)
+		mx = av;
+	t_buf_follow( buf );
+
+	sp->o      = ofs;
+	sp->p[ 1 ] = buf->b;
+	sp->l[ 1 ] = 0;
+	if (T_BUF_RNG == buf->t)
+	{
+		w          = (buf->rd + buf->len) % buf->cap;
+		sp->p[ 0 ] = buf->b + w;
+		sp->l[ 0 ] = ((size_t) mx > buf->cap - w) ? buf->cap - w : (size_t) mx;
+		sp->l[ 1 ] = mx - sp->l[ 0 ];
+	}
+	else
+	{
+		sp->p[ 0 ] = buf->b + ofs;
+		sp->l[ 0 ] = mx;
+	}
+	return buf;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Account for n bytes written into a region obtained by t_buf_wspan().
+ * \param   buf   pointer to the buffer.
+ * \param   sp    pointer to the span.
+ * \param   n     number of bytes written.
+ *  -------------------------------------------------------------------------*/
+void
+t_buf_commit( struct t_buf *buf, struct t_buf_spn *sp, size_t n )
+{
+	if (T_BUF_RNG == buf->t)
+		buf->len += n;
+	else if (T_BUF_GRW == buf->t && sp->o + n > buf->len)
+		buf->len = sp->o + n;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 //  _                        _    ____ ___
 // | |   _   _  __ _        / \  |  _ \_ _|
@@ -103,6 +319,57 @@ lt_buf__Call( lua_State *L )
 }
 
 
+/** -------------------------------------------------------------------------
+ * Create a growable buffer.
+ * \detail  The buffer starts out empty and grows by doubling its capacity as
+ *          content gets appended or received.
+ * \param   L  lua state.
+ * \lparam  initial capacity of buffer (opt).
+ *        ALTERNATIVE
+ * \lparam  string buffer content initialized.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_growable( lua_State *L )
+{
+	size_t        sz  = 0;
+	const char   *s   = (LUA_TSTRING == lua_type( L, 1 )) ? lua_tolstring( L, 1, &sz ) : NULL;
+	struct t_buf *buf;
+
+	if (NULL == s)
+	{
+		sz = (size_t) luaL_optinteger( L, 1, 0 );
+		luaL_argcheck( L, (lua_Integer) sz >= 0, 1, "capacity must not be negative" );
+	}
+	buf = t_buf_create_ol( L, T_BUF_GRW, sz );
+	if (NULL != s)
+	{
+		memcpy( buf->b, s, sz );
+		buf->len = sz;
+	}
+	return 1;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Create a ring buffer.
+ * \detail  Content gets appended behind a read cursor and consumed from the
+ *          front.  The capacity is fixed.
+ * \param   L  lua state.
+ * \lparam  capacity of buffer.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_ring( lua_State *L )
+{
+	lua_Integer cap = luaL_checkinteger( L, 1 );
+
+	luaL_argcheck( L, cap > 0, 1, "capacity must be positive" );
+	t_buf_create_ol( L, T_BUF_RNG, (size_t) cap );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Create a t_buf and push to LuaStack.
  * \param  L  The lua state.
@@ -118,11 +385,44 @@ t_buf *t_buf_create_ud( lua_State *L, int size )
 	// size = sizof(...) -1 because the array has already one member
 	sz = sizeof( struct t_buf ) + (size - 1) * sizeof( unsigned char );
 	b  = (struct t_buf *) lua_newuserdata( L, sz );
-	memset( b->b, 0, size * sizeof( unsigned char ) );
+	memset( b->d, 0, size * sizeof( unsigned char ) );
 
 	b->len = size;
+	b->b   = b->d;
+	b->t   = T_BUF_FIX;
+	b->cap = 0;
+	b->rd  = 0;
+	b->p   = NULL;
+	luaL_getmetatable( L, "T.Buffer" );
+	lua_setmetatable( L, -2 );
+	return b;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a t_buf with out-of-line storage and push to LuaStack.
+ * \param  L    The lua state.
+ * \param  t    type of buffer; T_BUF_GRW or T_BUF_RNG.
+ * \param  cap  initial capacity in bytes.
+ *
+ * \return struct t_buf*  pointer to the  t_buf struct
+ * --------------------------------------------------------------------------*/
+static struct
+t_buf *t_buf_create_ol( lua_State *L, enum t_buf_t t, size_t cap )
+{
+	struct t_buf  *b = (struct t_buf *) lua_newuserdata( L, sizeof( struct t_buf ) );
+
+	b->len = 0;
+	b->b   = NULL;
+	b->t   = t;
+	b->cap = 0;
+	b->rd  = 0;
+	b->p   = NULL;
 	luaL_getmetatable( L, "T.Buffer" );
 	lua_setmetatable( L, -2 );
+	if (cap > 0 && NULL == (b->b = (unsigned char *) malloc( cap )))
+		luaL_error( L, "Failed to allocate T.Buffer of %d bytes", (int) cap );
+	b->cap = cap;
 	return b;
 }
 
@@ -160,11 +460,17 @@ lt_buf_unpack( lua_State *L )
 	int           pos;                               ///< starting byte  b->b[pos]
 	struct t_buf *buf;
 	struct t_pck *pc;
+	unsigned char *b;
 	size_t        n = 0,j;
+	size_t        l;                                 ///< bytes the Pack may read
 
 	buf = t_buf_getbuffer( L, 1 , 3, &pos );
 	pc  = t_pck_getpck( L, 2, &n );
-	t_pcr__callread( L, pc, buf->b + pos );
+	// variable sized packers may read up to the end of the buffer
+	l   = (T_PCK_ISVAR( pc )) ? buf->len - pos : t_pck_getsize( L, pc, 0 );
+	b   = t_buf_ptr( buf, pos, l );
+	luaL_argcheck( L, NULL != b, 2, "The Pack must fit into the Buffer" );
+	t_pck_readl( L, pc, b, l );
 
 	if (T_PCK_SEQ == pc->t)
 	{
@@ -188,21 +494,24 @@ lt_buf_unpack( lua_State *L )
  * \lparam  pos  position in bytes.
  * \lparam  sz   size in bytes(1-#buf).
  * \lreturn val  lua_String.
- * TODO: check buffer length vs requested size and offset
  *
  * \return  int    # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
 static int
 lt_buf_read( lua_State *L )
 {
-	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
-	int           pos;
-	int           sz;
+	struct t_buf  *buf = t_buf_check_ud( L, 1, 1 );
+	size_t         pos;
+	size_t         sz;
+	unsigned char *b;
 
 	pos = (lua_isnumber( L, 2 )) ? (size_t) luaL_checkinteger( L, 2 ) : 0;
+	luaL_argcheck( L, pos <= buf->len, 2, "position must be within the T.Buffer" );
 	sz  = (lua_isnumber( L, 3 )) ? (size_t) luaL_checkinteger( L, 3 ) : buf->len - pos;
+	b   = t_buf_ptr( buf, pos, sz );
+	luaL_argcheck( L, NULL != b, 3, "size must be within the T.Buffer" );
 
-	lua_pushlstring( L, (const char*) &(buf->b[ pos ]), sz );
+	lua_pushlstring( L, (const char*) b, sz );
 	return 1;
 }
 
@@ -212,31 +521,193 @@ lt_buf_read( lua_State *L )
  * \lparam  buf  userdata of type T.Buffer (struct t_buf).
  * \lparam  val  lua_String.
  * \lparam  pos  position in bytes.
- * \lparam  sz   size in bits (1-64).
- * TODO: check string vs buffer length
+ * \lparam  sz   size in bytes.
+ * A growable buffer grows if the string reaches beyond its length.
  *
  * \return  int    # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
 static int
 lt_buf_write( lua_State *L )
 {
-	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
-	int           pos = (lua_isnumber( L, 3 )) ? luaL_checkinteger( L, 3 ) : 0;
-	size_t        sz;
+	struct t_buf  *buf = t_buf_check_ud( L, 1, 1 );
+	size_t         pos = (lua_isnumber( L, 3 )) ? (size_t) luaL_checkinteger( L, 3 ) : 0;
+	size_t         l;
+	const char    *s   = luaL_checklstring( L, 2, &l );
+	size_t         sz  = (lua_isnumber( L, 4 )) ? (size_t) luaL_checkinteger( L, 4 ) : l;
+	unsigned char *b;
 
 	// if a third parameter is given write only x bytes of the input string to the buffer
-	if (lua_isnumber( L, 4 ))
+	luaL_argcheck( L, sz <= l, 4, "size must not exceed the string" );
+	luaL_argcheck( L, pos <= buf->len, 3, "position must be within the T.Buffer" );
+	if (T_BUF_GRW == buf->t && pos + sz > buf->len)
+	{
+		t_buf_reserve( L, buf, pos + sz );
+		buf->len = pos + sz;
+	}
+	b = t_buf_ptr( buf, pos, sz );
+	luaL_argcheck( L, NULL != b, 2, "string must fit into the T.Buffer" );
+	memcpy( b, s, sz );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Append a string or T.Buffer to the content of the buffer.
+ * \lparam  buf  userdata of type T.Buffer (struct t_buf).
+ * \lparam  val  lua_String or T.Buffer.
+ * \lreturn n    number of bytes appended.  A ring buffer appends only as
+ *               much as it has free space.
+ *
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_append( lua_State *L )
+{
+	struct t_buf     *buf = t_buf_check_ud( L, 1, 1 );
+	struct t_buf     *src = t_buf_check_ud( L, 2, 0 );
+	struct t_buf_spn  sp;
+	const char       *s;
+	size_t            l;
+
+	luaL_argcheck( L, ! T_BUF_ISFIXED( buf ), 1, "T.Buffer of fixed length can't append" );
+	if (NULL != src)
 	{
-		sz  = luaL_checkinteger( L, 4 );
-		memcpy  ( (char*) &(buf->b[ pos ]), luaL_checklstring( L, 2, NULL ), sz );
+		s = (const char *) t_buf_data( src );
+		l = src->len;
 	}
-	// otherwise write the whole thing
 	else
-		memcpy  ( (char*) &(buf->b[ pos ]), luaL_checklstring( L, 2, &sz ), sz );
+		s = luaL_checklstring( L, 2, &l );
+	lua_settop( L, 2 );
+	lua_pushnil( L );                    // default offset: behind the content
+	lua_pushinteger( L, (lua_Integer) l );
+	t_buf_wspan( L, 1, 3, 4, &sp );
+	l = (l > sp.l[ 0 ] + sp.l[ 1 ]) ? sp.l[ 0 ] + sp.l[ 1 ] : l;
+	// the source might be the buffer itself which may have been moved
+	if (src == buf)
+		s = (const char *) t_buf_data( src );
+	memcpy( sp.p[ 0 ], s, (l < sp.l[ 0 ]) ? l : sp.l[ 0 ] );
+	if (l > sp.l[ 0 ])
+		memcpy( sp.p[ 1 ], s + sp.l[ 0 ], l - sp.l[ 0 ] );
+	t_buf_commit( buf, &sp, l );
+	lua_pushinteger( L, (lua_Integer) l );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a view on a part of the buffer without copying.
+ * \detail  The slice references the memory of the buffer and keeps it alive.
+ *          It is accepted anywhere a T.Buffer is.  Slices of slices refer to
+ *          the original buffer.  A slice of a growable buffer follows its
+ *          memory when it grows but keeps its own length.  Ring buffers can't
+ *          be sliced since their content moves.  Pool buffers can't be sliced
+ *          since release() hands their slot to the next get() while a slice
+ *          would still refer to it.
+ * \lparam  buf  userdata of type T.Buffer (struct t_buf).
+ * \lparam  pos  offset in bytes, zero based (opt, default 0).
+ * \lparam  sz   length in bytes (opt, default rest of buffer).
+ * \lreturn slc  T.Buffer slice.
+ *
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_slice( lua_State *L )
+{
+	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
+	lua_Integer   pos = luaL_optinteger( L, 2, 0 );
+	lua_Integer   sz;
+	struct t_buf *slc;
+
+	luaL_argcheck( L, T_BUF_RNG != buf->t, 1, "T.Buffer in ring mode can't be sliced" );
+	luaL_argcheck( L, T_BUF_POL != buf->t, 1, "T.Buffer from a pool can't be sliced" );
+	luaL_argcheck( L, 0 <= pos && pos <= (lua_Integer) buf->len, 2,
+		"T.Buffer offset must be >= 0 and <= #buffer" );
+	sz  = luaL_optinteger( L, 3, (lua_Integer) buf->len - pos );
+	luaL_argcheck( L, 0 <= sz && sz <= (lua_Integer) buf->len - pos, 3,
+		"slice must be within the T.Buffer" );
+
+	slc = (struct t_buf *) lua_newuserdata( L, sizeof( struct t_buf ) );
+	slc->len = (size_t) sz;
+	slc->t   = T_BUF_SLC;
+	slc->cap = 0;
+	slc->rd  = (T_BUF_SLC == buf->t) ? buf->rd + pos : (size_t) pos;
+	slc->p   = (T_BUF_SLC == buf->t) ? buf->p : buf;
+	slc->b   = slc->p->b + slc->rd;
+	luaL_getmetatable( L, "T.Buffer" );
+	lua_setmetatable( L, -2 );
+	// keep the original buffer alive
+	if (T_BUF_SLC == buf->t)
+		lua_getuservalue( L, 1 );
+	else
+		lua_pushvalue( L, 1 );
+	lua_setuservalue( L, -2 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drop bytes from the front of the content.
+ * \detail  Ring buffers advance their read cursor; growable buffers move the
+ *          remaining content to the front.
+ * \lparam  buf  userdata of type T.Buffer (struct t_buf).
+ * \lparam  n    number of bytes, defaults to all.
+ *
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_consume( lua_State *L )
+{
+	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
+	lua_Integer   n   = luaL_optinteger( L, 2, (lua_Integer) buf->len );
+
+	luaL_argcheck( L, ! T_BUF_ISFIXED( buf ), 1, "T.Buffer of fixed length can't consume" );
+	luaL_argcheck( L, 0 <= n && n <= (lua_Integer) buf->len, 2,
+		"can't consume more than the T.Buffer content" );
+	if (T_BUF_RNG == buf->t)
+		buf->rd = (buf->len == (size_t) n) ? 0 : (buf->rd + n) % buf->cap;
+	else
+		memmove( buf->b, buf->b + n, buf->len - n );
+	buf->len -= n;
 	return 0;
 }
 
 
+/**--------------------------------------------------------------------------
+ * Returns the number of bytes that can be read from the buffer.
+ * \lparam  buf  userdata of type T.Buffer (struct t_buf).
+ * \lreturn n    number of readable bytes.
+ * \lreturn f    number of bytes which can be added without growing.
+ *
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_readable( lua_State *L )
+{
+	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
+
+	lua_pushinteger( L, (lua_Integer) buf->len );
+	lua_pushinteger( L, T_BUF_ISFIXED( buf ) ? 0 : (lua_Integer) (buf->cap - buf->len) );
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Returns the capacity of the buffer.
+ * \lparam  buf  userdata of type T.Buffer (struct t_buf).
+ * \lreturn n    allocated bytes.
+ *
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_capacity( lua_State *L )
+{
+	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
+
+	lua_pushinteger( L, (lua_Integer) (T_BUF_ISFIXED( buf ) ? buf->len : buf->cap) );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Gets the content of the buffer in Hex
  * \lreturn  string buffer representation in Hexadecimal
@@ -249,13 +720,14 @@ lt_buf_tohexstring( lua_State *L )
 	int           l, c;
 	char         *sbuf;
 	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
+	unsigned char *b  = t_buf_data( buf );
 
 	sbuf = malloc( 3 * buf->len * sizeof( char ) + 1 );
 	memset( sbuf, 0, 3 * buf->len * sizeof( char ) );
 
 	c = 0;
 	for (l=0; l < (int) buf->len; l++)
-		c += snprintf( sbuf+c, 4, "%02X ", buf->b[l] );
+		c += snprintf( sbuf+c, 4, "%02X ", b[l] );
 
 	lua_pushlstring( L, sbuf, c );
 	free( sbuf );
@@ -278,6 +750,31 @@ lt_buf__len( lua_State *L )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Release the out-of-line storage, the mapping or the pool slot of a buffer.
+ * \param   L    The Lua state
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf__gc( lua_State *L )
+{
+	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
+
+	if (T_BUF_MAP == buf->t)
+		t_buf_unmap( buf );
+	else if (T_BUF_POL == buf->t)
+		t_buf_pol_return( L, 1 );
+	else if (! T_BUF_ISFIXED( buf ) && NULL != buf->b)
+	{
+		free( buf->b );
+		buf->b   = NULL;
+		buf->len = 0;
+		buf->cap = 0;
+	}
+	return 0;
+}
+
+
 /**--------------------------------------------------------------------------
  * Return Tostring representation of a buffer stream.
  * \param   L     The lua state.
@@ -307,6 +804,11 @@ static const struct luaL_Reg t_buf_fm [] = {
  * --------------------------------------------------------------------------*/
 static const struct luaL_Reg t_buf_cf [] = {
 	{"new",           lt_buf_New},
+	{"growable",      lt_buf_growable},
+	{"ring",          lt_buf_ring},
+	{"map",           lt_buf_map},
+	{"shared",        lt_buf_shared},
+	{"unlink",        lt_buf_unlink},
 	{NULL,            NULL}
 };
 
@@ -317,10 +819,19 @@ static const luaL_Reg t_buf_m [] = {
 	// metamethods
 	{ "__tostring", lt_buf__tostring },
 	{ "__len",      lt_buf__len },
+	{ "__gc",       lt_buf__gc },
 	// instance methods
 	{"unpack",      lt_buf_unpack},
 	{"read",        lt_buf_read},
 	{"write",       lt_buf_write},
+	{"append",      lt_buf_append},
+	{"slice",       lt_buf_slice},
+	{"consume",     lt_buf_consume},
+	{"readable",    lt_buf_readable},
+	{"capacity",    lt_buf_capacity},
+	{"advise",      lt_buf_advise},
+	{"sync",        lt_buf_sync},
+	{"release",     lt_buf_release},
 	// univeral stuff
 	{"toHex",       lt_buf_tohexstring},
 	{"length",      lt_buf__len},
@@ -348,6 +859,8 @@ LUAMOD_API int luaopen_t_buf( lua_State *L )
 	luaL_newlib( L, t_buf_cf );
 	luaL_newlib( L, t_buf_fm );
 	lua_setmetatable( L, -2 );
+	luaopen_t_buf_pol( L );
+	lua_setfield( L, -2, "Pool" );
 	return 1;
 }
 
@@ -9,10 +9,52 @@
  * \copyright See Copyright notice at the end of t.h
  */
 
+/// Types of T.Buffer
+enum t_buf_t {
+	T_BUF_FIX,      ///< Buffer         fixed length, data inline
+	T_BUF_GRW,      ///< Buffer         growable, data out-of-line
+	T_BUF_RNG,      ///< Buffer         ring with read cursor, data out-of-line
+	T_BUF_SLC,      ///< Buffer         slice of another buffer, no own data
+	T_BUF_MAP,      ///< Buffer         memory mapped file or shared memory
+	T_BUF_POL,      ///< Buffer         slot in the arena of a T.Buffer.Pool
+};
+
+/// buffers whose length can't change
+#define T_BUF_ISFIXED( buf )  (T_BUF_GRW != (buf)->t && T_BUF_RNG != (buf)->t)
+
 /// The userdata struct for T.Buffer
 struct t_buf {
-	size_t         len;   ///<  length of the entire buffer in bytes
-	unsigned char  b[1];  ///<  pointer to the variable size buffer -> must be last in struct
+	size_t         len;   ///<  length of the content in bytes
+	unsigned char *b;     ///<  pointer to the content; for rings to the storage
+	enum t_buf_t   t;     ///<  type of buffer
+	size_t         cap;   ///<  allocated bytes for growable and ring buffers
+	                      ///<  length of the mapping of mapped buffers
+	                      ///<  size of the slot of pool buffers
+	size_t         rd;    ///<  read cursor of ring buffers; content starts at b[rd]
+	                      ///<  offset into the parent of slices
+	                      ///<  offset of b into the mapping of mapped buffers
+	                      ///<  index of the slot of pool buffers; pool is uservalue
+	struct t_buf  *p;     ///<  parent of slices; kept alive as uservalue
+	unsigned char  d[1];  ///<  inline data of fixed buffers -> must be last in struct
+};
+
+/// Writable region of a T.Buffer; ring buffers may wrap into a second segment
+struct t_buf_spn {
+	unsigned char *p[ 2 ];  ///< start of the segments
+	size_t         l[ 2 ];  ///< length of the segments
+	size_t         o;       ///< offset of the region within the content
+};
+
+/// The userdata struct for T.Buffer.Pool
+struct t_buf_pol {
+	size_t         sz;    ///< size of each buffer in bytes
+	size_t         n;     ///< number of buffers in the arena
+	int            zr;    ///< zero buffers when handing them out
+	size_t         ht;    ///< requests served from the arena
+	size_t         ms;    ///< requests served by allocating a T.Buffer
+	unsigned char *a;     ///< the arena; released buffers are in the uservalue
+	size_t         fr;    ///< number of free slots on the stack
+	size_t         fs[1]; ///< stack of free slots -> must be last in struct
 };
 
 
@@ -29,6 +71,9 @@ enum t_pck_t {
 	T_PCK_BTS,      ///< Packer         Bit (integer x Bit) - signed
 	T_PCK_BTU,      ///< Packer         Bit (integer x Bit) - unsigned
 	T_PCK_RAW,      ///< Packer         Raw  -  string/utf8/binary
+	T_PCK_VRU,      ///< Packer         Varint - LEB128 unsigned
+	T_PCK_VRS,      ///< Packer         Varint - LEB128 zigzag encoded signed
+	T_PCK_LPR,      ///< Packer         Raw with length prefix
 	// complex packer types
 	T_PCK_ARR,      ///< Combinator     Array
 	T_PCK_SEQ,      ///< Combinator     Sequence
@@ -44,6 +89,9 @@ static const char *const t_pck_t_lst[] = {
 	"BitSigned",    ///< Packer         Bit (integer x Bit)
 	"BitUnsigned",  ///< Packer         Bit (integer x Bit)
 	"Raw",          ///< Packer         Raw  -  string/utf8/binary
+	"VarUInt",      ///< Packer         Varint - LEB128 unsigned
+	"VarInt",       ///< Packer         Varint - LEB128 zigzag encoded signed
+	"String",       ///< Packer         Raw with length prefix
 	// complex packer types
 	"Array",        ///< Combinator     Array
 	"Sequence",     ///< Combinator     Sequence
@@ -51,16 +99,35 @@ static const char *const t_pck_t_lst[] = {
 };
 
 
+struct t_pck;
+
+/// One step of the compiled plan of a Combinator
+struct t_pck_op {
+	struct t_pck  *p;   ///< packer of the element; Combinators recurse into its plan
+	size_t         o;   ///< byte offset of the element within the Combinator
+	                    ///< T_PCK_NOOFS behind variable sized elements
+};
+
+/// offset of elements which depends on the packed data
+#define T_PCK_NOOFS           ((size_t) -1)
+
+/// packers whose size depends on the packed data
+#define T_PCK_ISVAR( p )      (0 == (p)->b)
+
+
 /// The userdata struct for T.Pack/T.Pack.Struct
 struct t_pck {
 	enum  t_pck_t  t;   ///< type of packer
 	/// size of packer -> various meanings
 	///  -- for int/uint, float, raw =  the number of bytes
 	///  -- for bit, bits and nibble =  the number of bits
+	///  -- for length prefixed raw  =  bytes of the prefix; 0 for a varint
+	///  -- for varints              =  0
 	///  -- for Seq,Struct,Arr       =  the number of elements in this Combinator
 	size_t         s;
 	/// modifier -> various meanings
 	///  -- for int/uint             = Endian (0=Big, 1=Little)
+	///  -- for length prefixed raw  = Endian of the prefix
 	///  -- for bit                  = Offset from beginning of byte (bit numbering: MSB 0)
 	///  -- for raw                  = ??? (unused)
 	///  -- for Arr                  = lua registry Reference for packer
@@ -73,6 +140,10 @@ struct t_pck {
 	///        idx[ 2s+i ] = name
 	///        idx[ name ] = i
 	int            m;
+	size_t         b;     ///< size in bits; 0 if it depends on the packed data
+	/// compiled plan; one op per element for Seq,Struct, the element for Arr.
+	/// Filled in by the constructor -> must be last in struct
+	struct t_pck_op o[1];
 };
 
 
@@ -89,7 +160,20 @@ union Ftypes {
 struct t_pcr {
 	int      r;   ///< reference to packer type
 	size_t   o;   ///< offset from the beginning of the wrapping Struct
-	//size_t          s;   ///< size of this Reader
+	/// index within the parent if the offset depends on the packed data;
+	/// the parent is kept in the uservalue.  0 if o is valid.
+	size_t   i;
+};
+
+
+/// The userdata struct for T.Pack.Cursor; the source is kept in the uservalue
+struct t_pcc {
+	int      r;   ///< reference to packer of a record
+	size_t   b;   ///< offset of the first record
+	size_t   s;   ///< size of a record in bytes
+	size_t   n;   ///< number of records
+	size_t   i;   ///< index of the current record, 1 based
+	size_t   o;   ///< offset of the current record
 };
 
 
@@ -101,6 +185,30 @@ struct t_buf   *t_buf_create_ud( lua_State *L, int size );
 
 // helpers to check and verify input on stack
 struct t_buf * t_buf_getbuffer( lua_State *L, int pB, int pP, int *pos );
+struct t_buf * t_buf_wspan    ( lua_State *L, int pB, int pO, int pL, struct t_buf_spn *sp );
+void           t_buf_commit   ( struct t_buf *buf, struct t_buf_spn *sp, size_t n );
+
+// access to the content
+unsigned char *t_buf_data     ( struct t_buf *buf );
+const char    *t_buf_checklstring( lua_State *L, int pos, size_t *len );
+unsigned char *t_buf_ptr      ( struct t_buf *buf, size_t o, size_t n );
+void           t_buf_reserve  ( lua_State *L, struct t_buf *buf, size_t n );
+
+
+// t_buf_map.c
+int             lt_buf_map     ( lua_State *L );
+int             lt_buf_shared  ( lua_State *L );
+int             lt_buf_unlink  ( lua_State *L );
+int             lt_buf_advise  ( lua_State *L );
+int             lt_buf_sync    ( lua_State *L );
+void             t_buf_unmap   ( struct t_buf *buf );
+
+
+// t_buf_pol.c
+int              luaopen_t_buf_pol ( lua_State *L );
+struct t_buf_pol *t_buf_pol_check_ud( lua_State *L, int pos, int check );
+int             lt_buf_release ( lua_State *L );
+void             t_buf_pol_return( lua_State *L, int pos );
 
 
 // t_pck.c
@@ -114,4 +222,7 @@ int t_pck_write( lua_State *L, struct t_pck *p, unsigned char *buffer );
 
 // helpers for the Packers
 struct t_pck *t_pck_getpck( lua_State *L, int pos, size_t *bo );
+size_t        t_pck_getsize( lua_State *L, struct t_pck *p, int bits );
 int           t_pcr__callread ( lua_State *L, struct t_pck *pc, const unsigned char *b );
+int           t_pcr__callwrite( lua_State *L, struct t_pck *pc, unsigned char *b );
+size_t        t_pck_readl    ( lua_State *L, struct t_pck *pc, const unsigned char *b, size_t l );
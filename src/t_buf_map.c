@@ -0,0 +1,260 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_buf_map.c
+ * \brief     T.Buffer backed by memory mapped files or shared memory.
+ *            The bytes of the buffer come straight from the page cache, so
+ *            reading a part of a huge file costs page faults only.  Shared
+ *            buffers are visible to forked children or, if named, to any
+ *            process opening the same name.  A mapped buffer is a fixed length
+ *            T.Buffer; everything which accepts a T.Buffer works on it
+ *            unchanged.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t.h"
+#include "t_buf.h"
+
+#include <string.h>           // strcmp
+#include <unistd.h>           // close, sysconf
+#include <fcntl.h>            // open
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/// hints for advise() in the order of the options
+static const char *const t_buf_adv_lst[] = {
+	"normal",
+	"sequential",
+	"random",
+	"willneed",
+	"dontneed",
+	NULL
+};
+
+static const int t_buf_adv_val[] = {
+	MADV_NORMAL,
+	MADV_SEQUENTIAL,
+	MADV_RANDOM,
+	MADV_WILLNEED,
+	MADV_DONTNEED,
+};
+
+
+/**--------------------------------------------------------------------------
+ * Check for a memory mapped T.Buffer.
+ * \param   L    The lua state.
+ * \param   int  position on the stack.
+ * \return  struct t_buf*  the buffer.
+ * --------------------------------------------------------------------------*/
+static struct t_buf
+*t_buf_map_check_ud( lua_State *L, int pos )
+{
+	struct t_buf *buf = t_buf_check_ud( L, pos, 1 );
+
+	luaL_argcheck( L, T_BUF_MAP == buf->t && NULL != buf->b, pos,
+		"memory mapped `T.Buffer` expected" );
+	return buf;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Map a file into a T.Buffer.
+ * \detail  Modes are "r" and "rw".  Both map the file readable and writable;
+ *          with "r" writes stay private to the process whereas with "rw" they
+ *          go to the file.  The offset doesn't need to be page aligned.
+ * \param   L  The lua state.
+ * \lparam  string   path of the file.
+ * \lparam  string   mode "r" or "rw" (opt, default "r").
+ * \lparam  int      offset in the file (opt, default 0).
+ * \lparam  int      length (opt, default rest of the file).
+ * \lreturn T.Buffer mapped buffer.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_map( lua_State *L )
+{
+	const char   *path = luaL_checkstring( L, 1 );
+	const char   *mode = luaL_optstring( L, 2, "r" );
+	lua_Integer   ofs  = luaL_optinteger( L, 3, 0 );
+	int           rw   = 0;
+	long          pg   = sysconf( _SC_PAGESIZE );
+	struct stat   st;
+	lua_Integer   len;
+	size_t        dlt;
+	struct t_buf *buf;
+	void         *m;
+	int           fd;
+
+	if (0 == strcmp( mode, "rw" ))
+		rw = 1;
+	else
+		luaL_argcheck( L, 0 == strcmp( mode, "r" ), 2, "mode must be \"r\" or \"rw\"" );
+	luaL_argcheck( L, ofs >= 0, 3, "offset must not be negative" );
+
+	if ((fd = open( path, (rw) ? O_RDWR : O_RDONLY )) < 0)
+		return t_push_error( L, "Failed to open %s", path );
+	if (fstat( fd, &st ) < 0)
+	{
+		close( fd );
+		return t_push_error( L, "Failed to stat %s", path );
+	}
+	len = luaL_optinteger( L, 4, (lua_Integer) st.st_size - ofs );
+	if (len <= 0 || ofs + len > (lua_Integer) st.st_size)
+	{
+		close( fd );
+		return luaL_argerror( L, 4, "mapping must be within the file and not empty" );
+	}
+
+	dlt = (size_t) (ofs % pg);
+	buf = (struct t_buf *) lua_newuserdata( L, sizeof( struct t_buf ) );
+	memset( buf, 0, sizeof( struct t_buf ) );
+	buf->t = T_BUF_MAP;
+	luaL_getmetatable( L, "T.Buffer" );
+	lua_setmetatable( L, -2 );
+	m = mmap( NULL, (size_t) len + dlt, PROT_READ | PROT_WRITE,
+	          (rw) ? MAP_SHARED : MAP_PRIVATE, fd, (off_t) (ofs - dlt) );
+	close( fd );
+	if (MAP_FAILED == m)
+		return t_push_error( L, "Failed to map %s", path );
+
+	buf->b   = (unsigned char *) m + dlt;
+	buf->len = (size_t) len;
+	buf->cap = (size_t) len + dlt;
+	buf->rd  = dlt;
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a T.Buffer in memory shared between processes.
+ * \detail  Without a name the memory is anonymous and gets shared with all
+ *          processes forked after its creation.  With a name it is a POSIX
+ *          shared memory object which other processes can open as well; an
+ *          existing object is grown to size if it is smaller and its size is
+ *          used if none is given.  Use T.Pack.fetchadd() and T.Pack.cas() for
+ *          values updated concurrently.
+ * \param   L  The lua state.
+ * \lparam  string   name such as "/counters" (opt).
+ * \lparam  int      size in bytes (opt for existing named objects).
+ * \lreturn T.Buffer shared buffer.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_shared( lua_State *L )
+{
+	const char   *name = luaL_optstring( L, 1, NULL );
+	lua_Integer   len  = luaL_optinteger( L, 2, 0 );
+	struct stat   st;
+	struct t_buf *buf;
+	void         *m;
+	int           fd   = -1;
+
+	luaL_argcheck( L, len >= 0, 2, "size must not be negative" );
+	luaL_argcheck( L, NULL != name || len > 0, 2, "size of anonymous shared memory required" );
+	if (NULL != name)
+	{
+		if ((fd = shm_open( name, O_RDWR | O_CREAT, 0600 )) < 0)
+			return t_push_error( L, "Failed to open shared memory %s", name );
+		if (fstat( fd, &st ) < 0 ||
+		    (len > (lua_Integer) st.st_size && ftruncate( fd, (off_t) len ) < 0))
+		{
+			close( fd );
+			return t_push_error( L, "Failed to size shared memory %s", name );
+		}
+		len = (0 == len) ? (lua_Integer) st.st_size : len;
+		if (0 == len)
+		{
+			close( fd );
+			return luaL_argerror( L, 2, "size of new shared memory required" );
+		}
+	}
+
+	buf = (struct t_buf *) lua_newuserdata( L, sizeof( struct t_buf ) );
+	memset( buf, 0, sizeof( struct t_buf ) );
+	buf->t = T_BUF_MAP;
+	luaL_getmetatable( L, "T.Buffer" );
+	lua_setmetatable( L, -2 );
+	m = mmap( NULL, (size_t) len, PROT_READ | PROT_WRITE,
+	          (fd < 0) ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED, fd, 0 );
+	if (fd > -1)
+		close( fd );
+	if (MAP_FAILED == m)
+		return t_push_error( L, "Failed to map shared memory" );
+
+	buf->b   = (unsigned char *) m;
+	buf->len = (size_t) len;
+	buf->cap = (size_t) len;
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove the name of a shared memory object.
+ * \detail  Buffers which have it mapped keep it until they are collected.
+ * \param   L  The lua state.
+ * \lparam  string   name such as "/counters".
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_unlink( lua_State *L )
+{
+	const char *name = luaL_checkstring( L, 1 );
+
+	if (shm_unlink( name ) < 0)
+		return t_push_error( L, "Failed to unlink shared memory %s", name );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Give the kernel a hint about how the mapping will be accessed.
+ * \param   L  The lua state.
+ * \lparam  T.Buffer mapped buffer.
+ * \lparam  string   "normal", "sequential", "random", "willneed" or "dontneed".
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_advise( lua_State *L )
+{
+	struct t_buf *buf = t_buf_map_check_ud( L, 1 );
+	int           a   = luaL_checkoption( L, 2, NULL, t_buf_adv_lst );
+
+	if (madvise( buf->b - buf->rd, buf->cap, t_buf_adv_val[ a ] ) < 0)
+		return t_push_error( L, "Failed to advise mapping" );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Flush changes of the mapping to the file.
+ * \param   L  The lua state.
+ * \lparam  T.Buffer mapped buffer.
+ * \lparam  boolean  schedule only and don't wait (opt).
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_sync( lua_State *L )
+{
+	struct t_buf *buf = t_buf_map_check_ud( L, 1 );
+
+	if (msync( buf->b - buf->rd, buf->cap, (lua_toboolean( L, 2 )) ? MS_ASYNC : MS_SYNC ) < 0)
+		return t_push_error( L, "Failed to sync mapping" );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Unmap the memory of a mapped T.Buffer.
+ * \param   struct t_buf*  the buffer.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_unmap( struct t_buf *buf )
+{
+	if (NULL != buf->b)
+		munmap( buf->b - buf->rd, buf->cap );
+	buf->b   = NULL;
+	buf->len = 0;
+	buf->cap = 0;
+}
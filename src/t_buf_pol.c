@@ -0,0 +1,304 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_buf_pol.c
+ * \brief     Pool of same sized T.Buffers carved from one preallocated arena.
+ *            Released buffers are kept by the pool and handed out again as
+ *            the very same userdata, so a steady state of get()/release()
+ *            allocates nothing and creates no garbage.  Buffers which get
+ *            collected instead of released return their slot to the pool.
+ *            If the pool is exhausted it falls back to ordinary buffers.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include <stdlib.h>               // malloc, free
+#include <string.h>               // memset
+
+#include "t.h"
+#include "t_buf.h"
+
+
+/**--------------------------------------------------------------------------
+ * Check if the item on stack position pos is a T.Buffer.Pool.
+ * \param  L      the Lua State
+ * \param  pos    position on the stack
+ * \param  check  raise an error if it isn't
+ *
+ * \return struct t_buf_pol* pointer to the pool
+ * --------------------------------------------------------------------------*/
+struct t_buf_pol
+*t_buf_pol_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, "T.Buffer.Pool" );
+	luaL_argcheck( L, (ud != NULL || !check), pos, "`T.Buffer.Pool` expected" );
+	return (NULL==ud) ? NULL : (struct t_buf_pol *) ud;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Create a pool of count buffers with size bytes each.
+ * \param   L  lua state.
+ * \lparam  int     size of each buffer in bytes.
+ * \lparam  int     number of buffers in the pool.
+ * \lparam  boolean zero buffers when handing them out (opt, default true).
+ * \lreturn T.Buffer.Pool
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_pol_New( lua_State *L )
+{
+	lua_Integer       sz = luaL_checkinteger( L, 1 );
+	lua_Integer       n  = luaL_checkinteger( L, 2 );
+	struct t_buf_pol *pl;
+	lua_Integer       i;
+
+	luaL_argcheck( L, sz > 0, 1, "size must be positive" );
+	luaL_argcheck( L, n > 0,  2, "count must be positive" );
+	pl = (struct t_buf_pol *) lua_newuserdata( L,
+	         sizeof( struct t_buf_pol ) + (n - 1) * sizeof( size_t ) );
+	pl->sz = (size_t) sz;
+	pl->n  = (size_t) n;
+	pl->zr = lua_isnoneornil( L, 3 ) || lua_toboolean( L, 3 );
+	pl->ht = 0;
+	pl->ms = 0;
+	pl->fr = 0;
+	pl->a  = NULL;
+	luaL_getmetatable( L, "T.Buffer.Pool" );
+	lua_setmetatable( L, -2 );
+	if (NULL == (pl->a = (unsigned char *) malloc( pl->sz * pl->n )))
+		return t_push_error( L, "Failed to allocate T.Buffer.Pool arena" );
+	// hand out from the beginning of the arena first
+	for (i = n-1; i >= 0; i--)
+		pl->fs[ pl->fr++ ] = (size_t) i;
+	lua_createtable( L, (int) n, 0 );   // released buffers for reuse
+	lua_setuservalue( L, -2 );
+	return 1;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Create a pool from the constructor.
+ * \param   L  lua state.
+ * \lparam  CLASS table T.Buffer.Pool.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_pol__Call( lua_State *L )
+{
+	lua_remove( L, 1 );
+	return lt_buf_pol_New( L );
+}
+
+
+/** -------------------------------------------------------------------------
+ * Get a buffer from the pool.
+ * \detail  Prefers buffers which were released, then unused slots of the
+ *          arena.  An exhausted pool returns an ordinary T.Buffer of the same
+ *          size and counts a miss.
+ * \param   L  lua state.
+ * \lparam  T.Buffer.Pool
+ * \lreturn T.Buffer
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_pol_get( lua_State *L )
+{
+	struct t_buf_pol *pl = t_buf_pol_check_ud( L, 1, 1 );
+	struct t_buf     *buf;
+	size_t            n;
+
+	lua_settop( L, 1 );
+	lua_getuservalue( L, 1 );
+	if ((n = lua_rawlen( L, 2 )) > 0)
+	{
+		lua_rawgeti( L, 2, (lua_Integer) n );
+		lua_pushnil( L );
+		lua_rawseti( L, 2, (lua_Integer) n );
+		buf = t_buf_check_ud( L, -1, 1 );
+	}
+	else if (pl->fr > 0)
+	{
+		buf = (struct t_buf *) lua_newuserdata( L, sizeof( struct t_buf ) );
+		buf->t   = T_BUF_POL;
+		buf->rd  = pl->fs[ --pl->fr ];
+		buf->b   = pl->a + buf->rd * pl->sz;
+		buf->cap = pl->sz;
+		buf->p   = NULL;
+		luaL_getmetatable( L, "T.Buffer" );
+		lua_setmetatable( L, -2 );
+		lua_pushvalue( L, 1 );
+		lua_setuservalue( L, -2 );   // the arena must outlive the buffer
+	}
+	else
+	{
+		pl->ms++;
+		t_buf_create_ud( L, (int) pl->sz );
+		return 1;
+	}
+	pl->ht++;
+	buf->len = pl->sz;
+	if (pl->zr)
+		memset( buf->b, 0, pl->sz );
+	return 1;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Give a T.Buffer back to its pool.
+ * \detail  The buffer becomes empty and must not be used anymore; the pool
+ *          hands it out again.  Buffers which don't belong to a pool are left
+ *          alone, so the result of pool:get() can always be released.
+ * \param   L  lua state.
+ * \lparam  T.Buffer
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+int
+lt_buf_release( lua_State *L )
+{
+	struct t_buf *buf = t_buf_check_ud( L, 1, 1 );
+
+	if (T_BUF_POL != buf->t)
+		return 0;
+	luaL_argcheck( L, buf->len > 0, 1, "T.Buffer was already released" );
+	buf->len = 0;
+	lua_settop( L, 1 );
+	lua_getuservalue( L, 1 );           // the pool
+	lua_getuservalue( L, 2 );           // its released buffers
+	lua_pushvalue( L, 1 );
+	lua_rawseti( L, 3, (lua_Integer) lua_rawlen( L, 3 ) + 1 );
+	return 0;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Return the slot of a collected pool buffer to the pool.
+ * \detail  Called from the T.Buffer __gc.  Released buffers are referenced
+ *          by the pool and only get collected along with it.
+ * \param   L    lua state.
+ * \param   int  stack position of the T.Buffer.
+ *  -------------------------------------------------------------------------*/
+void
+t_buf_pol_return( lua_State *L, int pos )
+{
+	struct t_buf     *buf = t_buf_check_ud( L, pos, 1 );
+	struct t_buf_pol *pl;
+
+	if (0 == buf->len)
+		return;
+	lua_getuservalue( L, pos );
+	pl = t_buf_pol_check_ud( L, -1, 1 );
+	if (NULL != pl->a)
+		pl->fs[ pl->fr++ ] = buf->rd;
+	lua_pop( L, 1 );
+	buf->len = 0;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Get the statistics of the pool.
+ * \param   L  lua state.
+ * \lparam  T.Buffer.Pool
+ * \lreturn int  number of requests served from the arena.
+ * \lreturn int  number of requests served by allocating.
+ * \lreturn int  number of buffers available.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_pol_stats( lua_State *L )
+{
+	struct t_buf_pol *pl = t_buf_pol_check_ud( L, 1, 1 );
+
+	lua_getuservalue( L, 1 );
+	lua_pushinteger( L, (lua_Integer) pl->ht );
+	lua_pushinteger( L, (lua_Integer) pl->ms );
+	lua_pushinteger( L, (lua_Integer) (pl->fr + lua_rawlen( L, -3 )) );
+	return 3;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Return Tostring representation of a pool.
+ * \param   L     The lua state.
+ * \lparam  T.Buffer.Pool
+ * \lreturn string    formatted string representing the pool.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_pol__tostring( lua_State *L )
+{
+	struct t_buf_pol *pl = t_buf_pol_check_ud( L, 1, 1 );
+
+	lua_pushfstring( L, "T.Buffer.Pool[%d*%d]: %p", (int) pl->n, (int) pl->sz, pl );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Release the arena of a pool.
+ * \param   L    The Lua state
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_pol__gc( lua_State *L )
+{
+	struct t_buf_pol *pl = t_buf_pol_check_ud( L, 1, 1 );
+
+	free( pl->a );
+	pl->a = NULL;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Class metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_pol_fm [] = {
+	{"__call",        lt_buf_pol__Call},
+	{NULL,            NULL}
+};
+
+/**--------------------------------------------------------------------------
+ * Class functions library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_pol_cf [] = {
+	{"new",           lt_buf_pol_New},
+	{NULL,            NULL}
+};
+
+/**--------------------------------------------------------------------------
+ * Objects metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_buf_pol_m [] = {
+	// metamethods
+	{ "__tostring", lt_buf_pol__tostring },
+	{ "__gc",       lt_buf_pol__gc },
+	// instance methods
+	{"get",         lt_buf_pol_get},
+	{"stats",       lt_buf_pol_stats},
+	{NULL,    NULL}
+};
+
+
+/**--------------------------------------------------------------------------
+ * Pushes the T.Buffer.Pool library onto the stack.
+ *          - creates Metatable with functions
+ *          - creates metatable with methods
+ * \param   L      The lua state.
+ * \lreturn table  the library
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_buf_pol( lua_State *L )
+{
+	// T.Buffer.Pool instance metatable
+	luaL_newmetatable( L, "T.Buffer.Pool" );
+	luaL_setfuncs( L, t_buf_pol_m, 0 );
+	lua_setfield( L, -1, "__index" );
+
+	// T.Buffer.Pool class
+	luaL_newlib( L, t_buf_pol_cf );
+	luaL_newlib( L, t_buf_pol_fm );
+	lua_setmetatable( L, -2 );
+	return 1;
+}
@@ -55,4 +55,7 @@ int                luaopen_t_enc_crc   ( lua_State *L );
 
 // t_enc_b64.c
 int                luaopen_t_enc_b64   ( lua_State *L );
+size_t             t_enc_b64_size      ( size_t len, int for_encode );
+void               t_enc_b64_enc       ( const char *inbuf, char *outbuf, size_t inbuf_len );
+void               t_enc_b64_dec       ( const char *inbuf, char *outbuf, size_t inbuf_len );
 
@@ -12,6 +12,7 @@
 
 #include "t.h"
 #include "t_enc.h"
+#include "t_buf.h"         // encrypt buffers
 
 
 // ----------------------------- Native Arc4 functions
@@ -184,13 +185,13 @@ lt_enc_arc4_crypt( lua_State *L )
 	char                *res;
 	
 	arc4 = t_enc_arc4_check_ud( L, 1 );
-	if (lua_isstring( L, 2 ))
+	if (lua_isstring( L, 2 ) || NULL != t_buf_check_ud( L, 2, 0 ))
 	{
-		body = luaL_checklstring( L, 2, &bLen );
+		body = t_buf_checklstring( L, 2, &bLen );
 	}
 	else
 	{
-		return t_push_error( L, "T.Arc4.crypt takes at least one string parameter" );
+		return t_push_error( L, "T.Arc4.crypt takes at least one string or T.Buffer parameter" );
 	}
 	// if a key is provided for encoding,
 	// reset the Arc4 state by initializing it with new key
@@ -12,6 +12,7 @@
 
 #include "t.h"
 #include "t_enc.h"
+#include "t_buf.h"         // encode/decode buffers
 
 static const unsigned char enc_table[ 64 ] =
 	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -30,19 +31,19 @@ static const uint32_t      mod_table[ ]    = { 0, 2, 1 };
  * \param  encode, if 1 then return string of size need for encoded result
  * \return size_t
  */
-static size_t
-b64_res_size( size_t len, int for_encode )
+size_t
+t_enc_b64_size( size_t len, int for_encode )
 {
 	return (for_encode) ? 4 * ((len + 2) / 3) :  len / 4 * 3;
 }
 
 // TODO: improve to not having to test each character for length
-static void
-b64_encode( const char *inbuf, char *outbuf, size_t inbuf_len)
+void
+t_enc_b64_enc( const char *inbuf, char *outbuf, size_t inbuf_len)
 {
 	uint32_t i, j;
 	uint8_t  dec1, dec2, dec3;
-	size_t   outbuf_len = b64_res_size( inbuf_len, 1 );
+	size_t   outbuf_len = t_enc_b64_size( inbuf_len, 1 );
 
 	for (i = 0, j = 0; i < inbuf_len;)
 	{
@@ -62,8 +63,8 @@ b64_encode( const char *inbuf, char *outbuf, size_t inbuf_len)
 
 
 // TODO: deal with line breaks and %4 length guarantee
-static void
-b64_decode( const char *inbuf, char *outbuf, size_t inbuf_len )
+void
+t_enc_b64_dec( const char *inbuf, char *outbuf, size_t inbuf_len )
 {
 	uint32_t i, j;
 	uint8_t  enc1, enc2, enc3, enc4;
@@ -88,7 +89,7 @@ b64_decode( const char *inbuf, char *outbuf, size_t inbuf_len )
 
 
 /**
- * \brief  expose Base64 encoding to Lua; wraps native function b64_encode above.
+ * \brief  expose Base64 encoding to Lua; wraps native function t_enc_b64_enc above.
  * \param  L The Lua state.
  * \TODO: consider using a Lua_Buffer instead of allocating and freeing memory
  * \return  int    # of values pushed onto the stack.
@@ -101,17 +102,17 @@ t_enc_b64_encode( lua_State *L )
 	const char         *body;
 	char               *res;
 	
-	if ( lua_isstring( L, 1 ) )
+	if ( lua_isstring( L, 1 ) || NULL != t_buf_check_ud( L, 1, 0 ) )
 	{
-		body = luaL_checklstring( L, 1, &bLen );
+		body = t_buf_checklstring( L, 1, &bLen );
 	}
 	else
 	{
 		return t_push_error( L,
-			    "T.Encode.Base64.encode takes at least one string parameter" );
+			    "T.Encode.Base64.encode takes at least one string or T.Buffer parameter" );
 	}
 
-	rLen = b64_res_size( bLen, 1 );
+	rLen = t_enc_b64_size( bLen, 1 );
 	res = malloc( rLen );
 	if (res == NULL)
 	{
@@ -119,7 +120,7 @@ t_enc_b64_encode( lua_State *L )
 		        "T.Encode.Base64.encode failed due to internal memory allocation problem" );
 	}
 
-	b64_encode( body, res, bLen);
+	t_enc_b64_enc( body, res, bLen);
 	lua_pushlstring( L, res, rLen );
 	free(res);
 
@@ -128,7 +129,7 @@ t_enc_b64_encode( lua_State *L )
 
 
 /**
- * \brief  expose Base64 decoding to Lua; wraps native function b64_decode above.
+ * \brief  expose Base64 decoding to Lua; wraps native function t_enc_b64_dec above.
  * \param  L The Lua state.
  * \TODO: consider using a Lua_Buffer instead of allocating and freeing memory
  * \return  int    # of values pushed onto the stack.
@@ -141,17 +142,17 @@ t_enc_b64_decode( lua_State *L )
 	const char         *body;
 	char               *res;
 	
-	if ( lua_isstring( L, 1 ) )
+	if ( lua_isstring( L, 1 ) || NULL != t_buf_check_ud( L, 1, 0 ) )
 	{
-		body = luaL_checklstring( L, 1, &bLen );
+		body = t_buf_checklstring( L, 1, &bLen );
 	}
 	else
 	{
 		return t_push_error( L,
-			    "T.Encode.Base64.decode takes at least one string parameter" );
+			    "T.Encode.Base64.decode takes at least one string or T.Buffer parameter" );
 	}
 
-	rLen = b64_res_size( bLen, 0 );
+	rLen = t_enc_b64_size( bLen, 0 );
 	res = malloc( rLen );
 	if (res == NULL)
 	{
@@ -159,7 +160,7 @@ t_enc_b64_decode( lua_State *L )
 		        "T.Encode.Base64.decode failed due to internal memory allocation problem" );
 	}
 
-	b64_decode(  body, res, bLen);
+	t_enc_b64_dec(  body, res, bLen);
 	lua_pushlstring( L, res, rLen );
 	free(res);
 
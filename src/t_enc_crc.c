@@ -344,7 +344,7 @@ lt_enc_crc_calc( lua_State *L )
 	else if (lua_isuserdata( L, 2 ))
 	{
 		buf  = t_buf_check_ud( L, 2, 1 );
-		msg  = (const char *) &(buf->b[ sta ]);
+		msg  = (const char *) t_buf_data( buf ) + sta;
 		//msg  =  &(buf->b[ 0 ]);
 		len  = buf->len;
 	}
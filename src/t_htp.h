@@ -9,6 +9,14 @@
 
 #include "t_ael.h"
 
+#include <netinet/in.h>           // struct in_addr
+#include <sys/uio.h>              // struct iovec
+
+#define T_HTP_LOG_URL  128        ///< max bytes of the url kept in a log record
+#define T_HTP_LOG_LNE  256        ///< max bytes of a formatted log line
+#define T_HTP_LOG_SZ   4096       ///< default number of records in the ring
+#define T_HTP_LOG_IV   1000       ///< default flush interval in milliseconds
+
 
 // _   _ _____ _____ ____
 //| | | |_   _|_   _|  _ \   _ __   __ _ _ __ ___  ___ _ __
@@ -72,6 +80,17 @@ enum t_htp_ver {
 };
 
 
+/// counters of a T.Http.Server
+struct t_htp_sts {
+	uint64_t          acc;    ///< connections accepted
+	uint64_t          cls;    ///< connections closed
+	uint64_t          rqs;    ///< requests received
+	uint64_t          bin;    ///< bytes received
+	uint64_t          bot;    ///< bytes sent
+	uint64_t          str;    ///< streams in flight
+};
+
+
 // ____        _          ____  _                   _
 //|  _ \  __ _| |_ __ _  / ___|| |_ _ __ _   _  ___| |_ _   _ _ __ ___  ___
 //| | | |/ _` | __/ _` | \___ \| __| '__| | | |/ __| __| | | | '__/ _ \/ __|
@@ -87,6 +106,10 @@ struct t_htp_srv {
 	int               rR;     ///< Lua registry reference to request handler function
 	time_t            nw;     ///< Current time on the server
 	char              fnw[30];///< Formatted Date time in HTTP format
+	struct t_htp_log *log;    ///< access log; NULL if not enabled
+	struct t_htp_sts  sts;    ///< counters
+	int               mR;     ///< Lua registry reference to the metrics url
+	int               tR;     ///< Lua registry reference to the access log flush timer
 };
 
 
@@ -101,6 +124,7 @@ struct t_htp_con {
 	// received this gets executed; Can be LUA_NOREF which discards incoming data
 	int               bR;     ///< Lua registry reference to body handler function
 	struct t_net     *sck;    ///< pointer to the actual socket
+	struct sockaddr_in *ip;   ///< pointer to the peer address (kept in proxy)
 	struct t_htp_srv *srv;    ///< pointer to the HTTP-Server
 
 	int               kpAlv;  ///< keepalive value in seconds -> 0==no Keepalive
@@ -127,6 +151,8 @@ struct t_htp_str {
 	int               rsCl;   ///< response content length
 	int               rsBl;   ///< response buffer length (headers + rsCl)
 	int               rsSl;   ///< response buffer sent length (if rsBl==rsSl; stream is done)
+	int               rsCd;   ///< response status code
+	struct timeval    rqTm;   ///< time the request arrived
 	int               bR;     ///< Lua registry reference to body handler function
 	int               expect; ///< shall the connection return an expected thingy?
 	enum t_htp_srm_s  state;  ///< HTTP Message state
@@ -152,6 +178,36 @@ struct t_htp_buf {
 };
 
 
+/// fixed layout record for the access log; written on the hot path without
+/// any formatting or allocation
+struct t_htp_lrc {
+	time_t            nw;     ///< time the response was finished
+	struct in_addr    ip;     ///< peer address
+	enum t_htp_mth    mth;    ///< HTTP Method of the request
+	enum t_htp_ver    ver;    ///< HTTP version of the request
+	int               st;     ///< response status code
+	size_t            sz;     ///< response bytes sent
+	long              us;     ///< time to serve the request in microseconds
+	char              url[ T_HTP_LOG_URL ]; ///< request url (truncated)
+};
+
+
+/// access log; a single producer/single consumer ring of records which gets
+/// flushed in batches by writev()
+struct t_htp_log {
+	int               fd;     ///< file descriptor of the log file
+	size_t            sz;     ///< number of records in the ring
+	size_t            hd;     ///< head; next slot to write (producer)
+	size_t            tl;     ///< tail; next slot to flush  (consumer)
+	size_t            drp;    ///< records lost to failed writes
+	time_t            lnw;    ///< time of the cached formatted timestamp
+	char              fnw[30];///< cached formatted timestamp
+	struct iovec     *iov;    ///< iovec per record slot
+	char             *lne;    ///< formatted lines; T_HTP_LOG_LNE per slot
+	struct t_htp_lrc  rc[1];  ///< the records -> must be last in struct
+};
+
+
 //  __  __      _   _               _
 // |  \/  | ___| |_| |__   ___   __| |___
 // | |\/| |/ _ \ __| '_ \ / _ \ / _` / __|
@@ -168,6 +224,14 @@ const char       *t_htp_status       ( int status );
 struct t_htp_srv *t_htp_srv_check_ud ( lua_State *L, int pos, int check );
 struct t_htp_srv *t_htp_srv_create_ud( lua_State *L );
 void              t_htp_srv_setnow( struct t_htp_srv *s, int force );
+void              t_htp_srv_metrics( lua_State *L, struct t_htp_srv *s );
+
+
+// t_htp_log.c
+struct t_htp_log *t_htp_log_create ( const char *path, size_t sz );
+void              t_htp_log_destroy( struct t_htp_log *lg );
+void              t_htp_log_add    ( lua_State *L, struct t_htp_log *lg, struct t_htp_str *s );
+int               t_htp_log_flush  ( struct t_htp_log *lg );
 
 
 // HTTP Connection specific methods
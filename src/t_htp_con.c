@@ -32,7 +32,9 @@ struct t_htp_con
 	c->buf_head  = NULL;   // reference to current output buffer head
 	c->buf_tail  = NULL;   // reference to current output buffer head
 	c->srv       = srv;
+	c->ip        = NULL;
 	c->cnt       = 1;
+	c->read      = 0;
 	lua_newtable( L ); // empty table to hold streams inside
 
 	c->sR        = luaL_ref( L, LUA_REGISTRYINDEX );
@@ -84,10 +86,13 @@ t_htp_con_rcv( lua_State *L )
 
 	// read
 	rcvd = t_net_tcp_recv( L, c->sck, &(c->buf[ c->read ]), BUFSIZ - c->read );
+#if PRINT_DEBUGS == 1
 	printf( "RCVD: %d bytes\n", rcvd );
+#endif
 
 	if (! rcvd)    // peer has closed
 		return lt_htp_con__gc( L );
+	c->srv->sts.bin += rcvd;
 	// negotiate which stream object is responsible
 	// if HTTP1.0 or HTTP1.1 this is the last, HTTP2.0 has a stream identifier
 	lua_rawgeti( L, LUA_REGISTRYINDEX, c->sR );
@@ -159,6 +164,7 @@ t_htp_con_rsp( lua_State *L )
 			&(b[ buf->sl ]),
 			buf->bl - buf->sl );
 	buf->sl   += snt;  // How much of current buffer is sent -> adjustment
+	c->srv->sts.bot += snt;
 	str->rsSl += snt;  // How much of current stream is sent -> adjustment
 
 	//printf( "%zu   %zu  -- %u    %u\n", buf->sl, buf->bl,
@@ -169,6 +175,8 @@ t_htp_con_rsp( lua_State *L )
 		if ( buf->last )
 		{
 			//printf( "EndOfStream\n" );
+			if (NULL != c->srv->log)
+				t_htp_log_add( L, c->srv->log, str );
 			lua_pushcfunction( L, lt_htp_str__gc );
 			lua_rawgeti( L, LUA_REGISTRYINDEX, buf->sR );
 			luaL_unref( L, LUA_REGISTRYINDEX, buf->sR ); // unref stream for gc
@@ -184,7 +192,9 @@ t_htp_con_rsp( lua_State *L )
 		//        on kpAlv timeout
 		if (NULL == c->buf_head)       // current connection has no buffers left
 		{
+#if PRINT_DEBUGS == 1
 			printf( "remove Connection from Loop\n" );
+#endif
 			// remove this connections socket from evLoop
 			t_ael_removehandle_impl( c->srv->ael, c->sck->fd, T_AEL_WR );
 			c->srv->ael->fd_set[ c->sck->fd ]->t = T_AEL_RD;
@@ -305,7 +315,10 @@ lt_htp_con__gc( lua_State *L )
 	}
 	if (NULL != c->sck)
 	{
+		c->srv->sts.cls++;
+#if PRINT_DEBUGS == 1
 		printf( "REMOVE Socket %d FROM LOOP ...", c->sck->fd );
+#endif
 		t_ael_removehandle_impl( c->srv->ael, c->sck->fd, T_AEL_RD );
 		t_ael_removehandle_impl( c->srv->ael, c->sck->fd, T_AEL_WR );
 		c->srv->ael->fd_set[ c->sck->fd ]->t = T_AEL_NO;
@@ -317,10 +330,14 @@ lt_htp_con__gc( lua_State *L )
 
 		t_net_close( L, c->sck );
 		c->sck = NULL;
+#if PRINT_DEBUGS == 1
 		printf( "  DONE\n" );
+#endif
 	}
 
+#if PRINT_DEBUGS == 1
 	printf( "GC'ed HTTP connection: %p\n", c );
+#endif
 
 	return 0;
 }
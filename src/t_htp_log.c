@@ -0,0 +1,287 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_htp_log.c
+ * \brief     Access log for T.Http.Server
+ *            Finished requests are written as fixed layout records into a
+ *            preallocated ring.  Formatting and writing happens in batches
+ *            when the ring gets flushed (by a loop timer or when it is full)
+ *            so logging costs no syscall per request.
+ *            The ring is single producer/single consumer; head and tail are
+ *            published with acquire/release semantics.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+
+#include "t.h"
+#include <stdlib.h>               // malloc, free
+#include <string.h>               // memset, memcpy
+#include <stdio.h>                // snprintf
+#include <fcntl.h>                // open
+#include <unistd.h>               // close
+#include <limits.h>               // IOV_MAX
+#include <errno.h>
+#include <time.h>                 // gmtime_r, strftime
+#include <sys/time.h>             // gettimeofday
+#include <arpa/inet.h>            // inet_ntop
+#include "t_htp.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+
+/// names for enum t_htp_mth
+static const char *const t_htp_log_mth[] = {
+	"ILLEGAL",
+	"CONNECT",
+	"CHECKOUT",
+	"COPY",
+	"DELETE",
+	"GET",
+	"HEAD",
+	"LOCK",
+	"MKACTIVITY",
+	"MKCALENDAR",
+	"MKCOL",
+	"MERGE",
+	"M-SEARCH",
+	"MOVE",
+	"NOTIFY",
+	"OPTIONS",
+	"POST",
+	"PUT",
+	"PATCH",
+	"PURGE",
+	"PROPFIND",
+	"PROPPATCH",
+	"REPORT",
+	"SEARCH",
+	"SUBSCRIBE",
+	"TRACE",
+	"UNLOCK",
+	"UNSUBSCRIBE",
+};
+
+
+/// names for enum t_htp_ver
+static const char *const t_htp_log_ver[] = {
+	"HTTP/0.9",
+	"HTTP/1.0",
+	"HTTP/1.1",
+};
+
+
+/**--------------------------------------------------------------------------
+ * Create an access log writing to the file at path.
+ * \param   const char*  path of the log file; gets appended to.
+ * \param   size_t       number of records in the ring.
+ * \return  struct t_htp_log*  pointer to the log or NULL on failure.
+ * --------------------------------------------------------------------------*/
+struct t_htp_log
+*t_htp_log_create( const char *path, size_t sz )
+{
+	struct t_htp_log *lg;
+	size_t            n;
+	int               fd = open( path, O_WRONLY | O_APPEND | O_CREAT, 0644 );
+
+	if (fd < 0)
+		return NULL;
+	lg = (struct t_htp_log *) malloc( sizeof( struct t_htp_log ) +
+	                                  (sz-1) * sizeof( struct t_htp_lrc ) );
+	if (NULL == lg)
+	{
+		close( fd );
+		return NULL;
+	}
+	lg->iov = (struct iovec *) malloc( sz * sizeof( struct iovec ) );
+	lg->lne = (char *) malloc( sz * T_HTP_LOG_LNE );
+	if (NULL == lg->iov || NULL == lg->lne)
+	{
+		free( lg->iov );
+		free( lg->lne );
+		free( lg );
+		close( fd );
+		return NULL;
+	}
+	lg->fd  = fd;
+	lg->sz  = sz;
+	lg->hd  = 0;
+	lg->tl  = 0;
+	lg->drp = 0;
+	lg->lnw = 0;
+	for (n=0; n<sz; n++)
+		lg->iov[ n ].iov_base = &(lg->lne[ n * T_HTP_LOG_LNE ]);
+	return lg;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Flush outstanding records, close the log file and free the log.
+ * \param   struct t_htp_log*  pointer to the log.
+ * --------------------------------------------------------------------------*/
+void
+t_htp_log_destroy( struct t_htp_log *lg )
+{
+	t_htp_log_flush( lg );
+	close( lg->fd );
+	free( lg->iov );
+	free( lg->lne );
+	free( lg );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Add a record for a finished stream to the log.
+ * \detail  Only copies fixed size values into the next slot of the ring.  If
+ *          the ring is full it gets flushed first, which keeps the amortized
+ *          cost at one write per ring size of requests.
+ * \param   L      The lua state.
+ * \param   struct t_htp_log*  pointer to the log.
+ * \param   struct t_htp_str*  the finished stream.
+ * --------------------------------------------------------------------------*/
+void
+t_htp_log_add( lua_State *L, struct t_htp_log *lg, struct t_htp_str *s )
+{
+	struct t_htp_lrc *rc;
+	struct timeval    tv;
+	const char       *url;
+	size_t            len;
+	size_t            hd = lg->hd;
+
+	if (hd - __atomic_load_n( &lg->tl, __ATOMIC_ACQUIRE ) >= lg->sz)
+		t_htp_log_flush( lg );
+	rc      = &(lg->rc[ hd % lg->sz ]);
+	rc->nw  = s->con->srv->nw;
+	rc->mth = s->mth;
+	rc->ver = s->con->ver;
+	rc->st  = s->rsCd;
+	rc->sz  = s->rsSl;
+	if (NULL != s->con->ip)
+		rc->ip = s->con->ip->sin_addr;
+	else
+		rc->ip.s_addr = 0;
+	gettimeofday( &tv, 0 );
+	rc->us  = (tv.tv_sec - s->rqTm.tv_sec) * 1000000 + tv.tv_usec - s->rqTm.tv_usec;
+
+	lua_rawgeti( L, LUA_REGISTRYINDEX, s->pR );
+	lua_getfield( L, -1, "url" );
+	url = lua_tolstring( L, -1, &len );
+	if (NULL == url)
+		len = 0;
+	else
+	{
+		len = (len < T_HTP_LOG_URL) ? len : T_HTP_LOG_URL - 1;
+		memcpy( rc->url, url, len );
+	}
+	rc->url[ len ] = '\0';
+	lua_pop( L, 2 );
+
+	__atomic_store_n( &lg->hd, hd+1, __ATOMIC_RELEASE );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Format a record into its line slot.
+ * \param   struct t_htp_log*  pointer to the log.
+ * \param   size_t             slot index.
+ * \return  size_t             length of the formatted line.
+ * --------------------------------------------------------------------------*/
+static size_t
+t_htp_log_format( struct t_htp_log *lg, size_t i )
+{
+	struct t_htp_lrc *rc = &(lg->rc[ i ]);
+	char              ip[ INET_ADDRSTRLEN ];
+	struct tm         tm;
+	int               n;
+
+	if (rc->nw != lg->lnw)
+	{
+		gmtime_r( &rc->nw, &tm );
+		strftime( lg->fnw, sizeof( lg->fnw ), "%d/%b/%Y:%H:%M:%S +0000", &tm );
+		lg->lnw = rc->nw;
+	}
+	inet_ntop( AF_INET, &rc->ip, ip, sizeof( ip ) );
+	// Common Log Format extended by the time taken in microseconds
+	n = snprintf( lg->iov[ i ].iov_base, T_HTP_LOG_LNE,
+		"%s - - [%s] \"%s %s %s\" %d %zu %ld\n",
+		ip,
+		lg->fnw,
+		t_htp_log_mth[ rc->mth ],
+		rc->url,
+		t_htp_log_ver[ rc->ver ],
+		rc->st,
+		rc->sz,
+		rc->us );
+	if (n >= T_HTP_LOG_LNE)         // truncated; keep the line terminated
+	{
+		n = T_HTP_LOG_LNE - 1;
+		((char *) lg->iov[ i ].iov_base)[ n-1 ] = '\n';
+	}
+	return (size_t) n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Write all outstanding records to the log file.
+ * \detail  Formats each pending record into its own line slot and hands the
+ *          slots to writev() in batches of up to IOV_MAX lines.
+ * \param   struct t_htp_log*  pointer to the log.
+ * \return  int                number of records written; records lost to
+ *                             failed writes are added to lg->drp instead.
+ * --------------------------------------------------------------------------*/
+int
+t_htp_log_flush( struct t_htp_log *lg )
+{
+	size_t        tl = lg->tl;
+	size_t        hd = __atomic_load_n( &lg->hd, __ATOMIC_ACQUIRE );
+	size_t        b, i, n, c = 0;
+	ssize_t       w;
+	struct iovec *iov;
+
+	while (tl < hd)
+	{
+		// a batch must be contiguous in the ring to be handed to writev()
+		b = tl % lg->sz;
+		n = hd - tl;
+		n = (n > lg->sz - b) ? lg->sz - b : n;
+		n = (n > IOV_MAX) ? IOV_MAX : n;
+		for (i=b; i<b+n; i++)
+			lg->iov[ i ].iov_len = t_htp_log_format( lg, i );
+		iov = &(lg->iov[ b ]);
+		i   = n;
+		while (i > 0)
+		{
+			w = writev( lg->fd, iov, (int) i );
+			if (w < 0)
+			{
+				if (EINTR == errno)
+					continue;
+				// the lines not written are lost; count them as dropped
+				lg->drp += i;
+				c       -= i;
+				break;
+			}
+			// deal with partial writes
+			while (i > 0 && (size_t) w >= iov->iov_len)
+			{
+				w -= iov->iov_len;
+				iov++;
+				i--;
+			}
+			if (i > 0)
+			{
+				iov->iov_base  = (char *) iov->iov_base + w;
+				iov->iov_len  -= w;
+			}
+		}
+		// reset the line slots which got moved by partial writes
+		for (i=b; i<b+n; i++)
+			lg->iov[ i ].iov_base = &(lg->lne[ i * T_HTP_LOG_LNE ]);
+		tl += n;
+		c  += n;
+		__atomic_store_n( &lg->tl, tl, __ATOMIC_RELEASE );
+	}
+	return (int) c;
+}
@@ -10,9 +10,12 @@
 
 #include <string.h>               // memset
 #include <time.h>                 // gmtime
+#include <stdio.h>                // snprintf
+#include <inttypes.h>             // PRIu64
 
 #include "t.h"
 #include "t_htp.h"
+#include "t_tim.h"
 
 
 /** ---------------------------------------------------------------------------
@@ -69,7 +72,11 @@ struct t_htp_srv
 {
 	struct t_htp_srv *s;
 	s = (struct t_htp_srv *) lua_newuserdata( L, sizeof( struct t_htp_srv ));
-	s->nw = time( NULL );
+	s->nw  = time( NULL );
+	s->log = NULL;
+	s->mR  = LUA_NOREF;
+	s->tR  = LUA_NOREF;
+	memset( &s->sts, 0, sizeof( struct t_htp_sts ) );
 	t_htp_srv_setnow( s, 1 );
 
 	luaL_getmetatable( L, "T.Http.Server" );
@@ -167,6 +174,8 @@ lt_htp_srv_accept( lua_State *L )
 	lua_rawset( L, -3 );
 	c->pR  = luaL_ref( L, LUA_REGISTRYINDEX );
 	c->sck = c_sck;
+	c->ip  = si_cli;
+	s->sts.acc++;
 
 	// actually put it onto the loop  //S: s,ss,cs,ip,rt,add(),ael,cs,true,rcv,msg
 	lua_call( L, 5, 0 );          // execute ael:addhandle(cli,tread,rcv,msg)
@@ -219,6 +228,218 @@ lt_htp_srv_listen( lua_State *L )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Write the access log records collected so far to the log file.
+ * \param   L     lua Virtual Machine.
+ * \lparam  userdata  struct t_htp_srv.
+ * \lreturn int       number of records written.
+ * \lreturn int       total number of records dropped by failed writes.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_htp_srv_flushlog( lua_State *L )
+{
+	struct t_htp_srv *s = t_htp_srv_check_ud( L, 1, 1 );
+
+	if (NULL == s->log)
+	{
+		lua_pushinteger( L, 0 );
+		lua_pushinteger( L, 0 );
+	}
+	else
+	{
+		lua_pushinteger( L, t_htp_log_flush( s->log ) );
+		lua_pushinteger( L, (lua_Integer) s->log->drp );
+	}
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Flush the access log from a T.Loop timer.
+ * \detail  Returning the interval T.Time re-arms the timer on the loop.  Once
+ *          the access log got disabled nil is returned which removes it.
+ * \param   L     lua Virtual Machine.
+ * \lparam  userdata  struct t_htp_srv.
+ * \lparam  userdata  T.Time flush interval.
+ * \lreturn userdata  T.Time flush interval.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_htp_srv_flushtimer( lua_State *L )
+{
+	struct t_htp_srv *s = t_htp_srv_check_ud( L, 1, 1 );
+
+	if (NULL == s->log)
+		return 0;
+	t_htp_log_flush( s->log );
+	lua_pushvalue( L, 2 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Enable or disable the access log for the T.Http.Server.
+ * \detail  Finished requests are recorded into a preallocated ring which gets
+ *          flushed to the file by a timer on the servers loop.  Passing false
+ *          instead of a path flushes and closes the log and removes the
+ *          timer, which otherwise keeps the server referenced.
+ * \param   L     lua Virtual Machine.
+ * \lparam  userdata  struct t_htp_srv.
+ * \lparam  string    path to the log file or false to disable it.
+ * \lparam  int       number of records in the ring.
+ * \lparam  int       flush interval in milliseconds.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_htp_srv_accesslog( lua_State *L )
+{
+	struct t_htp_srv *s    = t_htp_srv_check_ud( L, 1, 1 );
+	const char       *path;
+	lua_Integer       sz   = luaL_optinteger( L, 3, T_HTP_LOG_SZ );
+	lua_Integer       ms   = luaL_optinteger( L, 4, T_HTP_LOG_IV );
+	struct timeval   *tv;
+
+	if (lua_isboolean( L, 2 ) && ! lua_toboolean( L, 2 ))
+	{
+		if (NULL != s->log)
+		{
+			t_htp_log_destroy( s->log );
+			s->log = NULL;
+		}
+		if (LUA_NOREF != s->tR)
+		{
+			// loop:removeTimer( tm )
+			lua_rawgeti( L, LUA_REGISTRYINDEX, s->lR );
+			lua_getfield( L, -1, "removeTimer" );
+			lua_insert( L, -2 );
+			lua_rawgeti( L, LUA_REGISTRYINDEX, s->tR );
+			lua_call( L, 2, 0 );
+			luaL_unref( L, LUA_REGISTRYINDEX, s->tR );
+			s->tR = LUA_NOREF;
+		}
+		return 0;
+	}
+	path = luaL_checkstring( L, 2 );
+	luaL_argcheck( L, sz > 0, 3, "size of the access log must be positive" );
+	luaL_argcheck( L, ms > 0, 4, "flush interval must be positive" );
+	if (NULL != s->log)
+		return t_push_error( L, "T.Http.Server access log is already enabled" );
+	s->log = t_htp_log_create( path, (size_t) sz );
+	if (NULL == s->log)
+		return t_push_error( L, "Can't open access log `%s`", path );
+
+	// loop:addTimer( tm, flushtimer, srv, interval )
+	lua_rawgeti( L, LUA_REGISTRYINDEX, s->lR );
+	lua_getfield( L, -1, "addTimer" );
+	lua_insert( L, -2 );
+	tv = t_tim_create_ud( L );
+	tv->tv_sec  = ms / 1000;
+	tv->tv_usec = (ms % 1000) * 1000;
+	lua_pushvalue( L, -1 );
+	s->tR = luaL_ref( L, LUA_REGISTRYINDEX );
+	lua_pushcfunction( L, lt_htp_srv_flushtimer );
+	lua_pushvalue( L, 1 );
+	tv = t_tim_create_ud( L );
+	tv->tv_sec  = ms / 1000;
+	tv->tv_usec = (ms % 1000) * 1000;
+	lua_call( L, 5, 0 );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Snapshot of the servers counters.
+ * \param   L     lua Virtual Machine.
+ * \lparam  userdata  struct t_htp_srv.
+ * \lreturn table     counters of the server.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_htp_srv_stats( lua_State *L )
+{
+	struct t_htp_srv *s = t_htp_srv_check_ud( L, 1, 1 );
+
+	lua_createtable( L, 0, 6 );
+	lua_pushinteger( L, (lua_Integer) s->sts.acc );
+	lua_setfield( L, -2, "accepted" );
+	lua_pushinteger( L, (lua_Integer) s->sts.cls );
+	lua_setfield( L, -2, "closed" );
+	lua_pushinteger( L, (lua_Integer) s->sts.rqs );
+	lua_setfield( L, -2, "requests" );
+	lua_pushinteger( L, (lua_Integer) s->sts.bin );
+	lua_setfield( L, -2, "bytesIn" );
+	lua_pushinteger( L, (lua_Integer) s->sts.bot );
+	lua_setfield( L, -2, "bytesOut" );
+	lua_pushinteger( L, (lua_Integer) s->sts.str );
+	lua_setfield( L, -2, "streams" );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push the servers and its loops metrics in text exposition format.
+ * \param   L     lua Virtual Machine.
+ * \param   struct t_htp_srv*  the server.
+ *  -------------------------------------------------------------------------*/
+void
+t_htp_srv_metrics( lua_State *L, struct t_htp_srv *s )
+{
+	luaL_Buffer lB;
+	char        b[ 1024 ];
+	int         n;
+
+	n = snprintf( b, sizeof( b ),
+		"# TYPE t_http_connections_accepted_total counter\n"
+		"t_http_connections_accepted_total %" PRIu64 "\n"
+		"# TYPE t_http_connections_closed_total counter\n"
+		"t_http_connections_closed_total %" PRIu64 "\n"
+		"# TYPE t_http_requests_total counter\n"
+		"t_http_requests_total %" PRIu64 "\n"
+		"# TYPE t_http_received_bytes_total counter\n"
+		"t_http_received_bytes_total %" PRIu64 "\n"
+		"# TYPE t_http_sent_bytes_total counter\n"
+		"t_http_sent_bytes_total %" PRIu64 "\n"
+		"# TYPE t_http_streams gauge\n"
+		"t_http_streams %" PRIu64 "\n",
+		s->sts.acc, s->sts.cls, s->sts.rqs, s->sts.bin, s->sts.bot, s->sts.str );
+	luaL_buffinit( L, &lB );
+	luaL_addlstring( &lB, b, n );
+	t_ael_metrics( &lB, s->ael );
+	luaL_pushresult( &lB );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Serve the servers metrics from a built-in endpoint.
+ * \detail  Requests to the url are answered in text exposition format and
+ *          never reach the request handler.
+ * \param   L     lua Virtual Machine.
+ * \lparam  userdata  struct t_htp_srv.
+ * \lparam  string    url of the endpoint; default "/metrics"; false disables.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_htp_srv_metrics( lua_State *L )
+{
+	struct t_htp_srv *s = t_htp_srv_check_ud( L, 1, 1 );
+
+	luaL_unref( L, LUA_REGISTRYINDEX, s->mR );
+	s->mR = LUA_NOREF;
+	if (lua_isboolean( L, 2 ) && ! lua_toboolean( L, 2 ))
+		return 0;
+	if (lua_isnoneornil( L, 2 ))
+		lua_pushstring( L, "/metrics" );
+	else
+	{
+		luaL_checkstring( L, 2 );
+		lua_pushvalue( L, 2 );
+	}
+	s->mR = luaL_ref( L, LUA_REGISTRYINDEX );
+	return 0;
+}
+
+
 /**--------------------------------------------------------------------------
  * __tostring (print) representation of an T.Http.Server  instance.
  * \param   L      The lua state.
@@ -266,8 +487,17 @@ lt_htp_srv__gc( lua_State *L )
 	luaL_unref( L, LUA_REGISTRYINDEX, s->aR );
 	luaL_unref( L, LUA_REGISTRYINDEX, s->lR );
 	luaL_unref( L, LUA_REGISTRYINDEX, s->rR );
+	luaL_unref( L, LUA_REGISTRYINDEX, s->mR );
+	luaL_unref( L, LUA_REGISTRYINDEX, s->tR );
+	if (NULL != s->log)
+	{
+		t_htp_log_destroy( s->log );
+		s->log = NULL;
+	}
 
+#if PRINT_DEBUGS == 1
 	printf("GC'ed HTTP Server...\n");
+#endif
 
 	return 0;
 }
@@ -298,6 +528,10 @@ static const luaL_Reg t_htp_srv_m [] = {
 	{ "__gc",          lt_htp_srv__gc },
 	{ "__tostring",    lt_htp_srv__tostring },
 	{ "listen",        lt_htp_srv_listen },
+	{ "accessLog",     lt_htp_srv_accesslog },
+	{ "flushLog",      lt_htp_srv_flushlog },
+	{ "stats",         lt_htp_srv_stats },
+	{ "metrics",       lt_htp_srv_metrics },
 	{ NULL,    NULL }
 };
 
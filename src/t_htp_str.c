@@ -10,6 +10,7 @@
 
 #include <stdlib.h>               // malloc, free
 #include <string.h>               // strchr, ...
+#include <sys/time.h>             // gettimeofday
 
 #include "t.h"
 #include "t_htp.h"
@@ -33,11 +34,15 @@ struct t_htp_str
 	s->rqCl    = 0;                 ///< request  content length
 	s->rsCl    = 0;                 ///< response content length
 	s->rsBl    = 0;                 ///< response buffer length (headers + rsCl)
+	s->rsSl    = 0;                 ///< response buffer sent length
+	s->rsCd    = 0;                 ///< response status code
 	s->bR      = 0;                 ///< Lua registry reference to body handler function
 	s->state   = T_HTP_STR_ZERO;    ///< shall the connection return an expected thingy?
 	s->mth     = T_HTP_MTH_ILLEGAL; ///< HTTP Message state
 	s->ver     = T_HTP_VER_09;      ///< HTTP Method for this request
 	s->con     = con;               ///< connection
+	con->srv->sts.str++;
+	gettimeofday( &s->rqTm, 0 );
 
 	luaL_getmetatable( L, "T.Http.Stream" );
 	lua_setmetatable( L, -2 );
@@ -61,6 +66,50 @@ struct t_htp_str
 }
 
 
+static int lt_htp_str_writeHead( lua_State *L );
+static int lt_htp_str_finish( lua_State *L );
+
+
+/**--------------------------------------------------------------------------
+ * Answer a request to the servers metrics endpoint.
+ * \detail  Expects the streams proxy table on top of the stack and the stream
+ *          at stack position 2.
+ * \param  L            lua Virtual Machine.
+ * \param  struct t_htp_str struct t_htp_str.
+ * \return  integer         1 if the request was answered, 0 otherwise.
+ *  -------------------------------------------------------------------------*/
+static int
+t_htp_str_metrics( lua_State *L, struct t_htp_str *s )
+{
+	size_t len;
+	int    eq;
+
+	lua_getfield( L, -1, "url" );
+	lua_rawgeti( L, LUA_REGISTRYINDEX, s->con->srv->mR );
+	eq = lua_rawequal( L, -1, -2 );
+	lua_pop( L, 2 );
+	if (! eq)
+		return 0;
+
+	t_htp_srv_metrics( L, s->con->srv );
+	lua_tolstring( L, -1, &len );
+	lua_pushcfunction( L, lt_htp_str_writeHead );
+	lua_pushvalue( L, 2 );
+	lua_pushinteger( L, 200 );
+	lua_pushinteger( L, (lua_Integer) len );
+	lua_createtable( L, 0, 1 );
+	lua_pushstring( L, "text/plain; version=0.0.4" );
+	lua_setfield( L, -2, "Content-Type" );
+	lua_call( L, 4, 0 );
+	lua_pushcfunction( L, lt_htp_str_finish );
+	lua_pushvalue( L, 2 );
+	lua_pushvalue( L, -3 );
+	lua_call( L, 2, 0 );
+	lua_pop( L, 1 );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Handle incoming chunks from T.Http.Connection socket.
  * Called anytime the client socket returns from the poll for read.
@@ -88,11 +137,17 @@ t_htp_str_rcv( lua_State *L, struct t_htp_str *s, size_t rcvd )
 				break;
 			case T_HTP_STR_HEADDONE:
 				s->con->cnt++;
-				lua_pop( L, 1 );      // pop s->pR
-				// execute function from server
-				lua_rawgeti( L, LUA_REGISTRYINDEX, s->con->srv->rR );
-				lua_pushvalue( L, 2 );
-				lua_call( L, 1, 0 );
+				s->con->srv->sts.rqs++;
+				if (LUA_NOREF != s->con->srv->mR && t_htp_str_metrics( L, s ))
+					lua_pop( L, 1 );      // pop s->pR
+				else
+				{
+					lua_pop( L, 1 );      // pop s->pR
+					// execute function from server
+					lua_rawgeti( L, LUA_REGISTRYINDEX, s->con->srv->rR );
+					lua_pushvalue( L, 2 );
+					lua_call( L, 1, 0 );
+				}
 				// if request has content length keep reading body, else stop reading
 				if (s->rqCl > 0 )
 				{
@@ -142,7 +197,9 @@ t_htp_str_addbuffer( lua_State *L, struct t_htp_str *s, size_t l, int last )
 	struct t_htp_con *c = s->con;
 	struct t_htp_buf *b = malloc( sizeof( struct t_htp_buf ) );
 
+#if PRINT_DEBUGS == 1
 	printf( "Add Buffer: %zu bytes\n", l );
+#endif
 	b->bl   = l;
 	b->sl   = 0;
 	b->bR   = luaL_ref( L, LUA_REGISTRYINDEX );
@@ -191,6 +248,8 @@ t_htp_str_formHeader( lua_State *L, luaL_Buffer *lB, struct t_htp_str *s,
 	size_t   bs;      ///< chars added currently to buffers
 	char    *b = luaL_prepbuffer( lB );
 
+	s->rsCd = code;
+
 	if (len)
 	{
 		bs = sprintf( b,
@@ -234,14 +293,14 @@ t_htp_str_formHeader( lua_State *L, luaL_Buffer *lB, struct t_htp_str *s,
 		lua_pushnil( L );
 		while (lua_next( L, t ))
 		{
-			bs += sprintf( b,
+			bs += sprintf( b + bs,
 				"%s: %s\r\n",
 				lua_tostring( L, -2 ),
 				lua_tostring( L, -1 )
 				);
 			lua_pop( L, 1 );      //FIXME:  this can't pop, it must remove
 		}
-		bs += sprintf( b, "\r\n" );   // finish off the HTTP Headers part
+		bs += sprintf( b + bs, "\r\n" );   // finish off the HTTP Headers part
 		luaL_addsize( lB, bs );
 	}
 	c += bs;
@@ -559,9 +618,12 @@ lt_htp_str__gc( lua_State *L )
 	{
 		luaL_unref( L, LUA_REGISTRYINDEX, s->pR );
 		s->pR = LUA_NOREF;
+		s->con->srv->sts.str--;
 	}
 
+#if PRINT_DEBUGS == 1
 	printf( "GC'ed HTTP Stream: %p\n", s );
+#endif
 
 	return 0;
 }
@@ -26,6 +26,7 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <sys/uio.h>
 #endif
 #include "t_net.h"
 #include "t_buf.h"         // the ability to send and recv buffers
@@ -410,6 +411,43 @@ t_net_connect( lua_State *L, enum t_net_t t )
 }
 
 
+/** -------------------------------------------------------------------------
+ * Recieve from a socket directly into the writable region of a T.Buffer.
+ * \detail  The region gets defined by buffer, offset and maximum length at
+ *          pB, pB+1 and pB+2.  Ring buffers may wrap, hence recvmsg() with up
+ *          to two segments.
+ * \param   L    The lua state.
+ * \param   struct t_net*       the socket.
+ * \param   int                 stack position of the T.Buffer.
+ * \param   struct sockaddr_in* gets the sender assigned (may be NULL).
+ * \return  int  number of bytes recieved.
+ *-------------------------------------------------------------------------*/
+int
+t_net_recvinto( lua_State *L, struct t_net *s, int pB, struct sockaddr_in *ip )
+{
+	struct t_buf_spn  sp;
+	struct t_buf     *buf = t_buf_wspan( L, pB, pB+1, pB+2, &sp );
+	struct iovec      iov[ 2 ];
+	struct msghdr     mh;
+	ssize_t           rcvd;
+
+	memset( &mh, 0, sizeof( struct msghdr ) );
+	iov[ 0 ].iov_base = sp.p[ 0 ];
+	iov[ 0 ].iov_len  = sp.l[ 0 ];
+	iov[ 1 ].iov_base = sp.p[ 1 ];
+	iov[ 1 ].iov_len  = sp.l[ 1 ];
+	mh.msg_iov        = iov;
+	mh.msg_iovlen     = (sp.l[ 1 ] > 0) ? 2 : 1;
+	mh.msg_name       = ip;
+	mh.msg_namelen    = (NULL == ip) ? 0 : sizeof( struct sockaddr_in );
+
+	if ((rcvd = recvmsg( s->fd, &mh, 0 )) == -1)
+		return t_push_error( L, "Failed to recieve %s packet", t_net_t_lst[ s->t ] );
+	t_buf_commit( buf, &sp, (size_t) rcvd );
+	return (int) rcvd;
+}
+
+
 /** -------------------------------------------------------------------------
  * Helper to take sockets from Lua tables to FD_SET.
  * Itertates over the table puls out the socket structs and adds the actual
@@ -46,6 +46,8 @@ int          lt_net_getfdinfo   ( lua_State *L );
 int           t_net_listen      ( lua_State *L, int pos, enum t_net_t t );
 int           t_net_bind        ( lua_State *L, enum t_net_t t );
 int           t_net_connect     ( lua_State *L, enum t_net_t t );
+int           t_net_recvinto    ( lua_State *L, struct t_net *s, int pB,
+                                  struct sockaddr_in *ip );
 int          lt_net__tostring   ( lua_State *L );
 
 
@@ -57,6 +59,9 @@ int           t_net_tcp_send    ( lua_State *L, struct t_net *s, const char* buf
 int           t_net_tcp_accept  ( lua_State *L, int pos );
 
 // t_net_udp.c
+/// maximum number of datagrams handled by a single recvmany()/sendmany() call
+#define T_NET_UDP_MMSG    64
+
 int           luaopen_t_net_udp ( lua_State *L );
 struct t_net *t_net_udp_check_ud( lua_State *L, int pos, int check );
 
@@ -215,7 +215,7 @@ lt_net_tcp_send( lua_State *L )
 	if (lua_isuserdata( L, 2 ))
 	{
 		buf      = t_buf_check_ud( L, 2, 1 );
-		msg      = (char *) &(buf->b[ 0 ]);
+		msg      = (char *) t_buf_data( buf );
 		to_send  = buf->len;
 	}     // or is it a string
 	else if (lua_isstring( L, 2 ))
@@ -274,20 +274,43 @@ lt_net_tcp_recv( lua_State *L )
 	if (lua_isuserdata( L, 2 ))
 	{
 		buf  = t_buf_check_ud( L, 2, 1 );
-		rcv  = (char *) &(buf->b[ 0 ]);
+		rcv  = (char *) t_buf_data( buf );
 		len  = buf->len;
 	}
 
 	rcvd = t_net_tcp_recv( L, s, rcv, len );
 
 	// return buffer, length
-	lua_pushlstring( L, buffer, rcvd );
+	lua_pushlstring( L, rcv, rcvd );
 	lua_pushinteger( L, rcvd );
 
 	return 2;
 }
 
 
+/** -------------------------------------------------------------------------
+ * Recieve data from a TCP socket directly into a T.Buffer.
+ * \detail  No Lua string gets created; the data can be read in place.
+ * \param   L  The lua state.
+ * \lparam  socket   socket userdata.
+ * \lparam  T.Buffer buffer to recieve into.
+ * \lparam  int      offset in the buffer, zero based (opt, default 0;
+ *                   growable buffers append).
+ * \lparam  int      maximum bytes to recieve (opt, default rest of buffer;
+ *                   ring buffers recieve into their free space).
+ * \lreturn rcvd     number of bytes recieved.
+ * \return  int    # of values pushed onto the stack.
+ *-------------------------------------------------------------------------*/
+static int
+lt_net_tcp_recvinto( lua_State *L )
+{
+	struct t_net *s = t_net_tcp_check_ud( L, 1, 1 );
+
+	lua_pushinteger( L, t_net_recvinto( L, s, 2, NULL ) );
+	return 1;
+}
+
+
 /** -------------------------------------------------------------------------
  * Recieve IpEndpoint from a TCP socket.
  * \param   L  The lua state.
@@ -350,6 +373,7 @@ static const luaL_Reg t_net_tcp_m [] =
 	{ "close",       lt_net_close },
 	{ "send",        lt_net_tcp_send },
 	{ "recv",        lt_net_tcp_recv },
+	{ "recvInto",    lt_net_tcp_recvinto },
 	{ "getsockname", lt_net_tcp_getsockname },
 	// generic net functions -> reuse functions
 	{ "getId",       lt_net_getfdid },
@@ -8,6 +8,8 @@
  * \copyright See Copyright notice at the end of t.h
  */
 
+// recvmmsg()/sendmmsg() are GNU extensions
+#define _GNU_SOURCE       1
 
 #include "t.h"
 #ifdef _WIN32
@@ -26,6 +28,7 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <errno.h>
 #endif
 #include "t_net.h"
 #include "t_buf.h"         // the ability to send and recv buffers
@@ -155,7 +158,7 @@ lt_net_udp_sendto( lua_State *L )
 	else if (lua_isuserdata( L, 3 ))
 	{
 		buf  = t_buf_check_ud( L, 3, 1 );
-		msg  = (char *) &(buf->b[ 0 ]);
+		msg  = (char *) t_buf_data( buf );
 		len  = buf->len;
 	}
 	else
@@ -194,12 +197,12 @@ lt_net_udp_recvfrom( lua_State *L )
 	char               *rcv = &(buffer[ 0 ]);
 	int                 len = sizeof( buffer )-1;
 
-	unsigned int        slen = sizeof( si_cli );
+	socklen_t           slen = sizeof( struct sockaddr_in );
 
 	s = t_net_udp_check_ud( L, 1, 1 );
 	if (lua_isuserdata( L, 2 )) {
 		buf  = t_buf_check_ud ( L, 2, 1 );
-		rcv  = (char *) &(buf->b[ 0 ]);
+		rcv  = (char *) t_buf_data( buf );
 		len  = buf->len;
 	}
 	si_cli = t_net_ip4_create_ud( L );
@@ -219,6 +222,225 @@ lt_net_udp_recvfrom( lua_State *L )
 }
 
 
+/** -------------------------------------------------------------------------
+ * Recieve a Datagram from a UDP socket directly into a T.Buffer.
+ * \detail  No Lua string gets created; the data can be read in place.  If an
+ *          IpEndpoint is passed it gets the sender assigned.
+ * \param   L  The lua state.
+ * \lparam  socket   socket userdata.
+ * \lparam  T.Buffer buffer to recieve into.
+ * \lparam  int      offset in the buffer, zero based (opt, default 0;
+ *                   growable buffers append).
+ * \lparam  int      maximum bytes to recieve (opt, default rest of buffer;
+ *                   ring buffers recieve into their free space).
+ * \lparam  ip       T.Net.IPv4 userdata (opt).
+ * \lreturn rcvd     number of bytes recieved.
+ * \return  int    # of values pushed onto the stack.
+ *-------------------------------------------------------------------------*/
+static int
+lt_net_udp_recvinto( lua_State *L )
+{
+	struct t_net       *s  = t_net_udp_check_ud( L, 1, 1 );
+	struct sockaddr_in *ip = t_net_ip4_check_ud( L, 5, 0 );
+
+	lua_pushinteger( L, t_net_recvinto( L, s, 2, ip ) );
+	return 1;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Recieve a batch of Datagrams from a UDP socket.
+ * \detail  Blocks until at least one datagram arrived and then picks up what
+ *          else is already queued without blocking.  Each datagram goes into
+ *          the T.Buffer of the same index like recvInto() would put it;
+ *          growable and ring buffers get it appended.  No strings or
+ *          addresses are created.  At most T_NET_UDP_MMSG datagrams are
+ *          handled per call.
+ * \param   L  The lua state.
+ * \lparam  socket socket userdata.
+ * \lparam  table  T.Buffer for each datagram.
+ * \lparam  int    maximum number of datagrams, defaults to #buffers.
+ * \lparam  table  T.Net.IPv4 for each datagram, filled with the sender (opt).
+ * \lparam  table  gets the length of each datagram assigned (opt).
+ * \lreturn rcvd   number of datagrams recieved.
+ * \return  int    # of values pushed onto the stack.
+ *-------------------------------------------------------------------------*/
+static int
+lt_net_udp_recvmany( lua_State *L )
+{
+	struct t_net       *s   = t_net_udp_check_ud( L, 1, 1 );
+	int                 n;
+	int                 hA  = ! lua_isnoneornil( L, 4 );
+	int                 hL  = ! lua_isnoneornil( L, 5 );
+	struct sockaddr_in *ip  [ T_NET_UDP_MMSG ];
+	struct iovec        iov [ T_NET_UDP_MMSG ][ 2 ];
+	struct t_buf_spn    sp  [ T_NET_UDP_MMSG ];
+	struct t_buf       *buf [ T_NET_UDP_MMSG ];
+	int                 i, rcvd;
+#ifdef __linux__
+	struct mmsghdr      msg [ T_NET_UDP_MMSG ];
+#else
+	struct msghdr       mh;
+	ssize_t             r;
+#endif
+
+	luaL_checktype( L, 2, LUA_TTABLE );
+	n = (int) luaL_optinteger( L, 3, luaL_len( L, 2 ) );
+	if (hA) luaL_checktype( L, 4, LUA_TTABLE );
+	if (hL) luaL_checktype( L, 5, LUA_TTABLE );
+	luaL_argcheck( L, n > 0, 3, "must receive at least one datagram" );
+	n = (n > T_NET_UDP_MMSG) ? T_NET_UDP_MMSG : n;
+
+	for (i=0; i<n; i++)
+	{
+		// the free space of a ring may wrap into a second segment
+		lua_rawgeti( L, 2, i+1 );
+		lua_pushnil( L );
+		lua_pushnil( L );
+		buf[ i ] = t_buf_wspan( L, -3, -2, -1, &(sp[ i ]) );
+		iov[ i ][ 0 ].iov_base = sp[ i ].p[ 0 ];
+		iov[ i ][ 0 ].iov_len  = sp[ i ].l[ 0 ];
+		iov[ i ][ 1 ].iov_base = sp[ i ].p[ 1 ];
+		iov[ i ][ 1 ].iov_len  = sp[ i ].l[ 1 ];
+		ip[ i ] = NULL;
+		if (hA)
+		{
+			lua_rawgeti( L, 4, i+1 );
+			ip[ i ] = t_net_ip4_check_ud( L, -1, 1 );
+			lua_pop( L, 1 );
+		}
+		lua_pop( L, 3 );
+	}
+
+#ifdef __linux__
+	memset( msg, 0, n * sizeof( struct mmsghdr ) );
+	for (i=0; i<n; i++)
+	{
+		msg[ i ].msg_hdr.msg_iov     = iov[ i ];
+		msg[ i ].msg_hdr.msg_iovlen  = (sp[ i ].l[ 1 ] > 0) ? 2 : 1;
+		msg[ i ].msg_hdr.msg_name    = ip[ i ];
+		msg[ i ].msg_hdr.msg_namelen = (NULL == ip[ i ]) ? 0 : sizeof( struct sockaddr_in );
+	}
+	do
+		rcvd = recvmmsg( s->fd, msg, n, MSG_WAITFORONE, NULL );
+	while (-1 == rcvd && EINTR == errno);
+	if (-1 == rcvd)
+		return t_push_error( L, "Failed to recieve UDP packets" );
+	for (i=0; i<rcvd; i++)
+	{
+		t_buf_commit( buf[ i ], &(sp[ i ]), msg[ i ].msg_len );
+		if (hL)
+		{
+			lua_pushinteger( L, msg[ i ].msg_len );
+			lua_rawseti( L, 5, i+1 );
+		}
+	}
+#else
+	for (rcvd=0; rcvd<n; rcvd++)
+	{
+		memset( &mh, 0, sizeof( struct msghdr ) );
+		mh.msg_iov     = iov[ rcvd ];
+		mh.msg_iovlen  = (sp[ rcvd ].l[ 1 ] > 0) ? 2 : 1;
+		mh.msg_name    = ip[ rcvd ];
+		mh.msg_namelen = (NULL == ip[ rcvd ]) ? 0 : sizeof( struct sockaddr_in );
+		r = recvmsg( s->fd, &mh, (rcvd > 0) ? MSG_DONTWAIT : 0 );
+		if (-1 == r)
+		{
+			if (rcvd > 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+				break;
+			return t_push_error( L, "Failed to recieve UDP packets" );
+		}
+		t_buf_commit( buf[ rcvd ], &(sp[ rcvd ]), (size_t) r );
+		if (hL)
+		{
+			lua_pushinteger( L, r );
+			lua_rawseti( L, 5, rcvd+1 );
+		}
+	}
+#endif
+
+	lua_pushinteger( L, rcvd );
+	return 1;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Send a batch of Datagrams over a UDP socket.
+ * \detail  Each element of the list is a table { ip, msg } where msg is a
+ *          string or a T.Buffer; ip may be nil on a connected socket.  The
+ *          datagrams are handed to the kernel T_NET_UDP_MMSG at a time.
+ * \param   L  The lua state.
+ * \lparam  socket socket userdata.
+ * \lparam  table  list of { ip, msg }.
+ * \lreturn sent   number of datagrams sent.
+ * \return  int    # of values pushed onto the stack.
+ *-------------------------------------------------------------------------*/
+static int
+lt_net_udp_sendmany( lua_State *L )
+{
+	struct t_net       *s   = t_net_udp_check_ud( L, 1, 1 );
+	int                 n;
+	struct sockaddr_in *ip  [ T_NET_UDP_MMSG ];
+	struct iovec        iov [ T_NET_UDP_MMSG ];
+	int                 i, c, sent, done = 0;
+	size_t              len;
+#ifdef __linux__
+	struct mmsghdr      msg [ T_NET_UDP_MMSG ];
+#endif
+
+	luaL_checktype( L, 2, LUA_TTABLE );
+	n = (int) luaL_len( L, 2 );
+	while (done < n)
+	{
+		c = (n - done > T_NET_UDP_MMSG) ? T_NET_UDP_MMSG : n - done;
+		for (i=0; i<c; i++)
+		{
+			if (LUA_TTABLE != lua_rawgeti( L, 2, done+i+1 ))
+				return luaL_argerror( L, 2, "list of { ip, msg } expected" );
+			lua_rawgeti( L, -1, 1 );
+			ip[ i ] = t_net_ip4_check_ud( L, -1, 0 );
+			lua_rawgeti( L, -2, 2 );
+			// the string stays referenced by the list while sending
+			iov[ i ].iov_base = (void *) t_buf_checklstring( L, -1, &len );
+			iov[ i ].iov_len  = len;
+			lua_pop( L, 3 );
+		}
+#ifdef __linux__
+		memset( msg, 0, c * sizeof( struct mmsghdr ) );
+		for (i=0; i<c; i++)
+		{
+			msg[ i ].msg_hdr.msg_iov     = &(iov[ i ]);
+			msg[ i ].msg_hdr.msg_iovlen  = 1;
+			msg[ i ].msg_hdr.msg_name    = ip[ i ];
+			msg[ i ].msg_hdr.msg_namelen = (NULL == ip[ i ]) ? 0 : sizeof( struct sockaddr_in );
+		}
+		do
+			sent = sendmmsg( s->fd, msg, c, 0 );
+		while (-1 == sent && EINTR == errno);
+#else
+		for (sent=0; sent<c; sent++)
+			if (-1 == sendto( s->fd, iov[ sent ].iov_base, iov[ sent ].iov_len, 0,
+			                  (struct sockaddr *) ip[ sent ],
+			                  (NULL == ip[ sent ]) ? 0 : sizeof( struct sockaddr_in ) ))
+				break;
+		sent = (0 == sent) ? -1 : sent;
+#endif
+		if (-1 == sent)
+		{
+			if (done > 0)
+				break;
+			return t_push_error( L, "Failed to send UDP packets" );
+		}
+		done += sent;
+		if (sent < c)
+			break;
+	}
+
+	lua_pushinteger( L, done );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Class metamethods library definition
  * --------------------------------------------------------------------------*/
@@ -255,6 +477,9 @@ static const luaL_Reg t_net_udp_m [] =
 	{ "close",       lt_net_close },
 	{ "sendto",      lt_net_udp_sendto },
 	{ "recvfrom",    lt_net_udp_recvfrom },
+	{ "recvInto",    lt_net_udp_recvinto },
+	{ "recvmany",    lt_net_udp_recvmany },
+	{ "sendmany",    lt_net_udp_sendmany },
 	// generic net functions -> reuse functions
 	{ "getId",       lt_net_getfdid },
 	{ "getFdInfo",   lt_net_getfdinfo },
@@ -14,6 +14,15 @@
 
 #include "t.h"
 #include "t_buf.h"
+#ifdef T_NRY
+#include "t_nry.h"
+#endif
+
+// vectorized byte swapping; selected at runtime by the CPU's capabilities
+#if defined( __GNUC__ ) && (defined( __x86_64__ ) || defined( __i386__ ))
+#define T_PCK_X86          1
+#include <immintrin.h>
+#endif
 
 // ========== Buffer accessor Helpers
 
@@ -29,14 +38,17 @@
 // Maximum bits that can be read or written
 #define MXBIT              MXINT * NB
 
-// Macro helpers
-#define BIT_GET(b,n)       ( ((b) >> (NB-(n))) & 0x01 )
+// Macro helpers; n is the bit offset in the byte, MSB 0
+#define BIT_GET(b,n)       ( ((b) >> (NB-1-(n))) & 0x01 )
 #define BIT_SET(b,n,v)     \
 	( (1==v)              ? \
-	 ((b) | (  (0x01) << (NB-(n))))    : \
-	 ((b) & (~((0x01) << (NB-(n))))) )
+	 ((b) | (  (0x01) << (NB-1-(n))))    : \
+	 ((b) & (~((0x01) << (NB-1-(n))))) )
+
 
 
+// bytes of native values converted at once by bulk Array reads
+#define T_PCK_BULK         512
 
 // global default for T.Pack, can be flipped
 #ifdef IS_LITTLE_ENDIAN
@@ -45,8 +57,23 @@ static int _default_endian = 1;
 static int _default_endian = 0;
 #endif
 
+/// the address is the key of the parent in the uservalue of lazy Readers
+static const char _reader_parent = 0;
+
+/// the address is the key of the Reader cache in the uservalue of indexed
+/// objects and the registry key of the caches weak valued metatable
+static const char _reader_cache = 0;
+
+/// the address is the registry key of the packers compiled from fmt strings
+static const char _fmt_cache = 0;
+
 // Declaration because of circular dependency
 static struct t_pck *t_pck_mksequence( lua_State *L, int sp, int ep, size_t *bo );
+static int           t_pck_isbulk    ( struct t_pck *p );
+static int           t_pck_readbulk  ( lua_State *L, struct t_pck *p, const unsigned char *b,
+                                       size_t st, size_t n, int pT );
+static size_t        t_pck_writel    ( lua_State *L, struct t_pck *pc, unsigned char *b, size_t l );
+static unsigned char *t_pck_locate   ( lua_State *L, int pP, int pS, struct t_pck **pcp, size_t *l );
 
 
 // Function helpers
@@ -60,15 +87,22 @@ static struct t_pck *t_pck_mksequence( lua_State *L, int sp, int ep, size_t *bo
 static void
 t_pck_cbytes( unsigned char * dst, const unsigned char * src, size_t sz, int islittle )
 {
+	uint16_t v2;
+	uint32_t v4;
+	uint64_t v8;
+
 	if (IS_LITTLE_ENDIAN == islittle)
-		while (sz-- != 0)
-			*(dst++) = *(src+sz);
+		switch (sz)
+		{
+			case 2: memcpy( &v2, src, 2 ); v2 = __builtin_bswap16( v2 ); memcpy( dst, &v2, 2 ); break;
+			case 4: memcpy( &v4, src, 4 ); v4 = __builtin_bswap32( v4 ); memcpy( dst, &v4, 4 ); break;
+			case 8: memcpy( &v8, src, 8 ); v8 = __builtin_bswap64( v8 ); memcpy( dst, &v8, 8 ); break;
+			default:
+				while (sz-- != 0)
+					*(dst++) = *(src+sz);
+		}
 	else
-	{
-		src = src+sz-1;
-		while (sz-- != 0)
-			*(dst++) = *(src-sz);
-	}
+		memcpy( dst, src, sz );
 }
 
 
@@ -88,7 +122,7 @@ t_pck_wbits( lua_Unsigned val, size_t len, size_t ofs, unsigned char * buf )
 	size_t     abyt = ((len+ofs-1)/NB) + 1;
 	size_t     abit = abyt* 8;
 
-	msk = (-1 << (MXBIT-len)) >> (MXBIT-abit+ofs);
+	msk = ((lua_Unsigned) -1 << (MXBIT-len)) >> (MXBIT-abit+ofs);
 #ifdef IS_LITTLE_ENDIAN
 	t_pck_cbytes( (unsigned char *) &set, buf, abyt, 1);
 #else
@@ -126,6 +160,125 @@ t_pck_wbits( lua_Unsigned val, size_t len, size_t ofs, unsigned char * buf )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Copy n elements of sz bytes each and reverse the bytes of each.
+ * \param   dst       pointer to char array to write to.
+ * \param   src       pointer to char array to read from.
+ * \param   sz        size of an element in bytes.
+ * \param   n         number of elements.
+ * --------------------------------------------------------------------------*/
+static void
+t_pck_swapscalar( unsigned char *dst, const unsigned char *src, size_t sz, size_t n )
+{
+	size_t i;
+
+	for (; n > 0; n--, dst += sz, src += sz)
+		switch (sz)
+		{
+			case 2: t_pck_cbytes( dst, src, 2, IS_LITTLE_ENDIAN ); break;
+			case 4: t_pck_cbytes( dst, src, 4, IS_LITTLE_ENDIAN ); break;
+			case 8: t_pck_cbytes( dst, src, 8, IS_LITTLE_ENDIAN ); break;
+			default:
+				for (i=0; i<sz; i++)
+					dst[ i ] = src[ sz-1-i ];
+		}
+}
+
+
+#ifdef T_PCK_X86
+/**--------------------------------------------------------------------------
+ * Shuffle mask reversing each element of sz (2, 4 or 8) bytes in 16 bytes.
+ * --------------------------------------------------------------------------*/
+#define T_PCK_SWAPMASK( sz )                                               \
+	((2 == (sz))                                                            \
+	 ? _mm_setr_epi8( 1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14 )        \
+	 : ((4 == (sz))                                                         \
+	    ? _mm_setr_epi8( 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12 )         \
+	    : _mm_setr_epi8( 7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8 )))
+
+
+/**--------------------------------------------------------------------------
+ * Reverse the bytes of elements of 2, 4 or 8 bytes, 16 bytes per step.
+ * \param   dst       pointer to char array to write to.
+ * \param   src       pointer to char array to read from.
+ * \param   sz        size of an element in bytes.
+ * \param   n         number of elements.
+ * --------------------------------------------------------------------------*/
+__attribute__ ((target( "ssse3" )))
+static void
+t_pck_swapssse3( unsigned char *dst, const unsigned char *src, size_t sz, size_t n )
+{
+	__m128i msk = T_PCK_SWAPMASK( sz );
+	size_t  l   = sz*n;
+	size_t  i;
+
+	for (i=0; i+16 <= l; i += 16)
+		_mm_storeu_si128( (__m128i *) (dst+i),
+			_mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) (src+i) ), msk ) );
+	t_pck_swapscalar( dst+i, src+i, sz, (l-i)/sz );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reverse the bytes of elements of 2, 4 or 8 bytes, 32 bytes per step.
+ * \param   dst       pointer to char array to write to.
+ * \param   src       pointer to char array to read from.
+ * \param   sz        size of an element in bytes.
+ * \param   n         number of elements.
+ * --------------------------------------------------------------------------*/
+__attribute__ ((target( "avx2" )))
+static void
+t_pck_swapavx2( unsigned char *dst, const unsigned char *src, size_t sz, size_t n )
+{
+	// the shuffle works within each 16 byte lane; elements never cross them
+	__m128i m   = T_PCK_SWAPMASK( sz );
+	__m256i msk = _mm256_broadcastsi128_si256( m );
+	size_t  l   = sz*n;
+	size_t  i;
+
+	for (i=0; i+32 <= l; i += 32)
+		_mm256_storeu_si256( (__m256i *) (dst+i),
+			_mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i *) (src+i) ), msk ) );
+	t_pck_swapscalar( dst+i, src+i, sz, (l-i)/sz );
+}
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Copy n elements of sz bytes each and reverse the bytes of each if asked to.
+ * Elements of 2, 4 and 8 bytes get swapped with the widest vector
+ * instructions the CPU supports.
+ * \param   dst       pointer to char array to write to.
+ * \param   src       pointer to char array to read from.
+ * \param   sz        size of an element in bytes.
+ * \param   n         number of elements.
+ * \param   swp       reverse the byte order of each element?
+ * --------------------------------------------------------------------------*/
+static void
+t_pck_swap( unsigned char *dst, const unsigned char *src, size_t sz, size_t n, int swp )
+{
+#ifdef T_PCK_X86
+	static int simd = -1;  ///< 0 = scalar, 1 = SSSE3, 2 = AVX2
+
+	if (simd < 0)
+	{
+		__builtin_cpu_init( );
+		simd = (__builtin_cpu_supports( "avx2" )) ? 2 : (__builtin_cpu_supports( "ssse3" )) ? 1 : 0;
+	}
+#endif
+	if (! swp || 1 == sz)
+		memcpy( dst, src, sz*n );
+#ifdef T_PCK_X86
+	else if ((2 == sz || 4 == sz || 8 == sz) && 2 == simd)
+		t_pck_swapavx2( dst, src, sz, n );
+	else if ((2 == sz || 4 == sz || 8 == sz) && 1 == simd)
+		t_pck_swapssse3( dst, src, sz, n );
+#endif
+	else
+		t_pck_swapscalar( dst, src, sz, n );
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // ================================= GENERIC t_pck API ========================
@@ -194,7 +347,7 @@ t_pck_read( lua_State *L, struct t_pck *p, const unsigned char *b )
 					(p->s+p->m-1)/8 + 1,
 					0 );
 #endif
-				val = (val << (MXBIT- ((p->s/NB+1)*NB) + p->m ) ) >> (MXBIT - p->s);
+				val = (val << (MXBIT- (((p->s+p->m-1)/NB+1)*NB) + p->m ) ) >> (MXBIT - p->s);
 				lua_pushinteger( L, (lua_Integer) ((val ^ msk) - msk) );
 			}
 			break;
@@ -213,7 +366,7 @@ t_pck_read( lua_State *L, struct t_pck *p, const unsigned char *b )
 					(p->s+p->m-1)/8 + 1,
 					0 );
 #endif
-				val = (val << (MXBIT- ((p->s/NB+1)*NB) + p->m ) ) >> (MXBIT - p->s);
+				val = (val << (MXBIT- (((p->s+p->m-1)/NB+1)*NB) + p->m ) ) >> (MXBIT - p->s);
 				lua_pushinteger( L, (lua_Integer) val );
 			}
 			break;
@@ -257,13 +410,15 @@ t_pck_write( lua_State *L, struct t_pck *p, unsigned char *b )
 		case T_PCK_INT:
 			intVal = luaL_checkinteger( L, -1 );
 			val    = (lua_Unsigned) intVal;
-			if (0>intVal && p->s != MXINT)
+			if (p->s != MXINT)
 			{
+				// two's complement range of the packer size; positive values
+				// up to the unsigned maximum were always accepted and wrap
 				msk = (lua_Unsigned) 1  << (p->s*NB - 1);
-				val = ((val ^ msk) - msk);
+				luaL_argcheck( L,  val + msk < (msk << 1) || 0 == (val >> (p->s*NB)), -1,
+				   "value to pack must be smaller than the maximum value for the packer size" );
+				val = val & ((msk << 1) - 1);
 			}
-			luaL_argcheck( L,  0 == (val >> (p->s*NB)) , -1,
-			   "value to pack must be smaller than the maximum value for the packer size" );
 			if (1==p->s)
 				*b = (char) val;
 			else
@@ -308,7 +463,7 @@ t_pck_write( lua_State *L, struct t_pck *p, unsigned char *b )
 			luaL_argcheck( L,  0 == (val >> p->s) , -1,
 			   "value to pack must be smaller than the maximum value for the packer size" );
 			if (p->s == 1)
-				*b = BIT_SET( *b, p->m, lua_toboolean( L, -1 ) );
+				*b = BIT_SET( *b, p->m, (int) (val & 0x01) );
 			else
 				t_pck_wbits( val, p->s, p->m, b );
 			break;
@@ -317,7 +472,7 @@ t_pck_write( lua_State *L, struct t_pck *p, unsigned char *b )
 			luaL_argcheck( L,  0 == (intVal >> p->s) , -1,
 			   "value to pack must be smaller than the maximum value for the packer size" );
 			if (p->s == 1)
-				*b = BIT_SET( *b, p->m, lua_toboolean( L, -1 ) );
+				*b = BIT_SET( *b, p->m, (int) (intVal & 0x01) );
 			else
 				t_pck_wbits( (lua_Unsigned) intVal, p->s, p->m, b );
 			break;
@@ -339,6 +494,189 @@ t_pck_write( lua_State *L, struct t_pck *p, unsigned char *b )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Decode a LEB128 varint.
+ * \param   b     pointer to the first byte.
+ * \param   l     number of bytes available.
+ * \param   v     pointer to lua_Unsigned gets the value assigned.
+ * \return  size_t number of bytes of the varint; 0 if truncated or too long.
+ * -------------------------------------------------------------------------- */
+static size_t
+t_pck_getvarint( const unsigned char *b, size_t l, lua_Unsigned *v )
+{
+	size_t n;
+
+	*v = 0;
+	for (n=0; n < l && n*7 < MXBIT; n++)
+	{
+		*v |= (lua_Unsigned) (b[ n ] & 0x7F) << (n*7);
+		if (0 == (b[ n ] & 0x80))
+			return n+1;
+	}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Number of bytes needed to encode a value as LEB128 varint.
+ * \param   v     the value.
+ * \return  size_t number of bytes.
+ * -------------------------------------------------------------------------- */
+static size_t
+t_pck_lenvarint( lua_Unsigned v )
+{
+	size_t n = 1;
+
+	while (v >>= 7)
+		n++;
+	return n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Encode a value as LEB128 varint.
+ * \param   b     pointer to write to; must hold t_pck_lenvarint( v ) bytes.
+ * \param   v     the value.
+ * \return  size_t number of bytes written.
+ * -------------------------------------------------------------------------- */
+static size_t
+t_pck_putvarint( unsigned char *b, lua_Unsigned v )
+{
+	size_t n = 0;
+
+	while (v > 0x7F)
+	{
+		b[ n++ ] = (unsigned char) ((v & 0x7F) | 0x80);
+		v >>= 7;
+	}
+	b[ n++ ] = (unsigned char) v;
+	return n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Decode the header of a variable sized packer.
+ * \detail  Varints decode their value.  Length prefixed strings decode their
+ *          length; the string itself are the last v bytes.
+ * \param   L     lua Virtual Machine.
+ * \param   struct t_pck  VarInt, VarUInt or String packer.
+ * \param   b     pointer to the first byte.
+ * \param   l     number of bytes available.
+ * \param   v     pointer to lua_Unsigned gets the value assigned.
+ * \return  size_t number of bytes the value occupies.
+ * -------------------------------------------------------------------------- */
+static size_t
+t_pck_getvar( lua_State *L, struct t_pck *p, const unsigned char *b, size_t l,
+              lua_Unsigned *v )
+{
+	struct t_pck  u;     ///< fixed size length prefix
+	size_t        n;
+
+	if (T_PCK_LPR == p->t && p->s > 0)
+	{
+		if (p->s > l)
+			luaL_error( L, "packed %s is truncated", t_pck_t_lst[ p->t ] );
+		u.t = T_PCK_UNT;
+		u.s = p->s;
+		u.m = p->m;
+		t_pck_read( L, &u, b );
+		*v  = (lua_Unsigned) lua_tointeger( L, -1 );
+		lua_pop( L, 1 );
+		n   = p->s;
+	}
+	else if (0 == (n = t_pck_getvarint( b, l, v )))
+		luaL_error( L, "packed %s is truncated or malformed", t_pck_t_lst[ p->t ] );
+	if (T_PCK_LPR == p->t)
+	{
+		if (*v > l - n)
+			luaL_error( L, "packed %s is truncated", t_pck_t_lst[ p->t ] );
+		n += *v;
+	}
+	return n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read a variable sized value and push it onto the Lua stack.
+ * \param   L     lua Virtual Machine.
+ * \param   struct t_pck  VarInt, VarUInt or String packer.
+ * \param   b     pointer to the first byte.
+ * \param   l     number of bytes available.
+ * \lreturn value from the buffer.
+ * \return  size_t number of bytes read.
+ * -------------------------------------------------------------------------- */
+static size_t
+t_pck_readvar( lua_State *L, struct t_pck *p, const unsigned char *b, size_t l )
+{
+	lua_Unsigned v;
+	size_t       n = t_pck_getvar( L, p, b, l, &v );
+
+	switch (p->t)
+	{
+		case T_PCK_VRU:
+			lua_pushinteger( L, (lua_Integer) v );
+			break;
+		case T_PCK_VRS:
+			lua_pushinteger( L, (lua_Integer) ((v >> 1) ^ (0 - (v & 1))) );
+			break;
+		default:
+			lua_pushlstring( L, (const char *) b + n - v, v );
+	}
+	return n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Write the value on top of the stack as variable sized value.
+ * \param   L     lua Virtual Machine.
+ * \param   struct t_pck  VarInt, VarUInt or String packer.
+ * \param   b     pointer to write to; NULL only measures the size.
+ * \param   l     number of bytes available.
+ * \lparam  value Lua value to write.
+ * \return  size_t number of bytes the value occupies.
+ * -------------------------------------------------------------------------- */
+static size_t
+t_pck_putvar( lua_State *L, struct t_pck *p, unsigned char *b, size_t l )
+{
+	struct t_pck  u;     ///< fixed size length prefix
+	lua_Unsigned  v;
+	const char   *str = NULL;
+	size_t        sl  = 0;
+	size_t        n;
+
+	if (T_PCK_LPR == p->t)
+	{
+		str = luaL_checklstring( L, -1, &sl );
+		v   = (lua_Unsigned) sl;
+	}
+	else
+	{
+		v   = (lua_Unsigned) luaL_checkinteger( L, -1 );
+		if (T_PCK_VRS == p->t)      // zigzag: small magnitudes get small codes
+			v = (v << 1) ^ (0 - (v >> (MXBIT - 1)));
+	}
+	n = (T_PCK_LPR == p->t && p->s > 0) ? p->s : t_pck_lenvarint( v );
+	if (NULL == b)
+		return n + sl;
+	if (n + sl > l)
+		luaL_error( L, "%s to pack is too big for the Buffer", t_pck_t_lst[ p->t ] );
+	if (T_PCK_LPR == p->t && p->s > 0)
+	{
+		u.t = T_PCK_UNT;
+		u.s = p->s;
+		u.m = p->m;
+		lua_pushinteger( L, (lua_Integer) v );
+		t_pck_write( L, &u, b );
+		lua_pop( L, 1 );
+	}
+	else
+		t_pck_putvarint( b, v );
+	if (sl > 0)
+		memcpy( b + n, str, sl );
+	return n + sl;
+}
+
+
 // #########################################################################
 //  _                      _          _
 // | |_ _   _ _ __   ___  | |__   ___| |_ __   ___ _ __ ___
@@ -376,6 +714,13 @@ t_pck_format( lua_State *L, enum t_pck_t t, size_t s, int m )
 		case T_PCK_RAW:
 			lua_pushfstring( L, "%d", s );
 			break;
+		case T_PCK_VRU:
+		case T_PCK_VRS:
+			lua_pushliteral( L, "" );
+			break;
+		case T_PCK_LPR:
+			lua_pushfstring( L, "%d%c", s, (1==m) ? 'L' : 'B' );
+			break;
 		case T_PCK_ARR:
 		case T_PCK_SEQ:
 		case T_PCK_STR:
@@ -415,6 +760,7 @@ struct t_pck
 		p->t = t;
 		p->s = s;
 		p->m = m;
+		p->b = t_pck_getsize( L, p, 1 );
 
 		luaL_getmetatable( L, "T.Pack" );
 		lua_setmetatable( L, -2 );
@@ -453,14 +799,12 @@ struct t_pck
  * \param   L    The lua state.
  * \param   struct t_pck.
  * \param   int    bits - boolean if bit resolution is needed.
- * \return  size in bytes.
- * TODO: return 0 no matter if even one item is of unknown length.
+ * \return  size in bytes; 0 if it depends on the packed data.
  * --------------------------------------------------------------------------*/
-static size_t
+size_t
 t_pck_getsize( lua_State *L,  struct t_pck *p, int bits )
 {
-	size_t        s = 0;
-	size_t        n;       ///< iterator over accumulated
+	(void) L;
 	switch (p->t)
 	{
 		case T_PCK_INT:
@@ -480,28 +824,20 @@ t_pck_getsize( lua_State *L,  struct t_pck *p, int bits )
 					? p->s
 					: ((p->s + p->m - 1)/NB) + 1);
 			break;
-		case T_PCK_ARR:
-			lua_rawgeti( L, LUA_REGISTRYINDEX, p->m ); // get packer
-			s = p->s * t_pck_getsize( L, t_pck_check_ud( L, -1, 1 ), 1 );
-			lua_pop( L, 1 );
-			return ((bits)
-					? s
-					: s/NB);
+		case T_PCK_VRU:
+		case T_PCK_VRS:
+		case T_PCK_LPR:
+			// depends on the packed data
+			return 0;
 			break;
+		case T_PCK_ARR:
 		case T_PCK_SEQ:
 		case T_PCK_STR:
-			lua_rawgeti( L, LUA_REGISTRYINDEX, p->m ); // get table
-			for (n = 1; n <= p->s; n++)
-			{
-				//t_stackDump(L);
-				lua_rawgeti( L, -1, n );
-				s += t_pck_getsize( L, t_pck_check_ud( L, -1, 1 ), 1 );
-				lua_pop( L, 1 );
-			}
-			lua_pop( L, 1 );
+			// calculated by the constructor; bytes touched by trailing bits count
+			// 0 if any element is variable sized
 			return ((bits)
-					? s
-					: s/NB);
+					? p->b
+					: (p->b + NB - 1)/NB);
 			break;
 		default:
 			return 0;
@@ -608,6 +944,12 @@ struct t_pck
 
 			// String type
 			case 'c': t = T_PCK_RAW;   m = 0;         s = gnl( L, f, 1, 0x1 << NB );         break;
+			case 's': t = T_PCK_LPR;   m = (1==*e);   s = gnl( L, f, sizeof( size_t ), MXINT ); break;
+			case 'S': t = T_PCK_LPR;   m = 0;         s = 0;                                 break;
+
+			// Variable length integer types
+			case 'Q': t = T_PCK_VRU;   m = 0;         s = 0;                                 break;
+			case 'q': t = T_PCK_VRS;   m = 0;         s = 0;                                 break;
 
 			// Bit types
 			case 'v':
@@ -635,9 +977,11 @@ struct t_pck
 				return NULL;
 		}
 		// TODO: check if 0==offset%8 if byte type, else error
+		if ((T_PCK_VRU==t || T_PCK_VRS==t || T_PCK_LPR==t) && 0 != *bo % NB)
+			luaL_error( L, "variable sized format option '%c' must be byte aligned", opt );
 		p    = t_pck_create_ud( L, t, s, m );
 		// forward the Bit offset
-		*bo += ((T_PCK_BTU==t || T_PCK_BTS==t || T_PCK_BOL == t) ? s : s*NB);
+		*bo += t_pck_getsize( L, p, 1 );
 	}
 	return p;
 }
@@ -675,6 +1019,34 @@ static inline struct t_pck
 }
 
 
+/**--------------------------------------------------------------------------
+ * Get the bytes a packer reads from a T.Buffer or string.
+ * \param  L     lua Virtual Machine.
+ * \param  int   position of T.Buffer or string on Lua stack.
+ * \param  size_t offset of the packer.
+ * \param  size_t size of the packer in bytes.
+ * \return pointer to the first byte.
+ * --------------------------------------------------------------------------*/
+static const unsigned char
+*t_pck_srcptr( lua_State *L, int pos, size_t o, size_t sz )
+{
+	struct t_buf        *buf = t_buf_check_ud( L, pos, 0 );
+	const unsigned char *b;
+	size_t               l;
+
+	if (NULL != buf)
+		b = t_buf_ptr( buf, o, sz );
+	else
+	{
+		b = (const unsigned char *) luaL_checklstring( L, pos, &l );
+		b = (l >= o + sz) ? b + o : NULL;
+	}
+	luaL_argcheck( L,  NULL != b, pos,
+		"The length of the Buffer must be longer than Pack offset plus Pack length." );
+	return b;
+}
+
+
 /**--------------------------------------------------------------------------
  * Decides if the element on pos is a packer kind of type.
  * It decides between the following options:
@@ -682,6 +1054,9 @@ static inline struct t_pck
  *     - T.Pack.Reader            : return reference packer
  *     - fmt string of single item: fetch from cache or create
  *     - fmt string of mult items : let Sequence constructor handle and return result
+ * Packers compiled from a fmt string are kept in a weak valued cache keyed by
+ * the fmt string, the default endianness and the bit offset, so parsing code
+ * which passes the same literal over and over reuses the same packer.
  * \param   L  The lua state.
  * \param   pos    position on stack.
  * \param   atom   boolean atomic packers only.
@@ -694,6 +1069,7 @@ struct t_pck
 	int           l = _default_endian;
 	int           n = 0;  ///< counter for packers created from fmt string
 	int           t = lua_gettop( L );  ///< top of stack before operations
+	size_t        o = *bo;              ///< bit offset before the fmt string
 	const char   *fmt;
 
 	// get absolute stack position
@@ -709,11 +1085,26 @@ struct t_pck
 			p = t_pck_create_ud( L, p->t, p->s, *bo%NB );
 			lua_replace( L, pos );
 		}
+		luaL_argcheck( L, ! T_PCK_ISVAR( p ) || 0 == *bo % NB, pos,
+			"variable sized packers must be byte aligned" );
 		*bo += t_pck_getsize( L, p, 1 );
 	}
 	else // if it is a format string
 	{
 		fmt = luaL_checkstring( L, pos );
+		lua_rawgetp( L, LUA_REGISTRYINDEX, &_fmt_cache );
+		lua_pushfstring( L, "%d%c%s", (int) (o % NB), (l) ? '<' : '>', fmt );
+		lua_pushvalue( L, -1 );
+		if (LUA_TNIL != lua_rawget( L, -3 ))       // Stack: ...,cache,key,Pack
+		{
+			p    = t_pck_check_ud( L, -1, 1 );
+			*bo += t_pck_getsize( L, p, 1 );
+			lua_replace( L, pos );
+			lua_pop( L, 2 );
+			return p;
+		}
+		lua_pop( L, 1 );
+		t   = lua_gettop( L );                       // Stack: ...,cache,key
 		p   = t_pck_getoption( L, &fmt, &l, bo );
 		while (NULL != p )
 		{
@@ -723,11 +1114,16 @@ struct t_pck
 		// TODO: actually create the packers and calculate positions
 		if (1 < n)
 		{
+			*bo = o;      // the Sequence forwards the offset by itself
 			p =  t_pck_mksequence( L, t+1, lua_gettop( L ), bo );
 		}
 		else
 			p = t_pck_check_ud( L, -1, 1 );
+		lua_pushvalue( L, -2 );                      // Stack: ...,cache,key,Pack,key
+		lua_pushvalue( L, -2 );
+		lua_rawset( L, -5 );
 		lua_replace( L, pos );
+		lua_pop( L, 2 );
 	}
 	return p;
 }
@@ -744,12 +1140,15 @@ static struct t_pck
 *t_pck_mkarray( lua_State *L )
 {
 	size_t            bo = 0;
-	struct t_pck  __attribute__ ((unused))   *p  = t_pck_getpck( L, -2, &bo );  ///< packer
+	struct t_pck     *p  = t_pck_getpck( L, -2, &bo );  ///< packer
 	struct t_pck     *ap;     ///< array userdata to be created
 
 	ap    = (struct t_pck *) lua_newuserdata( L, sizeof( struct t_pck ) );
 	ap->t = T_PCK_ARR;
 	ap->s = luaL_checkinteger( L, -2 );      // how many elements in the array
+	ap->b = ap->s * t_pck_getsize( L, p, 1 );
+	ap->o[ 0 ].p = p;
+	ap->o[ 0 ].o = 0;
 
 	lua_pushvalue( L, -3 );  // Stack: Pack,n,Array,Pack
 	ap->m = luaL_ref( L, LUA_REGISTRYINDEX ); // register packer table
@@ -773,10 +1172,12 @@ static struct t_pck
 {
 	size_t        n=1;    ///< iterator for going through the arguments
 	size_t        o=0;    ///< byte offset within the sequence
+	int           v=0;    ///< passed a variable sized element
 	struct t_pck *p;      ///< temporary packer/struct for iteration
 	struct t_pck *sq;     ///< the userdata this constructor creates
 
-	sq     = (struct t_pck *) lua_newuserdata( L, sizeof( struct t_pck ) );
+	sq     = (struct t_pck *) lua_newuserdata( L, sizeof( struct t_pck ) +
+	            (ep-sp) * sizeof( struct t_pck_op ) );
 	sq->t  = T_PCK_SEQ;
 	sq->s  = (ep-sp)+1;
 
@@ -785,14 +1186,20 @@ static struct t_pck
 	while (n <= sq->s)
 	{
 		p = t_pck_getpck( L, sp, bo );
+		sq->o[ n-1 ].p = p;
+		sq->o[ n-1 ].o = (v) ? T_PCK_NOOFS : o/8;
 		lua_pushvalue( L, sp );          // Stack: fmt,Seq,idx,Pack
-		lua_pushinteger( L, o/8 );       // Stack: fmt,Seq,idx,Pack,ofs
+		lua_pushinteger( L, (lua_Integer) sq->o[ n-1 ].o ); // Stack: fmt,Seq,idx,Pack,ofs
 		lua_rawseti( L, -3, n + sq->s ); // Stack: fmt,Seq,idx,Pack     idx[n+i] = offset
 		lua_rawseti( L, -2, n );         // Stack: fmt,Seq,idx,         idx[i]   = Pack
+		v  = v || T_PCK_ISVAR( p );
 		o += t_pck_getsize( L, p, 1 );
 		n++;
 		lua_remove( L, sp );
 	}
+	if (v && 0 != o % NB)
+		luaL_error( L, "variable sized T.Pack.Sequence must cover whole bytes" );
+	sq->b = (v) ? 0 : o;
 	sq->m = luaL_ref( L, LUA_REGISTRYINDEX ); // register index  table
 
 	luaL_getmetatable( L, "T.Pack" ); // Stack: ...,T.Pack.Struct
@@ -816,10 +1223,12 @@ static struct t_pck
 	size_t        n  = 1;  ///< iterator for going through the arguments
 	size_t        o  = 0;  ///< byte offset within the sequence
 	size_t        bo = 0;  ///< bit  offset within the sequence
+	int           v  = 0;  ///< passed a variable sized element
 	struct t_pck *p;       ///< temporary packer/struct for iteration
 	struct t_pck *st;      ///< the userdata this constructor creates
 
-	st     = (struct t_pck *) lua_newuserdata( L, sizeof( struct t_pck ) );
+	st     = (struct t_pck *) lua_newuserdata( L, sizeof( struct t_pck ) +
+	            (ep-sp) * sizeof( struct t_pck_op ) );
 	st->t  = T_PCK_STR;
 	st->s  = (ep-sp) + 1;
 
@@ -840,18 +1249,24 @@ static struct t_pck
 			luaL_error( L, "All elements in T.Pack.Struct must have unique key." );
 		lua_pop( L, 1 );                 // S:...,Struct,idx,name,Pack
 		p = t_pck_getpck( L, -1, &bo );  // allow T.Pack or T.Pack.Struct
+		st->o[ n-1 ].p = p;
+		st->o[ n-1 ].o = (v) ? T_PCK_NOOFS : o/8;
 		// populate idx table
-		lua_pushinteger( L, o/8 );       // S:...,Struct,idx,name,Pack,ofs
+		lua_pushinteger( L, (lua_Integer) st->o[ n-1 ].o ); // S:...,Struct,idx,name,Pack,ofs
 		lua_rawseti( L, -4, n + st->s ); // S:...,Struct,idx,name,Pack        idx[n+i] = offset
 		lua_rawseti( L, -3, n );         // S:...,Struct,idx,name             idx[i] = Pack
 		lua_pushvalue( L, -1 );          // S:...,Struct,idx,name,name
 		lua_rawseti( L, -3, st->s*2+n ); // S:...,Struct,idx,name             idx[2n+i] = name
 		lua_pushinteger( L, n);          // S:...,Struct,idx,name,i
 		lua_rawset( L, -3 );             // S:...,Struct,idx                  idx[name] = i
+		v  = v || T_PCK_ISVAR( p );
 		o += t_pck_getsize( L, p, 1 );
 		n++;
 		lua_remove( L, sp );
 	}
+	if (v && 0 != o % NB)
+		luaL_error( L, "variable sized T.Pack.Struct must cover whole bytes" );
+	st->b = (v) ? 0 : o;
 
 	st->m = luaL_ref( L, LUA_REGISTRYINDEX ); // register index  table
 
@@ -951,6 +1366,205 @@ lt_pck_size( lua_State *L )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Pack a value into a new string.
+ * \detail  The string has the size of the packer or, for variable sized
+ *          packers, of the packed value; bytes not covered by the value are
+ *          zero.
+ * \param   L  The lua state.
+ * \lparam  ud     T.Pack.* instance or format string.
+ * \lparam  value  value to pack; a table for Combinators.
+ * \lreturn string packed value.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pck_pack( lua_State *L )
+{
+	size_t        bo = 0;
+	struct t_pck *pc = t_pck_getpck( L, 1, &bo );
+	size_t        sz;
+	luaL_Buffer   lB;
+	char         *b;
+
+	luaL_checkany( L, 2 );
+	lua_settop( L, 2 );
+	sz = (T_PCK_ISVAR( pc ))
+		? t_pck_writel( L, pc, NULL, 0 ) / NB
+		: t_pck_getsize( L, pc, 0 );
+	b = luaL_buffinitsize( L, &lB, sz );
+	memset( b, 0, sz );
+	lua_pushvalue( L, 2 );
+	t_pck_writel( L, pc, (unsigned char *) b, sz );
+	lua_pop( L, 1 );
+	luaL_pushresultsize( &lB, sz );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read an Array of numbers into an existing target.
+ * \detail  Fills a table without creating a new one, or copies the elements
+ *          into a T.Buffer in native byte order without creating Lua values.
+ * \param   L  The lua state.
+ * \lparam  ud     T.Pack.Array or T.Pack.Reader of an Array of numbers.
+ * \lparam  ud     T.Buffer or string to read from.
+ * \lparam  mixed  table, T.Buffer or T.Numarray to read into.
+ * \lreturn mixed  the target.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pck_readinto( lua_State *L )
+{
+	struct t_pck        *pc;
+	const unsigned char *b;
+	size_t               l;
+
+	lua_pushvalue( L, 1 );
+	pc = t_pck_getpckreader( L, -1, NULL );
+	lua_pop( L, 1 );
+	luaL_argcheck( L, T_PCK_ARR == pc->t && t_pck_isbulk( pc->o[ 0 ].p ), 1,
+		"T.Pack.Array of byte sized numbers expected" );
+	b = t_pck_locate( L, 1, 2, &pc, &l );
+	luaL_checkany( L, 3 );
+	return t_pck_readbulk( L, pc->o[ 0 ].p, b, pc->o[ 0 ].p->s, pc->s, 3 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the memory an integer packer addresses in a T.Buffer for atomic access.
+ * \detail  Atomic operations work on native integers only; the packer must be
+ *          an Int or UInt of 1, 2, 4 or 8 bytes in native endianness and the
+ *          address must be aligned to its size.
+ * \param   L    The lua state.
+ * \param   int  stack position of the T.Pack or T.Pack.Reader.
+ * \param   int  stack position of the T.Buffer.
+ * \param   struct t_pck**  gets the packer assigned.
+ * \return  void*  the address of the integer.
+ * --------------------------------------------------------------------------*/
+static void
+*t_pck_atomicptr( lua_State *L, int pP, int pB, struct t_pck **pcp )
+{
+	struct t_pck  *pc;
+	unsigned char *b;
+	size_t         l;
+
+	t_buf_check_ud( L, pB, 1 );
+	lua_pushvalue( L, pP );
+	pc = t_pck_getpckreader( L, -1, NULL );
+	lua_pop( L, 1 );
+	luaL_argcheck( L, (T_PCK_INT == pc->t || T_PCK_UNT == pc->t) &&
+	                  (1 == pc->s || 2 == pc->s || 4 == pc->s || 8 == pc->s), pP,
+	                  "atomic operations need an Int or UInt of 1, 2, 4 or 8 bytes" );
+	luaL_argcheck( L, 1 == pc->s || IS_LITTLE_ENDIAN == pc->m, pP,
+	                  "atomic operations need native endianness" );
+	b = t_pck_locate( L, pP, pB, &pc, &l );
+	luaL_argcheck( L, 0 == (uintptr_t) b % pc->s, pB, "integer is not aligned to its size" );
+	*pcp = pc;
+	return b;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push a raw integer of a packers size as Lua integer.
+ * \param   L    The lua state.
+ * \param   struct t_pck*  the packer.
+ * \param   uint64_t       the raw value.
+ * --------------------------------------------------------------------------*/
+static void
+t_pck_pushatomic( lua_State *L, struct t_pck *pc, uint64_t v )
+{
+	uint64_t msk;
+
+	if (T_PCK_INT == pc->t && pc->s < 8)
+	{
+		msk = (uint64_t) 1 << (pc->s*NB - 1);
+		v   = ((v & ((msk << 1) - 1)) ^ msk) - msk;
+	}
+	lua_pushinteger( L, (lua_Integer) v );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Atomically add to an integer in a T.Buffer.
+ * \detail  Safe against concurrent updates by other threads or processes
+ *          sharing the memory.  The value wraps around at the packers size.
+ * \param   L  The lua state.
+ * \lparam  ud     T.Pack or T.Pack.Reader of an integer.
+ * \lparam  ud     T.Buffer.
+ * \lparam  int    value to add (opt, default 1).
+ * \lreturn int    value before the addition.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pck_fetchadd( lua_State *L )
+{
+	struct t_pck *pc;
+	void         *a = t_pck_atomicptr( L, 1, 2, &pc );
+	uint64_t      d = (uint64_t) luaL_optinteger( L, 3, 1 );
+	uint64_t      v;
+
+	switch (pc->s)
+	{
+		case 1:  v = __atomic_fetch_add( (uint8_t  *) a, (uint8_t)  d, __ATOMIC_SEQ_CST ); break;
+		case 2:  v = __atomic_fetch_add( (uint16_t *) a, (uint16_t) d, __ATOMIC_SEQ_CST ); break;
+		case 4:  v = __atomic_fetch_add( (uint32_t *) a, (uint32_t) d, __ATOMIC_SEQ_CST ); break;
+		default: v = __atomic_fetch_add( (uint64_t *) a,            d, __ATOMIC_SEQ_CST );
+	}
+	t_pck_pushatomic( L, pc, v );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Atomically replace an integer in a T.Buffer if it has an expected value.
+ * \param   L  The lua state.
+ * \lparam  ud     T.Pack or T.Pack.Reader of an integer.
+ * \lparam  ud     T.Buffer.
+ * \lparam  int    expected value.
+ * \lparam  int    new value.
+ * \lreturn bool   true if the value was replaced.
+ * \lreturn int    value before the operation.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pck_cas( lua_State *L )
+{
+	struct t_pck *pc;
+	void         *a = t_pck_atomicptr( L, 1, 2, &pc );
+	uint64_t      e = (uint64_t) luaL_checkinteger( L, 3 );
+	uint64_t      n = (uint64_t) luaL_checkinteger( L, 4 );
+	int           ok;
+	uint8_t       e1 = (uint8_t)  e;
+	uint16_t      e2 = (uint16_t) e;
+	uint32_t      e4 = (uint32_t) e;
+
+	switch (pc->s)
+	{
+		case 1:
+			ok = __atomic_compare_exchange_n( (uint8_t *) a, &e1, (uint8_t) n, 0,
+			                                  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+			e  = e1;
+			break;
+		case 2:
+			ok = __atomic_compare_exchange_n( (uint16_t *) a, &e2, (uint16_t) n, 0,
+			                                  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+			e  = e2;
+			break;
+		case 4:
+			ok = __atomic_compare_exchange_n( (uint32_t *) a, &e4, (uint32_t) n, 0,
+			                                  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+			e  = e4;
+			break;
+		default:
+			ok = __atomic_compare_exchange_n( (uint64_t *) a, &e, n, 0,
+			                                  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+	}
+	lua_pushboolean( L, ok );
+	t_pck_pushatomic( L, pc, (ok) ? (uint64_t) luaL_checkinteger( L, 3 ) : e );
+	return 2;
+}
+
+
 /**--------------------------------------------------------------------------
  * Set the default endian style of the T.Pack Constructor for fmt.
  * \param   L  The lua state.
@@ -987,7 +1601,7 @@ static int
 lt_pck_getir( lua_State *L )
 {
 	struct t_pck *p = t_pck_getpckreader( L, 1, NULL );
-	if (p->t > T_PCK_RAW && LUA_NOREF != p->m)
+	if (p->t >= T_PCK_ARR && LUA_NOREF != p->m)
 		lua_rawgeti( L, LUA_REGISTRYINDEX, p->m );
 	else
 		lua_pushnil( L );
@@ -1003,72 +1617,166 @@ lt_pck_getir( lua_State *L )
 // |_|  |_|\___|\__\__,_| |_| |_| |_|\___|\__|_| |_|\___/ \__,_|___/
 //###########################################################################
 /**--------------------------------------------------------------------------
- * Read a Struct packer value.
- *          This can not simply return a packer/Struct type since it now has
- *          meta information about the position it is requested from.  For this
- *          the is a new datatype T.Pack.Result which carries type and position
- *          information
+ * Check if a key is the name of a member of a T.Pack.Struct.
  * \param   L    The lua state.
- * \lparam  userdata T.Pack.Struct instance.
- * \lparam  key      string/integer.
- * \lreturn userdata Pack or Struct instance.
- * \return  int    # of values pushed onto the stack.
+ * \param   struct t_pck*  the packer.
+ * \param   int  stack position of the key.
+ * \return  int  boolean 1 if key is a member name.
  * --------------------------------------------------------------------------*/
 static int
-lt_pck__index( lua_State *L )
+t_pck_hasfield( lua_State *L, struct t_pck *pc, int pK )
 {
-	struct t_pcr *pr  = NULL;
-	struct t_pck *pc  = t_pck_getpckreader( L, -2, &pr );
-	struct t_pck *p;
-	struct t_pcr *r;
+	int has;
 
-	luaL_argcheck( L, pc->t > T_PCK_RAW, -2, "Trying to index Atomic T.Pack type" );
+	if (T_PCK_STR != pc->t)
+		return 0;
+	pK = (pK < 0) ? lua_gettop( L ) + pK + 1 : pK;
+	lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );
+	lua_pushvalue( L, pK );
+	has = (LUA_TNIL != lua_rawget( L, -2 ));
+	lua_pop( L, 2 );
+	return has;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push the T.Pack class function named by a key.
+ * \detail  This makes the class functions which take a packer as first
+ *          argument available as methods, e.g. p:pack( t ) or p:size().
+ *          Member names of a Struct take precedence.
+ * \param   L    The lua state.
+ * \param   int  stack position of the key.
+ * \lreturn function or nil.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_pck_pushmethod( lua_State *L, int pK )
+{
+	pK = (pK < 0) ? lua_gettop( L ) + pK + 1 : pK;
+	luaL_getsubtable( L, LUA_REGISTRYINDEX, "_LOADED" );
+	lua_getfield( L, -1, "t" );
+	lua_getfield( L, -1, "Pack" );
+	lua_pushvalue( L, pK );
+	if (LUA_TFUNCTION != lua_rawget( L, -2 ))
+	{
+		lua_pop( L, 1 );
+		lua_pushnil( L );
+	}
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read a Struct packer value.
+ *          This can not simply return a packer/Struct type since it now has
+ *          meta information about the position it is requested from.  For this
+ *          the is a new datatype T.Pack.Result which carries type and position
+ *          information.  Readers get cached per indexed object and key, so
+ *          repeated and chained lookups such as s.a.b don't allocate.
+ * \param   L    The lua state.
+ * \lparam  userdata T.Pack.Struct instance.
+ * \lparam  key      string/integer.
+ * \lreturn userdata Pack or Struct instance.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pck__index( lua_State *L )
+{
+	struct t_pcr *pr  = NULL;
+	struct t_pck *pc;
+	struct t_pck *p;
+	struct t_pcr *r;
+	lua_Integer   i;
+
+	lua_settop( L, 2 );
+	// Readers created before are cached in the uservalue of the indexed object;
+	// weak valued so indexing many elements doesn't pin a Reader for each
+	if (LUA_TTABLE != lua_getuservalue( L, 1 ))
+	{
+		lua_pop( L, 1 );
+		lua_newtable( L );
+		lua_pushvalue( L, -1 );
+		lua_setuservalue( L, 1 );
+	}
+	if (LUA_TTABLE == lua_rawgetp( L, 3, &_reader_cache ))
+	{
+		lua_pushvalue( L, 2 );
+		if (LUA_TNIL != lua_rawget( L, 4 ))
+			return 1;
+		lua_pop( L, 1 );
+	}
+	else
+	{
+		lua_pop( L, 1 );
+		lua_newtable( L );
+		lua_rawgetp( L, LUA_REGISTRYINDEX, &_reader_cache );
+		lua_setmetatable( L, -2 );
+		lua_pushvalue( L, -1 );
+		lua_rawsetp( L, 3, &_reader_cache );
+	}
+	lua_remove( L, 3 );                                // Stack: ud,key,cache
+	lua_pushvalue( L, 1 );
+	pc = t_pck_getpckreader( L, 4, &pr );              // Stack: ud,key,cache,Pack
 
-	if (LUA_TNUMBER == lua_type( L, -1 ) &&
-	      ((luaL_checkinteger( L, -1 ) > (int) pc->s) || (luaL_checkinteger( L, -1 ) < 1))
-	   )
+	if (LUA_TSTRING == lua_type( L, 2 ) && ! t_pck_hasfield( L, pc, 2 ))
+		return t_pck_pushmethod( L, 2 );
+	luaL_argcheck( L, pc->t >= T_PCK_ARR, 1, "Trying to index Atomic T.Pack type" );
+
+	if (T_PCK_STR == pc->t && LUA_TSTRING == lua_type( L, 2 ))
+	{
+		lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );
+		lua_pushvalue( L, 2 );
+		lua_rawget( L, -2 );
+		i = lua_tointeger( L, -1 );
+		lua_pop( L, 2 );
+	}
+	else
+		i = luaL_checkinteger( L, 2 );
+	if (i > (lua_Integer) pc->s || i < 1)
 	{
 		// Array/Sequence out of bound: return nil
 		lua_pushnil( L );
 		return 1;
 	}
+
 	// push empty reader on stack
 	r = (struct t_pcr *) lua_newuserdata( L, sizeof( struct t_pcr ));
 	r->o = (NULL == pr )? 0 : pr->o;  // recorded offset is 1 based -> don't add up
-	// get idx table (struct) or packer type (array)
-	lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );
-	//t_stackDump( L );
-	// Stack: Struct,idx/name,Reader,idx/Packer
-	if (LUA_TUSERDATA == lua_type( L, -1 ))        // T.Array
+	r->i = 0;
+	// offsets behind variable sized data get resolved from the parent on access
+	if ((NULL != pr && 0 != pr->i) ||
+	    ((T_PCK_ARR == pc->t) ? T_PCK_ISVAR( pc ) && i > 1 : T_PCK_NOOFS == pc->o[ i-1 ].o))
 	{
-		p     = t_pck_check_ud( L, -1, 1 );
+		r->o = 0;
+		r->i = (size_t) i;
+		lua_newtable( L );
+		lua_pushvalue( L, 1 );
+		lua_rawsetp( L, -2, &_reader_parent );
+		lua_setuservalue( L, -2 );
+	}
+	if (T_PCK_ARR == pc->t)
+	{
+		p = pc->o[ 0 ].p;
+		r->o += (0 == r->i) ? (t_pck_getsize( L, p, 1 ) * (i-1)) / NB : 0;
 		if (T_PCK_BOL == p->t  || T_PCK_BTS == p->t  || T_PCK_BTU == p->t)
-		{
-			lua_pop( L, 1 );
-			p = t_pck_create_ud( L, p->t, p->s,
-				((p->s * (luaL_checkinteger( L, -2 )-1)) % NB ) );
-		}
-		r->o += (((t_pck_getsize( L, p, 1 )) * (luaL_checkinteger( L, -3 )-1)) / NB);
+			t_pck_create_ud( L, p->t, p->s, (p->s * (i-1)) % NB );
+		else
+			lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );
 	}
-	else                                               // T.Struct/Sequence
+	else
 	{
-		if (! lua_tonumber( L, -3 ))               // T.Struct
-		{
-			lua_pushvalue( L, -3 );        // Stack: Struct,key,Reader,idx,key
-			lua_rawget( L, -2 );           // Stack: Struct,key,Reader,idx,i
-			lua_replace( L, -4 );          // Stack: Struct,i,Reader,idx
-		}
-		lua_rawgeti( L, -1, lua_tointeger( L, -3 ) + pc->s );  // Stack: Seq,i,Reader,idx,ofs
-		r->o += luaL_checkinteger( L, -1);
-		lua_pop( L, 1 );                                   // Stack: Seq,i,Reader,idx
-		lua_rawgeti( L, -1, lua_tointeger( L, -3 ) );  // Stack: Seq,i,Reader,idx,Pack
+		r->o += (0 == r->i) ? pc->o[ i-1 ].o : 0;
+		lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );
+		lua_rawgeti( L, -1, i );
 		lua_remove( L, -2 );
-		p =  t_pck_check_ud( L, -1, 1 );  // Stack: Seq,i,Reader,Pack
-	}
+	}                                                  // Stack: ud,key,cache,Pack,Reader,Pack
 
-	r->r  = luaL_ref( L, LUA_REGISTRYINDEX );   // Stack: Seq,i,Reader
+	r->r  = luaL_ref( L, LUA_REGISTRYINDEX );         // Stack: ud,key,cache,Pack,Reader
 	luaL_getmetatable( L, "T.Pack.Reader" );
 	lua_setmetatable( L, -2 );
+	lua_pushvalue( L, 2 );
+	lua_pushvalue( L, -2 );
+	lua_rawset( L, 3 );
 	return 1;
 }
 
@@ -1086,7 +1794,7 @@ lt_pck__newindex( lua_State *L )
 {
 	struct t_pck *pc = t_pck_getpckreader( L, -3, NULL );
 
-	luaL_argcheck( L, pc->t > T_PCK_RAW, -3, "Trying to index Atomic T.Pack type" );
+	luaL_argcheck( L, pc->t >= T_PCK_ARR, -3, "Trying to index Atomic T.Pack type" );
 
 	return t_push_error( L, "Packers are static and can't be updated!" );
 }
@@ -1105,38 +1813,30 @@ lt_pck__newindex( lua_State *L )
 static int
 t_pck_iter( lua_State *L )
 {
-	struct t_pck *pc  = t_pck_check_ud( L, lua_upvalueindex( 1 ), 1);
-	struct t_pcr *r;
-
+	struct t_pck *pc;
 	// get current index and increment
-	int crs = lua_tointeger( L, lua_upvalueindex( 2 ) ) + 1;
-
-	luaL_argcheck( L, pc->t > T_PCK_RAW, lua_upvalueindex( 1 ),
-	   "Attempt to index atomic T.Pack type" );
+	lua_Integer   crs = lua_tointeger( L, lua_upvalueindex( 2 ) ) + 1;
 
-	if (crs > (int) pc->s)
+	lua_pushvalue( L, lua_upvalueindex( 1 ) );
+	pc = t_pck_getpckreader( L, -1, NULL );
+	lua_pop( L, 1 );
+	if (crs > (lua_Integer) pc->s)
 		return 0;
 	else
 	{
 		lua_pushinteger( L, crs );
 		lua_replace( L, lua_upvalueindex( 2 ) );
 	}
-	lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );// Stack: func,nP,_idx
-	if (T_PCK_STR == pc->t)                        // Get the name for a Struct value
-		lua_rawgeti( L, -1 , crs + pc->s*2 );   // Stack: func,nP,_idx,nC
+	if (T_PCK_STR == pc->t)                         // Get the name for a Struct value
+	{
+		lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );  // Stack: func,xP,_idx
+		lua_rawgeti( L, -1 , crs + pc->s*2 );        // Stack: func,xP,_idx,nC
+		lua_remove( L, -2 );
+	}
 	else
-		lua_pushinteger( L, crs );     // Stack: func,iP,_idx,iC
-	r = (struct t_pcr *) lua_newuserdata( L, sizeof( struct t_pcr ));
-	lua_rawgeti( L, -3 , crs+pc->s ); // Stack: func,xP,_idx,xC,Rd,ofs
-	lua_rawgeti( L, -4 , crs );       // Stack: func,xP,_idx,xC,Rd,ofs,pack
-	lua_remove( L, -5 );              // Stack: func,xP,xC,Rd,ofs,pack
-
-	r->r = luaL_ref( L, LUA_REGISTRYINDEX );   // Stack: func,xP,xC,Rd,ofs
-	r->o = lua_tointeger( L, lua_upvalueindex( 3 ) ) + luaL_checkinteger( L, -1 );
-	lua_pop( L, 1 );                  // remove ofs
-	luaL_getmetatable( L, "T.Pack.Reader" );
-	lua_setmetatable( L, -2 );
-
+		lua_pushinteger( L, crs );                   // Stack: func,xP,iC
+	lua_pushvalue( L, -1 );
+	lua_gettable( L, lua_upvalueindex( 1 ) );       // Stack: func,xP,xC,Rd
 	return 2;
 }
 
@@ -1151,13 +1851,18 @@ t_pck_iter( lua_State *L )
 static int
 lt_pck__pairs( lua_State *L )
 {
-	struct t_pcr *pr = NULL;
-	t_pck_getpckreader( L, -1, &pr );
+	struct t_pck *pc;
 
-	lua_pushnumber( L, 0 );
-	lua_pushinteger( L, (NULL == pr) ? 0 : pr->o );  // preserve offset for iteration
-	lua_pushcclosure( L, &t_pck_iter, 3 );
-	lua_pushvalue( L, -1 );
+	lua_settop( L, 1 );
+	lua_pushvalue( L, 1 );
+	pc = t_pck_getpckreader( L, 2, NULL );
+	luaL_argcheck( L, pc->t >= T_PCK_ARR, 1, "Attempt to index atomic T.Pack type" );
+	lua_pop( L, 1 );
+
+	lua_pushvalue( L, 1 );           // Readers come from __index of the object
+	lua_pushinteger( L, 0 );
+	lua_pushcclosure( L, &t_pck_iter, 2 );
+	lua_pushvalue( L, 1 );
 	lua_pushnil( L );
 	return 3;
 }
@@ -1178,6 +1883,8 @@ lt_pck__tostring( lua_State *L )
 
 	if (NULL == pr)
 		lua_pushfstring( L, "T.Pack." );
+	else if (0 != pr->i)
+		lua_pushfstring( L, "T.Pack.Reader[#%d](", pr->i );
 	else
 		lua_pushfstring( L, "T.Pack.Reader[%d](", pr->o );
 	t_pck_format( L, pc->t, pc->s, pc->m );
@@ -1201,7 +1908,7 @@ lt_pck__gc( lua_State *L )
 	struct t_pck *pc = t_pck_getpckreader( L, -1, &pr );
 	if (NULL != pr)
 		luaL_unref( L, LUA_REGISTRYINDEX, pr->r );
-	if (NULL == pr && pc->t > T_PCK_RAW)
+	if (NULL == pr && pc->t >= T_PCK_ARR)
 		luaL_unref( L, LUA_REGISTRYINDEX, pc->m );
 	return 0;
 }
@@ -1219,16 +1926,175 @@ lt_pck__len( lua_State *L )
 {
 	struct t_pck *pc = t_pck_getpckreader( L, -1, NULL );
 
-	luaL_argcheck( L, pc->t > T_PCK_RAW, 1, "Attempt to get length of atomic T.Pack type" );
+	luaL_argcheck( L, pc->t >= T_PCK_ARR, 1, "Attempt to get length of atomic T.Pack type" );
 
 	lua_pushinteger( L, pc->s );
 	return 1;
 }
 
 
+/**--------------------------------------------------------------------------
+ * Can the elements of a packer be read in bulk?
+ * \detail  That are byte aligned Int and UInt of 1, 2, 4 or 8 bytes and native
+ *          floats.
+ * \param   struct t_pck*  the element packer.
+ * \return  int  boolean.
+ * -------------------------------------------------------------------------*/
+static int
+t_pck_isbulk( struct t_pck *p )
+{
+	if (T_PCK_INT == p->t || T_PCK_UNT == p->t)
+		return (1 == p->s || 2 == p->s || 4 == p->s || 8 == p->s);
+	if (T_PCK_FLT == p->t)
+		return (sizeof( float ) == p->s || sizeof( double ) == p->s);
+	return 0;
+}
+
+
+// push k native values of ctype from nat into the table on top of the stack
+#define T_PCK_PUSHBULK( ctype, push, cast )                   \
+	for (j=0; j<k; j++)                                        \
+	{                                                          \
+		ctype v;                                                \
+		memcpy( &v, nat + j*sizeof( ctype ), sizeof( ctype ) ); \
+		push( L, (cast) v );                                    \
+		lua_rawseti( L, -2, (lua_Integer) (i+j+1) );           \
+	}
+
+
+// gather n values of ctype which are st bytes apart, swapping their bytes if needed
+#define T_PCK_GATHER( ctype, bswap )                          \
+	for (j=0; j<n; j++)                                        \
+	{                                                          \
+		ctype v;                                                \
+		memcpy( &v, src + j*st, sizeof( ctype ) );              \
+		v = (swp) ? bswap( v ) : v;                             \
+		memcpy( dst + j*sizeof( ctype ), &v, sizeof( ctype ) ); \
+	}
+
+#define T_PCK_NOSWAP( v )  (v)
+
+
+/**--------------------------------------------------------------------------
+ * Copy n values of sz bytes which are st bytes apart into a dense vector.
+ * \param   dst   destination for n*sz bytes.
+ * \param   src   first value.
+ * \param   sz    size of a value; 1, 2, 4 or 8.
+ * \param   st    distance between the values in the source.
+ * \param   n     number of values.
+ * \param   swp   reverse the bytes of each value.
+ * -------------------------------------------------------------------------*/
+static void
+t_pck_gather( unsigned char *dst, const unsigned char *src, size_t sz, size_t st,
+              size_t n, int swp )
+{
+	size_t j;
+
+	if (st == sz)
+	{
+		t_pck_swap( dst, src, sz, n, swp );
+		return;
+	}
+	switch (sz)
+	{
+		case 1:  T_PCK_GATHER( uint8_t,  T_PCK_NOSWAP );     break;
+		case 2:  T_PCK_GATHER( uint16_t, __builtin_bswap16 ); break;
+		case 4:  T_PCK_GATHER( uint32_t, __builtin_bswap32 ); break;
+		default: T_PCK_GATHER( uint64_t, __builtin_bswap64 );
+	}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read numbers in bulk.
+ * \detail  Elements get converted to native byte order in chunks and are
+ *          loaded as typed values from there.  The target can be a table, a
+ *          T.Buffer which receives the elements in native byte order without
+ *          creating any Lua values or, if compiled in, a T.Numarray.
+ *          Elements may be spread out, e.g. a field of consecutive records.
+ * \param   L         lua Virtual Machine.
+ * \param   stuct t_pck   packer of an element; must be t_pck_isbulk().
+ * \param   char *        buffer to read the first element from.
+ * \param   size_t        distance between elements in bytes.
+ * \param   size_t        number of elements.
+ * \param   int           stack position of the target; 0 for a new table.
+ * \lreturn target        filled with the elements.
+ * \return  int    # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+static int
+t_pck_readbulk( lua_State *L, struct t_pck *p, const unsigned char *b,
+                size_t st, size_t n, int pT )
+{
+	int            swp = (T_PCK_FLT != p->t && IS_LITTLE_ENDIAN != p->m);
+	struct t_buf  *buf = (0 == pT) ? NULL : t_buf_check_ud( L, pT, 0 );
+	unsigned char  nat[ T_PCK_BULK ];
+	unsigned char *d;
+	size_t         i, j, k;
+#ifdef T_NRY
+	struct t_nry  *a   = (0 == pT) ? NULL : t_nry_check_ud( L, pT, 0 );
+#endif
+
+	if (NULL != buf)
+	{
+		d = t_buf_ptr( buf, 0, n * p->s );
+		luaL_argcheck( L, NULL != d, pT, "T.Buffer is too short for the elements" );
+		t_pck_gather( d, b, p->s, st, n, swp );
+		lua_pushvalue( L, pT );
+		return 1;
+	}
+#ifdef T_NRY
+	if (NULL != a)
+	{
+		luaL_argcheck( L, T_PCK_FLT != p->t && p->s < sizeof( int ) + (T_PCK_INT == p->t), 1,
+			"T.Numarray needs integers which fit into an int" );
+		luaL_argcheck( L, a->len >= n, pT, "T.Numarray is too short for the elements" );
+		for (i=0; i < n; i++)
+		{
+			t_pck_read( L, p, b + i*st );
+			a->v[ i ] = (int) lua_tointeger( L, -1 );
+			lua_pop( L, 1 );
+		}
+		lua_pushvalue( L, pT );
+		return 1;
+	}
+#endif
+	if (0 == pT)
+		lua_createtable( L, n, 0 );
+	else
+	{
+		luaL_checktype( L, pT, LUA_TTABLE );
+		lua_pushvalue( L, pT );
+	}
+	for (i=0; i < n; i += k)
+	{
+		k = n - i;
+		k = (k > T_PCK_BULK / p->s) ? T_PCK_BULK / p->s : k;
+		t_pck_gather( nat, b + i*st, p->s, st, k, swp );
+		switch ((T_PCK_FLT == p->t) ? 0 : ((T_PCK_INT == p->t) ? 10 : 20) + p->s)
+		{
+			case 11: T_PCK_PUSHBULK( int8_t,   lua_pushinteger, lua_Integer ); break;
+			case 12: T_PCK_PUSHBULK( int16_t,  lua_pushinteger, lua_Integer ); break;
+			case 14: T_PCK_PUSHBULK( int32_t,  lua_pushinteger, lua_Integer ); break;
+			case 18: T_PCK_PUSHBULK( int64_t,  lua_pushinteger, lua_Integer ); break;
+			case 21: T_PCK_PUSHBULK( uint8_t,  lua_pushinteger, lua_Integer ); break;
+			case 22: T_PCK_PUSHBULK( uint16_t, lua_pushinteger, lua_Integer ); break;
+			case 24: T_PCK_PUSHBULK( uint32_t, lua_pushinteger, lua_Integer ); break;
+			case 28: T_PCK_PUSHBULK( uint64_t, lua_pushinteger, lua_Integer ); break;
+			default:
+				if (sizeof( float ) == p->s)
+					T_PCK_PUSHBULK( float,  lua_pushnumber, lua_Number )
+				else
+					T_PCK_PUSHBULK( double, lua_pushnumber, lua_Number )
+		}
+	}
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * __call helper to read from a T.Pack.Reader/Struct instance.
- * Leaves one element on the stack.
+ * Leaves one element on the stack.  Combinators run over their compiled plan
+ * and touch their index table only for the names of a Struct.
  * \param   L         lua Virtual Machine.
  * \param   stuct t_pck   T.Pack instance.
  * \param   char *        buffer to read from.
@@ -1237,66 +2103,330 @@ lt_pck__len( lua_State *L )
 int
 t_pcr__callread( lua_State *L, struct t_pck *pc, const unsigned char *b )
 {
-	struct t_pck *p;      ///< packer currently processing
-	size_t        sz = 0; ///< size of packer currently processing
-	size_t         n;     /// iterator for complex types
+	struct t_pck_op *op = pc->o; ///< op currently processing
+	struct t_pck     e;          ///< bit sized array element at its offset
+	size_t           sz;         ///< size of array element in bits
+	size_t           n;          ///< iterator for complex types
 
-	if (pc->t < T_PCK_ARR)         // handle atomic packer, return single value
+	switch (pc->t)
 	{
-		return t_pck_read( L, pc,  b );
+		case T_PCK_ARR:
+			if (t_pck_isbulk( op->p ))
+				return t_pck_readbulk( L, op->p, b, op->p->s, pc->s, 0 );
+			lua_createtable( L, pc->s, 0 );                 //S:...,res
+			sz = t_pck_getsize( L, op->p, 1 );
+			e  = *(op->p);
+			for (n=0; n < pc->s; n++)
+			{
+				if (T_PCK_BOL == e.t  || T_PCK_BTS == e.t  || T_PCK_BTU == e.t)
+				{
+					e.m = (sz * n) % NB;
+					t_pck_read( L, &e, b + (sz * n) / NB );
+				}
+				else
+					t_pcr__callread( L, op->p, b + (sz * n) / NB );
+				lua_rawseti( L, -2, n+1 );                   //S:...,res
+			}
+			return 1;
+		case T_PCK_SEQ:
+			lua_createtable( L, pc->s, 0 );                 //S:...,res
+			for (n=0; n < pc->s; n++, op++)
+			{
+				t_pcr__callread( L, op->p, b + op->o );     //S:...,res,val
+				lua_rawseti( L, -2, n+1 );
+			}
+			return 1;
+		case T_PCK_STR:
+			lua_createtable( L, 0, pc->s );                 //S:...,res
+			lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );     //S:...,res,idx
+			for (n=0; n < pc->s; n++, op++)
+			{
+				lua_rawgeti( L, -1, 2*pc->s+n+1 );           //S:...,res,idx,name
+				t_pcr__callread( L, op->p, b + op->o );     //S:...,res,idx,name,val
+				lua_rawset( L, -4 );                         //S:...,res,idx
+			}
+			lua_pop( L, 1 );
+			return 1;
+		default:                     // handle atomic packer, return single value
+			return t_pck_read( L, pc, b );
 	}
-	// for all others we need the p->m and a result table
-	lua_createtable( L, pc->s, 0 );             //S:...,res
-	lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m ); //S:...,res,idx
-	if (pc->t == T_PCK_ARR)        // handle Array; return table
+}
+
+
+/**--------------------------------------------------------------------------
+ * __call helper to write to a T.Pack.Reader/Struct instance.
+ * Writes the value on top of the stack and leaves the stack unchanged.  For
+ * Combinators the value must be a table; Arrays and Sequences by index and
+ * Structs by member name.
+ * \param   L         lua Virtual Machine.
+ * \param   stuct t_pck   T.Pack instance.
+ * \param   char *        buffer to write to.
+ * \lparam  value         Lua value to write.
+ * \return  int    # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+int
+t_pcr__callwrite( lua_State *L, struct t_pck *pc, unsigned char *b )
+{
+	struct t_pck_op *op = pc->o; ///< op currently processing
+	struct t_pck     e;          ///< bit sized array element at its offset
+	size_t           sz;         ///< size of array element in bits
+	size_t           n;          ///< iterator for complex types
+
+	if (pc->t < T_PCK_ARR)
+		return t_pck_write( L, pc, b );
+	luaL_argcheck( L, lua_istable( L, -1 ), lua_gettop( L ),
+		"value to pack into a Combinator must be a table" );
+	switch (pc->t)
 	{
-		p = t_pck_check_ud( L, -1, 1 );
-		sz = t_pck_getsize( L, p, 1 );       // size in bits!
-		for (n=1; n <= pc->s; n++)
-		{
-			if (T_PCK_BOL == p->t  || T_PCK_BTS == p->t  || T_PCK_BTU == p->t)
+		case T_PCK_ARR:
+			sz = t_pck_getsize( L, op->p, 1 );
+			e  = *(op->p);
+			for (n=0; n < pc->s; n++)
 			{
+				lua_rawgeti( L, -1, n+1 );                   //S:...,tbl,val
+				if (T_PCK_BOL == e.t  || T_PCK_BTS == e.t  || T_PCK_BTU == e.t)
+				{
+					e.m = (sz * n) % NB;
+					t_pck_write( L, &e, b + (sz * n) / NB );
+				}
+				else
+					t_pcr__callwrite( L, op->p, b + (sz * n) / NB );
 				lua_pop( L, 1 );
-				p = t_pck_create_ud( L, p->t, p->s,
-					((p->s * (n-1)) % NB ) );
 			}
-			t_pcr__callread( L, p, b + ((sz * (n-1)) /8) );       // Stack: ...,res,typ,val
-			lua_rawseti( L, -3, n );
-		}
-		lua_pop( L, 1 );
-		return 1;
+			break;
+		case T_PCK_SEQ:
+			for (n=0; n < pc->s; n++, op++)
+			{
+				lua_rawgeti( L, -1, n+1 );                   //S:...,tbl,val
+				t_pcr__callwrite( L, op->p, b + op->o );
+				lua_pop( L, 1 );
+			}
+			break;
+		case T_PCK_STR:
+			lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );     //S:...,tbl,idx
+			for (n=0; n < pc->s; n++, op++)
+			{
+				lua_rawgeti( L, -1, 2*pc->s+n+1 );           //S:...,tbl,idx,name
+				lua_rawget( L, -3 );                         //S:...,tbl,idx,val
+				t_pcr__callwrite( L, op->p, b + op->o );
+				lua_pop( L, 1 );
+			}
+			lua_pop( L, 1 );
+			break;
+		default:
+			return t_push_error( L, "Can't pack a value in unknown packer type" );
 	}
-	if (pc->t == T_PCK_SEQ)       // handle Sequence, return table
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read a value of any packer from a limited number of bytes.
+ * \detail  Fixed sized packers read their compiled plan.  Combinators holding
+ *          variable sized elements walk them with a cursor since the offsets
+ *          depend on the packed data.
+ * \param   L         lua Virtual Machine.
+ * \param   stuct t_pck   T.Pack instance.
+ * \param   char *        buffer to read from.
+ * \param   size_t        number of bytes available.
+ * \lreturn value         read from the buffer.
+ * \return  size_t        number of bits read.
+ * -------------------------------------------------------------------------*/
+size_t
+t_pck_readl( lua_State *L, struct t_pck *pc, const unsigned char *b, size_t l )
+{
+	struct t_pck_op *op = pc->o; ///< op currently processing
+	size_t           c  = 0;     ///< cursor in bits
+	size_t           n;          ///< iterator for complex types
+
+	if (! T_PCK_ISVAR( pc ))
 	{
-		for (n=1; n <= pc->s; n++)
-		{
-			lua_rawgeti( L, -1, n );           //S:...,res,idx,pack
-			lua_rawgeti( L, -2, pc->s+n );     //S:...,res,idx,pack,ofs
-			p = t_pck_check_ud( L, -2, 1 );
-			t_pcr__callread( L, p, b + luaL_checkinteger( L, -1 ) );//S:...,res,idx,pack,ofs,val
-			lua_rawseti( L, -5, n );           //S:...,res,idx,pack,ofs
-			lua_pop( L, 2 );
-		}
-		lua_pop( L, 1 );
-		return 1;
+		if (t_pck_getsize( L, pc, 0 ) > l)
+			luaL_error( L, "packed %s is truncated", t_pck_t_lst[ pc->t ] );
+		t_pcr__callread( L, pc, b );
+		return pc->b;
 	}
-	if (pc->t == T_PCK_STR)       // handle Struct, return table
+	if (pc->t < T_PCK_ARR)
+		return t_pck_readvar( L, pc, b, l ) * NB;
+
+	lua_createtable( L, (T_PCK_STR == pc->t) ? 0 : pc->s, (T_PCK_STR == pc->t) ? pc->s : 0 );
+	lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );        //S:...,res,idx
+	for (n=0; n < pc->s; n++)
 	{
-		for (n=1; n <= pc->s; n++)
+		if (T_PCK_STR == pc->t)
+			lua_rawgeti( L, -1, 2*pc->s+n+1 );           //S:...,res,idx,name
+		else
+			lua_pushinteger( L, n+1 );                    //S:...,res,idx,n
+		c += t_pck_readl( L, op->p, b + c/NB, l - c/NB ); //S:...,res,idx,key,val
+		lua_rawset( L, -4 );                            //S:...,res,idx
+		op += (T_PCK_ARR != pc->t);                     // Arrays repeat their op
+	}
+	lua_pop( L, 1 );
+	return c;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Write the value on top of the stack to a limited number of bytes.
+ * \param   L         lua Virtual Machine.
+ * \param   stuct t_pck   T.Pack instance.
+ * \param   char *        buffer to write to; NULL only measures the size.
+ * \param   size_t        number of bytes available.
+ * \lparam  value         Lua value to write.
+ * \return  size_t        number of bits written.
+ * -------------------------------------------------------------------------*/
+static size_t
+t_pck_writel( lua_State *L, struct t_pck *pc, unsigned char *b, size_t l )
+{
+	struct t_pck_op *op = pc->o; ///< op currently processing
+	size_t           c  = 0;     ///< cursor in bits
+	size_t           n;          ///< iterator for complex types
+
+	if (! T_PCK_ISVAR( pc ))
+	{
+		if (NULL == b)
+			return pc->b;
+		if (t_pck_getsize( L, pc, 0 ) > l)
+			luaL_error( L, "%s to pack is too big for the Buffer", t_pck_t_lst[ pc->t ] );
+		t_pcr__callwrite( L, pc, b );
+		return pc->b;
+	}
+	if (pc->t < T_PCK_ARR)
+		return t_pck_putvar( L, pc, b, l ) * NB;
+
+	luaL_argcheck( L, lua_istable( L, -1 ), lua_gettop( L ),
+		"value to pack into a Combinator must be a table" );
+	lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );        //S:...,tbl,idx
+	for (n=0; n < pc->s; n++)
+	{
+		if (T_PCK_STR == pc->t)
 		{
-			lua_rawgeti( L, -1, n );           //S:...,res,idx,pack
-			lua_rawgeti( L, -2, pc->s+n );     //S:...,res,idx,pack,ofs
-			lua_rawgeti( L, -3, 2*pc->s+n );   //S:...,res,idx,pack,ofs,name
-			p = t_pck_check_ud( L, -3, 1 );
-			t_pcr__callread( L, p, b + luaL_checkinteger( L, -2 ) );//S:...,res,idx,pack,ofs,name,val
-			lua_rawset( L, -5 );               // Stack: ...,res,idx,pack,ofs
-			lua_pop( L, 2 );
+			lua_rawgeti( L, -1, 2*pc->s+n+1 );           //S:...,tbl,idx,name
+			lua_rawget( L, -3 );                         //S:...,tbl,idx,val
 		}
+		else
+			lua_rawgeti( L, -2, n+1 );                   //S:...,tbl,idx,val
+		c += t_pck_writel( L, op->p,
+		                   (NULL == b) ? NULL : b + c/NB,
+		                   (NULL == b) ? 0    : l - c/NB );
 		lua_pop( L, 1 );
-		return 1;
+		op += (T_PCK_ARR != pc->t);                     // Arrays repeat their op
 	}
-	lua_pushnil( L );
-	return 1;
+	lua_pop( L, 1 );
+	return c;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the size of packed data without reading it.
+ * \param   L         lua Virtual Machine.
+ * \param   stuct t_pck   T.Pack instance.
+ * \param   char *        buffer to measure.
+ * \param   size_t        number of bytes available.
+ * \return  size_t        number of bits the packed data occupies.
+ * -------------------------------------------------------------------------*/
+static size_t
+t_pck_skipl( lua_State *L, struct t_pck *pc, const unsigned char *b, size_t l )
+{
+	struct t_pck_op *op = pc->o; ///< op currently processing
+	size_t           c  = 0;     ///< cursor in bits
+	size_t           n;          ///< iterator for complex types
+	lua_Unsigned     v;
+
+	if (! T_PCK_ISVAR( pc ))
+	{
+		if (t_pck_getsize( L, pc, 0 ) > l)
+			luaL_error( L, "packed %s is truncated", t_pck_t_lst[ pc->t ] );
+		return pc->b;
+	}
+	if (pc->t < T_PCK_ARR)
+		return t_pck_getvar( L, pc, b, l, &v ) * NB;
+	for (n=0; n < pc->s; n++)
+	{
+		c  += t_pck_skipl( L, op->p, b + c/NB, l - c/NB );
+		op += (T_PCK_ARR != pc->t);                     // Arrays repeat their op
+	}
+	return c;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the offset of a T.Pack.Reader in the packed data.
+ * \detail  Readers behind variable sized elements record their index only
+ *          and skip the elements in front of them on every access.
+ * \param   L         lua Virtual Machine.
+ * \param   int       stack position of T.Pack or T.Pack.Reader.
+ * \param   char *    the entire packed data.
+ * \param   size_t    length of the packed data.
+ * \return  size_t    offset in bytes.
+ * -------------------------------------------------------------------------*/
+static size_t
+t_pck_resolve( lua_State *L, int pR, const unsigned char *b, size_t l )
+{
+	struct t_pcr    *pr = (struct t_pcr *) luaL_testudata( L, pR, "T.Pack.Reader" );
+	struct t_pck    *pc;         ///< packer of the parent
+	struct t_pck_op *op;
+	size_t           o;          ///< offset of the parent
+	size_t           c  = 0;     ///< cursor in bits
+	size_t           n;
+
+	if (NULL == pr || 0 == pr->i)
+		return (NULL == pr) ? 0 : pr->o;
+	lua_getuservalue( L, pR );
+	lua_rawgetp( L, -1, &_reader_parent );     // Stack: ...,cache,parent
+	lua_remove( L, -2 );
+	o  = t_pck_resolve( L, lua_gettop( L ), b, l );
+	pc = t_pck_getpckreader( L, -1, NULL );
+	lua_pop( L, 1 );
+	op = pc->o;
+	if (T_PCK_ARR == pc->t && ! T_PCK_ISVAR( pc ))
+		return o + (t_pck_getsize( L, op->p, 1 ) * (pr->i-1)) / NB;
+	if (T_PCK_ARR != pc->t && T_PCK_NOOFS != op[ pr->i-1 ].o)
+		return o + op[ pr->i-1 ].o;
+	if (o > l)
+		luaL_error( L, "packed %s is truncated", t_pck_t_lst[ pc->t ] );
+	for (n=1; n < pr->i; n++)
+	{
+		c  += t_pck_skipl( L, op->p, b + o + c/NB, l - o - c/NB );
+		op += (T_PCK_ARR != pc->t);                     // Arrays repeat their op
+	}
+	return o + c/NB;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the bytes a T.Pack or T.Pack.Reader covers in a T.Buffer or string.
+ * \param  L     lua Virtual Machine.
+ * \param  int   position of T.Pack or T.Pack.Reader on Lua stack.
+ * \param  int   position of T.Buffer or string on Lua stack.
+ * \param  struct t_pck**  gets the packer assigned.
+ * \param  size_t*  gets the number of bytes available from there assigned.
+ * \return pointer to the first byte.
+ * --------------------------------------------------------------------------*/
+static unsigned char
+*t_pck_locate( lua_State *L, int pP, int pS, struct t_pck **pcp, size_t *l )
+{
+	struct t_pcr  *pr = NULL;
+	struct t_pck  *pc;
+	unsigned char *b;
+	size_t         o;
+
+	pP = lua_absindex( L, pP );
+	lua_pushvalue( L, pP );
+	pc = t_pck_getpckreader( L, -1, &pr );
+	lua_pop( L, 1 );
+	*pcp = pc;
+	if ((NULL == pr || 0 == pr->i) && ! T_PCK_ISVAR( pc ))
+	{
+		*l = t_pck_getsize( L, pc, 0 );
+		return (unsigned char *) t_pck_srcptr( L, pS, (NULL == pr) ? 0 : pr->o, *l );
+	}
+	b = (unsigned char *) t_buf_checklstring( L, pS, l );
+	o = t_pck_resolve( L, pP, b, *l );
+	luaL_argcheck( L, o <= *l && t_pck_getsize( L, pc, 0 ) <= *l - o, pS,
+		"The length of the Buffer must be longer than Pack offset plus Pack length." );
+	*l -= o;
+	return b + o;
 }
 
 
@@ -1314,51 +2444,405 @@ t_pcr__callread( lua_State *L, struct t_pck *pc, const unsigned char *b )
 static int
 lt_pcr__call( lua_State *L )
 {
-	struct t_pcr  *pr = NULL;
-	struct t_pck  *pc = t_pck_getpckreader( L, 1, &pr );
-
-	size_t         o  = (NULL == pr) ? 0 : pr->o;
-
-	struct t_buf  *buf;
+	struct t_pcr  *pr = (struct t_pcr *) luaL_testudata( L, 1, "T.Pack.Reader" );
+	struct t_pck  *pc;
 	unsigned char *b;
-	size_t         l;                   /// length of string or buffer overall
+	size_t         l;                   /// length of string or buffer from the Pack on
+
 	luaL_argcheck( L,  2<=lua_gettop( L ) && lua_gettop( L )<=3, 2,
 		"Calling an T.Pack.Reader takes 2 or 3 arguments!" );
-
+	luaL_argcheck( L,  lua_isuserdata( L, 2 ) || 2 == lua_gettop( L ), 2,
+		"Can't write to a Lua String since they are immutable." );
 	// are we reading/writing to from T.Buffer or Lua String
 	if (lua_isuserdata( L, 2 ))      // T.Buffer
+		t_buf_check_ud ( L, 2, 1 );
+	// rings wrapping within the Pack get linearized
+	b = t_pck_locate( L, 1, 2, &pc, &l );
+
+	if (2 == lua_gettop( L ))    // read from input
 	{
-		buf = t_buf_check_ud ( L, 2, 1 );
-		luaL_argcheck( L,  buf->len >= o+t_pck_getsize( L, pc, 0 ), 2,
-			"The length of the Buffer must be longer than Pack offset plus Pack length." );
-		b   =  &(buf->b[ o ]);
+		t_pck_readl( L, pc, b, l );
+		return 1;
+	}
+	else                              // write to input
+	{
+		// data behind a variable sized field must stay where it is
+		luaL_argcheck( L, NULL == pr || ! T_PCK_ISVAR( pc ) ||
+		                  t_pck_skipl( L, pc, b, l ) == t_pck_writel( L, pc, NULL, 0 ), 3,
+		   "value must keep the packed size of a variable sized field" );
+		t_pck_writel( L, pc, b, l );
+		return 0;
+	}
+}
+
+
+//###########################################################################
+//   ____
+//  / ___|   _ _ __ ___  ___  _ __
+// | |  | | | | '__/ __|/ _ \| '__|
+// | |__| |_| | |  \__ \ (_) | |
+//  \____\__,_|_|  |___/\___/|_|
+//###########################################################################
+/**--------------------------------------------------------------------------
+ * Check if the item on stack position pos is a T.Pack.Cursor.
+ * \param   L      the Lua State
+ * \param   pos    position on the stack
+ * \param   check  raise an error if it isn't
+ * \return  struct t_pcc* pointer to the cursor
+ * --------------------------------------------------------------------------*/
+static struct t_pcc
+*t_pcc_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, "T.Pack.Cursor" );
+	luaL_argcheck( L, (ud != NULL || !check), pos, "`T.Pack.Cursor` expected" );
+	return (NULL==ud) ? NULL : (struct t_pcc *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the index of a Combinator element by its key.
+ * \param   L    The lua state.
+ * \param   struct t_pck*  the Combinator.
+ * \param   int  stack position of the key; a member name or an index.
+ * \return  size_t  1 based index; 0 if there is no such element.
+ * --------------------------------------------------------------------------*/
+static size_t
+t_pck_keyindex( lua_State *L, struct t_pck *pc, int pK )
+{
+	lua_Integer i = 0;
+
+	pK = lua_absindex( L, pK );
+	if (pc->t < T_PCK_ARR)
+		return 0;
+	if (T_PCK_STR == pc->t && LUA_TSTRING == lua_type( L, pK ))
+	{
+		lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );
+		lua_pushvalue( L, pK );
+		lua_rawget( L, -2 );
+		i = lua_tointeger( L, -1 );
+		lua_pop( L, 2 );
+	}
+	else if (lua_isinteger( L, pK ))
+		i = lua_tointeger( L, pK );
+	return (i < 1 || i > (lua_Integer) pc->s) ? 0 : (size_t) i;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read one element of a fixed sized Combinator.
+ * \param   L    The lua state.
+ * \param   struct t_pck*  the Combinator.
+ * \param   char*   buffer holding the Combinator.
+ * \param   size_t  1 based index of the element.
+ * \lreturn value   of the element.
+ * --------------------------------------------------------------------------*/
+static void
+t_pck_readelem( lua_State *L, struct t_pck *pc, const unsigned char *b, size_t i )
+{
+	struct t_pck e;   ///< bit sized array element at its offset
+	size_t       o;   ///< offset of the element in bits
+
+	if (T_PCK_ARR != pc->t)
+	{
+		t_pcr__callread( L, pc->o[ i-1 ].p, b + pc->o[ i-1 ].o );
+		return;
+	}
+	e = *(pc->o[ 0 ].p);
+	o = t_pck_getsize( L, &e, 1 ) * (i-1);
+	if (T_PCK_BOL == e.t  || T_PCK_BTS == e.t  || T_PCK_BTU == e.t)
+	{
+		e.m = o % NB;
+		t_pck_read( L, &e, b + o/NB );
 	}
 	else
+		t_pcr__callread( L, pc->o[ 0 ].p, b + o/NB );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the bytes of the current record of a cursor.
+ * \param   L    The lua state.
+ * \param   struct t_pcc*  the cursor.
+ * \param   int  stack position of the cursor.
+ * \return  pointer to the first byte of the record.
+ * --------------------------------------------------------------------------*/
+static const unsigned char
+*t_pcc_ptr( lua_State *L, struct t_pcc *c, int pC )
+{
+	const unsigned char *b;
+
+	luaL_argcheck( L, c->i > 0, pC, "T.Pack.Cursor is not positioned on a record" );
+	lua_getuservalue( L, pC );         // the source is anchored by the cursor
+	b = t_pck_srcptr( L, lua_gettop( L ), c->o, c->s );
+	lua_pop( L, 1 );
+	return b;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Advance the cursor to the next record.
+ * \detail  Without projection it returns the cursor itself.  With projection
+ *          the selected fields get decoded into the same table each time.
+ * \param   L lua Virtual Machine.
+ * \upvalue T.Pack.Cursor.
+ * \upvalue table  keys of projected fields or nil.
+ * \upvalue table  reused result of the projection or nil.
+ * \lreturn int    index of the record.
+ * \lreturn T.Pack.Cursor or projection table.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+t_pcc_iter( lua_State *L )
+{
+	struct t_pcc        *c = t_pcc_check_ud( L, lua_upvalueindex( 1 ), 1 );
+	struct t_pck        *pc;
+	const unsigned char *b;
+	size_t               j, n;
+
+	if (c->i >= c->n)
+		return 0;
+	c->o = c->b + c->i * c->s;
+	c->i++;
+	lua_pushinteger( L, (lua_Integer) c->i );
+	if (lua_isnil( L, lua_upvalueindex( 2 ) ))
 	{
-		b   = (unsigned char *) luaL_checklstring( L, 2, &l );
-		luaL_argcheck( L,  l >= o + t_pck_getsize( L, pc, 0 ), 2,
-			"The length of the Buffer must be longer than Pack offset plus Pack length." );
-		luaL_argcheck( L,  2 == lua_gettop( L ), 2,
-			"Can't write to a Lua String since they are immutable." );
-		b   =  b + o;
+		lua_pushvalue( L, lua_upvalueindex( 1 ) );
+		return 2;
 	}
+	lua_rawgeti( L, LUA_REGISTRYINDEX, c->r );
+	pc = t_pck_check_ud( L, -1, 1 );
+	b  = t_pcc_ptr( L, c, lua_upvalueindex( 1 ) );
+	lua_pushvalue( L, lua_upvalueindex( 3 ) );      // Stack: i,Pack,res
+	n  = lua_rawlen( L, lua_upvalueindex( 2 ) );
+	for (j=1; j<=n; j++)
+	{
+		lua_rawgeti( L, lua_upvalueindex( 2 ), j );  // Stack: i,Pack,res,key
+		t_pck_readelem( L, pc, b, t_pck_keyindex( L, pc, -1 ) );
+		lua_rawset( L, -3 );                         // Stack: i,Pack,res
+	}
+	lua_remove( L, -2 );
+	return 2;
+}
 
-	if (2 == lua_gettop( L ))    // read from input
+
+/**--------------------------------------------------------------------------
+ * Iterate over consecutive fixed sized records in a T.Buffer or string.
+ * \detail  All steps yield the same T.Pack.Cursor.  Indexing the cursor reads
+ *          a single field of the current record, calling it reads the entire
+ *          record.  A list of fields projects them into one table which gets
+ *          reused for every record, so a scan allocates a constant number of
+ *          objects.
+ * \param   L  The lua state.
+ * \lparam  ud     T.Pack of a record or T.Pack.Array of records.
+ * \lparam  ud     T.Buffer or string holding the records.
+ * \lparam  int    offset of the first record in bytes (opt, default 0).
+ * \lparam  int    number of records (opt, default length of the Array or
+ *                 as many as the source holds).
+ * \lparam  table  list of fields to project (opt).
+ * \lreturn function iterator.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pck_each( lua_State *L )
+{
+	size_t        bo = 0;
+	struct t_pck *pc = t_pck_getpck( L, 1, &bo );
+	lua_Integer   o  = luaL_optinteger( L, 3, 0 );
+	lua_Integer   n  = -1;
+	struct t_pcc *c;
+	size_t        l, j;
+
+	t_buf_checklstring( L, 2, &l );
+	lua_settop( L, 5 );
+	if (T_PCK_ARR == pc->t)           // the element is the record
 	{
-		return t_pcr__callread( L, pc, b );
+		n  = (lua_Integer) pc->s;
+		lua_rawgeti( L, LUA_REGISTRYINDEX, pc->m );
+		lua_replace( L, 1 );
+		pc = pc->o[ 0 ].p;
 	}
-	else                              // write to input
+	luaL_argcheck( L, ! T_PCK_ISVAR( pc ) && 0 == pc->b % NB, 1,
+		"records must be fixed sized and cover whole bytes" );
+	luaL_argcheck( L, 0 <= o && (size_t) o <= l, 3, "offset must be within the source" );
+	n = luaL_optinteger( L, 4, (n < 0) ? (lua_Integer) ((l - o) / (pc->b / NB)) : n );
+	luaL_argcheck( L, 0 <= n && (size_t) n <= (l - o) / (pc->b / NB), 4,
+		"the source is too short for the records" );
+	if (! lua_isnil( L, 5 ))
 	{
-		if (pc->t < T_PCK_ARR)          // handle atomic packer, return single value
+		luaL_checktype( L, 5, LUA_TTABLE );
+		for (j=1; j <= lua_rawlen( L, 5 ); j++)
 		{
-			return t_pck_write( L, pc, (unsigned char *) b );
-		}
-		else  // create a table ...
-		{
-			return t_push_error( L, "writing of complex types is not yet implemented");
+			lua_rawgeti( L, 5, j );
+			luaL_argcheck( L, 0 != t_pck_keyindex( L, pc, -1 ), 5,
+				"fields must be members of the record" );
+			lua_pop( L, 1 );
 		}
 	}
 
+	c    = (struct t_pcc *) lua_newuserdata( L, sizeof( struct t_pcc ) );
+	c->b = (size_t) o;
+	c->s = pc->b / NB;
+	c->n = (size_t) n;
+	c->i = 0;
+	c->o = c->b;
+	lua_pushvalue( L, 1 );
+	c->r = luaL_ref( L, LUA_REGISTRYINDEX );
+	luaL_getmetatable( L, "T.Pack.Cursor" );
+	lua_setmetatable( L, -2 );
+	lua_pushvalue( L, 2 );
+	lua_setuservalue( L, -2 );        // Stack: Pack,src,o,n,fld,Cursor
+
+	lua_pushvalue( L, 5 );
+	if (lua_isnil( L, 5 ))
+		lua_pushnil( L );
+	else
+		lua_createtable( L, 0, (int) lua_rawlen( L, 5 ) );
+	lua_pushcclosure( L, &t_pcc_iter, 3 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Gather one field of consecutive records into a dense vector.
+ * \detail  The field is read from every record at its precomputed offset in
+ *          one strided loop without creating a value per record.  By default
+ *          the result is a new T.Buffer holding the values in native byte
+ *          order; a table, T.Buffer or, if compiled in, T.Numarray can be
+ *          passed as target instead.
+ * \param   L  The lua state.
+ * \lparam  ud     T.Pack of a record or T.Pack.Array of records.
+ * \lparam  ud     T.Buffer or string holding the records.
+ * \lparam  key    member name or index of a field holding a byte sized number.
+ * \lparam  int    number of records (opt, default length of the Array or
+ *                 as many as the source holds).
+ * \lparam  int    distance between records in bytes (opt, default record size).
+ * \lparam  mixed  table, T.Buffer or T.Numarray to read into (opt).
+ * \lreturn mixed  the target.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pck_column( lua_State *L )
+{
+	size_t               bo = 0;
+	struct t_pck        *pc = t_pck_getpck( L, 1, &bo );
+	struct t_pck        *p;       ///< packer of the field
+	lua_Integer          n  = -1;
+	lua_Integer          st;
+	const unsigned char *b;
+	size_t               l, i, o;
+
+	b = (const unsigned char *) t_buf_checklstring( L, 2, &l );
+	lua_settop( L, 6 );
+	if (T_PCK_ARR == pc->t)           // the element is the record
+	{
+		n  = (lua_Integer) pc->s;
+		pc = pc->o[ 0 ].p;
+	}
+	luaL_argcheck( L, ! T_PCK_ISVAR( pc ), 1, "records must be fixed sized" );
+	luaL_argcheck( L, 0 != (i = t_pck_keyindex( L, pc, 3 )), 3,
+		"field must be a member of the record" );
+	if (T_PCK_ARR == pc->t)
+	{
+		p = pc->o[ 0 ].p;
+		o = t_pck_getsize( L, p, 1 ) * (i-1) / NB;
+	}
+	else
+	{
+		p = pc->o[ i-1 ].p;
+		o = pc->o[ i-1 ].o;
+	}
+	luaL_argcheck( L, t_pck_isbulk( p ), 3, "field must be a byte sized number" );
+	st = luaL_optinteger( L, 5, (lua_Integer) t_pck_getsize( L, pc, 0 ) );
+	luaL_argcheck( L, st > 0, 5, "stride must be positive" );
+	n  = luaL_optinteger( L, 4, (n < 0)
+		? ((l < o + p->s) ? 0 : (lua_Integer) ((l - o - p->s) / st + 1))
+		: n );
+	luaL_argcheck( L, n >= 0 &&
+	   (0 == n || o + p->s + (size_t) (n-1) * (size_t) st <= l), 4,
+	   "the source is too short for the records" );
+	if (lua_isnil( L, 6 ))
+	{
+		t_buf_create_ud( L, (int) (n * p->s) );
+		lua_replace( L, 6 );
+	}
+	return t_pck_readbulk( L, p, b + o, (size_t) st, (size_t) n, 6 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read a field of the current record of a T.Pack.Cursor.
+ * \param   L    The lua state.
+ * \lparam  ud     T.Pack.Cursor instance.
+ * \lparam  key    member name or index.
+ * \lreturn value  of the field or nil if the record has no such field.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pcc__index( lua_State *L )
+{
+	struct t_pcc *c  = t_pcc_check_ud( L, 1, 1 );
+	struct t_pck *pc;
+	size_t        i;
+
+	lua_rawgeti( L, LUA_REGISTRYINDEX, c->r );
+	pc = t_pck_check_ud( L, -1, 1 );
+	if (0 == (i = t_pck_keyindex( L, pc, 2 )))
+		lua_pushnil( L );
+	else
+		t_pck_readelem( L, pc, t_pcc_ptr( L, c, 1 ), i );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read the entire current record of a T.Pack.Cursor.
+ * \param   L    The lua state.
+ * \lparam  ud     T.Pack.Cursor instance.
+ * \lreturn value  of the record.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pcc__call( lua_State *L )
+{
+	struct t_pcc *c  = t_pcc_check_ud( L, 1, 1 );
+	struct t_pck *pc;
+
+	lua_rawgeti( L, LUA_REGISTRYINDEX, c->r );
+	pc = t_pck_check_ud( L, -1, 1 );
+	return t_pcr__callread( L, pc, t_pcc_ptr( L, c, 1 ) );
+}
+
+
+/**--------------------------------------------------------------------------
+ * __tostring (print) representation of a T.Pack.Cursor instance.
+ * \param   L     The lua state.
+ * \lparam  ud    T.Pack.Cursor instance.
+ * \lreturn string    formatted string representing the cursor.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_pcc__tostring( lua_State *L )
+{
+	struct t_pcc *c  = t_pcc_check_ud( L, 1, 1 );
+
+	lua_pushfstring( L, "T.Pack.Cursor[%d/%d](%d): %p",
+	   (int) c->i, (int) c->n, (int) c->o, c );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * __gc Garbage Collector. Releases the record packer from Lua Registry.
+ * \param  L lua Virtual Machine.
+ * \lparam ud    T.Pack.Cursor.
+ * \return  int    # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+static int
+lt_pcc__gc( lua_State *L )
+{
+	struct t_pcc *c  = t_pcc_check_ud( L, 1, 1 );
+
+	luaL_unref( L, LUA_REGISTRYINDEX, c->r );
 	return 0;
 }
 
@@ -1378,8 +2862,14 @@ static const struct luaL_Reg t_pck_fm [] = {
 static const struct luaL_Reg t_pck_cf [] = {
 	{ "new",       lt_pck_New },
 	{ "size",      lt_pck_size },
+	{ "pack",      lt_pck_pack },
+	{ "readinto",  lt_pck_readinto },
+	{ "each",      lt_pck_each },
+	{ "column",    lt_pck_column },
 	{ "get_ref",   lt_pck_getir },
 	{ "setendian", lt_pck_defaultendian },
+	{ "fetchadd",  lt_pck_fetchadd },
+	{ "cas",       lt_pck_cas },
 	{ NULL,    NULL }
 };
 
@@ -1397,6 +2887,17 @@ static const luaL_Reg t_pck_m [] = {
 	{ NULL,    NULL }
 };
 
+/**--------------------------------------------------------------------------
+ * Cursor metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_pcc_m [] = {
+	{ "__call",          lt_pcc__call },
+	{ "__index",         lt_pcc__index },
+	{ "__gc",            lt_pcc__gc },
+	{ "__tostring",      lt_pcc__tostring },
+	{ NULL,    NULL }
+};
+
 /**--------------------------------------------------------------------------
  * pushes the T.Pack.Reader library onto the stack
  *          - creates Metatable with functions
@@ -1412,6 +2913,10 @@ luaopen_t_pckr( lua_State *L )
 	luaL_newmetatable( L, "T.Pack.Reader" );   // stack: functions meta
 	luaL_setfuncs( L, t_pck_m, 0 );
 	lua_pop( L, 1 );        // remove metatable from stack
+	// T.Pack.Cursor instance metatable
+	luaL_newmetatable( L, "T.Pack.Cursor" );
+	luaL_setfuncs( L, t_pcc_m, 0 );
+	lua_pop( L, 1 );
 	return 0;
 }
 
@@ -1431,6 +2936,20 @@ luaopen_t_pck( lua_State *L )
 	luaL_setfuncs( L, t_pck_m, 0 );
 	lua_pop( L, 1 );        // remove metatable from stack
 
+	// packers compiled from fmt strings; weak so unused ones get collected
+	lua_newtable( L );
+	lua_createtable( L, 0, 1 );
+	lua_pushliteral( L, "v" );
+	lua_setfield( L, -2, "__mode" );
+	lua_setmetatable( L, -2 );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &_fmt_cache );
+
+	// metatable of the Reader caches of indexed objects
+	lua_createtable( L, 0, 1 );
+	lua_pushliteral( L, "v" );
+	lua_setfield( L, -2, "__mode" );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &_reader_cache );
+
 	// Push the class onto the stack
 	// this is avalable as T.Pack.<member>
 	luaL_newlib( L, t_pck_cf );
@@ -9,13 +9,13 @@
  */
 
 
-#ifdef _WIN32
-#include <time.h>
-#else
+#include "t.h"
+
+#include <time.h>        // clock_gettime()
+#ifndef _WIN32
 #include <sys/time.h>    // gettimeofday()
 #endif
 
-#include "t.h"
 #include "t_tim.h"
 
 
@@ -89,6 +89,50 @@ t_tim_getms( struct timeval *tA )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Reads the monotonic clock.
+ * \detail  Unlike gettimeofday() this clock is not affected by changes to the
+ *          system time and therefore is the base for all loop scheduling.
+ * \return  uint64_t  nanoseconds since an arbitrary starting point
+ * --------------------------------------------------------------------------*/
+uint64_t
+t_tim_mono( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Gets nanoseconds worth of tm
+ * \param  *tA struct timeval pointer
+ * \return timeval value in nanoseconds; negative values count as 0
+ * --------------------------------------------------------------------------*/
+uint64_t
+t_tim_getns( struct timeval *tA )
+{
+	return (tA->tv_sec < 0 || (0 == tA->tv_sec && tA->tv_usec < 0))
+		? 0
+		: (uint64_t) tA->tv_sec * 1000000000 + (uint64_t) tA->tv_usec * 1000;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Sets tA to a span of nanoseconds; rounds up to full microseconds
+ * \param  *tA struct timeval pointer
+ * \param  ns  nanoseconds
+ * --------------------------------------------------------------------------*/
+void
+t_tim_setns( struct timeval *tA, uint64_t ns )
+{
+	ns          += 999;
+	tA->tv_sec   = ns / 1000000000;
+	tA->tv_usec  = (ns % 1000000000) / 1000;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 //  _                        _    ____ ___
 // | |   _   _  __ _        / \  |  _ \_ _|
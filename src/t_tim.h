@@ -31,6 +31,11 @@ void     t_tim_sub  ( struct timeval *tA, struct timeval *tB, struct timeval *tX
 void     t_tim_since( struct timeval *tA );
 long     t_tim_getms( struct timeval *tA );
 
+// monotonic clock
+uint64_t t_tim_mono ( void );
+uint64_t t_tim_getns( struct timeval *tA );
+void     t_tim_setns( struct timeval *tA, uint64_t ns );
+
 
 /**--------------------------------------------------------------------------
  * Compare timeval a to timeval b.
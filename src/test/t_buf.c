@@ -0,0 +1,171 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      test/t_buf.c
+ * \brief     Unit test for the lua-t buffer source code
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t_unittest.h"
+
+
+/**--------------------------------------------------------------------------
+ * Call a T.Buffer method protected.
+ * \param   L     the Lua State; the buffer is on top of the stack.
+ * \param   fn    the method.
+ * \param   s     string argument or NULL.
+ * \param   n     integer argument; used if s is NULL.
+ * \return  const char* the error message or NULL if it succeeded; the result
+ *          is left on the stack.
+ *  -------------------------------------------------------------------------*/
+static const char
+*t_buf_test_call( lua_State *L, lua_CFunction fn, const char *s, lua_Integer n )
+{
+	lua_pushcfunction( L, fn );
+	lua_pushvalue( L, -2 );
+	if (NULL != s)
+		lua_pushstring( L, s );
+	else
+		lua_pushinteger( L, n );
+	return (LUA_OK == lua_pcall( L, 2, 1, 0 )) ? NULL : lua_tostring( L, -1 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reserve bytes in a buffer.
+ * \lparam  T.Buffer
+ * \lparam  int      number of bytes.
+ *  -------------------------------------------------------------------------*/
+static int
+t_buf_test_reserve( lua_State *L )
+{
+	t_buf_reserve( L, t_buf_check_ud( L, 1, 1 ), (size_t) luaL_checkinteger( L, 2 ) );
+	return 0;
+}
+
+
+static int
+test_t_buf_ring_wrap( )
+{
+	lua_State     *L = luaL_newstate( );
+	struct t_buf  *buf;
+	unsigned char *p;
+	const char    *e;
+
+	luaopen_t_buf( L );
+	lua_pop( L, 1 );
+	buf = t_buf_create_ol( L, T_BUF_RNG, 8 );
+
+	_assert( NULL == t_buf_test_call( L, lt_buf_append, "abcdef", 0 ) );
+	_assert( 6 == lua_tointeger( L, -1 ) );
+	lua_pop( L, 1 );
+	_assert( NULL == t_buf_test_call( L, lt_buf_consume, NULL, 4 ) );
+	lua_pop( L, 1 );
+	_assert( 4 == buf->rd && 2 == buf->len );
+
+	// only the free space gets filled; it wraps around the end of the storage
+	_assert( NULL == t_buf_test_call( L, lt_buf_append, "ghijklmn", 0 ) );
+	_assert( 6 == lua_tointeger( L, -1 ) );
+	lua_pop( L, 1 );
+	_assert( 8 == buf->len && 4 == buf->rd );
+	_assert( 0 == memcmp( buf->b, "ijklefgh", 8 ) );
+
+	// ranges on either side of the end don't move the content
+	p = t_buf_ptr( buf, 0, 4 );
+	_assert( p == buf->b + 4 && 0 == memcmp( p, "efgh", 4 ) );
+	p = t_buf_ptr( buf, 4, 4 );
+	_assert( p == buf->b && 0 == memcmp( p, "ijkl", 4 ) );
+	_assert( 4 == buf->rd );
+	_assert( NULL == t_buf_ptr( buf, 6, 3 ) );
+
+	// a range across the end linearizes the storage
+	p = t_buf_ptr( buf, 2, 4 );
+	_assert( 0 == buf->rd && p == buf->b + 2 );
+	_assert( 0 == memcmp( buf->b, "efghijkl", 8 ) );
+
+	// a full ring accepts nothing and can't grow
+	_assert( NULL == t_buf_test_call( L, lt_buf_append, "x", 0 ) );
+	_assert( 0 == lua_tointeger( L, -1 ) );
+	lua_pop( L, 1 );
+	e = t_buf_test_call( L, t_buf_test_reserve, NULL, 9 );
+	_assert( NULL != e && NULL != strstr( e, "T.Buffer of 8 bytes can't hold 9 bytes" ) );
+	lua_pop( L, 1 );
+
+	// consuming wraps the read cursor; consuming all rewinds it
+	_assert( NULL == t_buf_test_call( L, lt_buf_consume, NULL, 7 ) );
+	lua_pop( L, 1 );
+	_assert( 7 == buf->rd && 1 == buf->len );
+	_assert( NULL == t_buf_test_call( L, lt_buf_append, "mn", 0 ) );
+	lua_pop( L, 1 );
+	_assert( 0 == memcmp( t_buf_data( buf ), "lmn", 3 ) );
+	_assert( NULL == t_buf_test_call( L, lt_buf_consume, NULL, 3 ) );
+	lua_pop( L, 1 );
+	_assert( 0 == buf->rd && 0 == buf->len );
+	_assert( NULL != t_buf_test_call( L, lt_buf_consume, NULL, 1 ) );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_buf_grow( )
+{
+	lua_State     *L = luaL_newstate( );
+	struct t_buf  *buf;
+	char           s[ 1001 ];
+	const char    *e;
+
+	luaopen_t_buf( L );
+	lua_pop( L, 1 );
+	buf = t_buf_create_ol( L, T_BUF_GRW, 0 );
+	_assert( 0 == buf->cap && NULL == buf->b );
+
+	// capacity starts at 16 and doubles
+	t_buf_reserve( L, buf, 1 );
+	_assert( 16 == buf->cap );
+	_assert( NULL == t_buf_test_call( L, lt_buf_append, "0123456789abcdef", 0 ) );
+	lua_pop( L, 1 );
+	t_buf_reserve( L, buf, 17 );
+	_assert( 32 == buf->cap && 16 == buf->len );
+	_assert( 0 == memcmp( buf->b, "0123456789abcdef", 16 ) );
+	t_buf_reserve( L, buf, 20 );
+	_assert( 32 == buf->cap );
+
+	// appending grows as needed and keeps the content
+	memset( s, 'x', sizeof( s ) - 1 );
+	s[ sizeof( s ) - 1 ] = '\0';
+	_assert( NULL == t_buf_test_call( L, lt_buf_append, s, 0 ) );
+	_assert( 1000 == lua_tointeger( L, -1 ) );
+	lua_pop( L, 1 );
+	_assert( 1016 == buf->len && 1024 == buf->cap );
+	_assert( 0 == memcmp( buf->b, "0123456789abcdef", 16 ) );
+	_assert( 0 == memcmp( buf->b + 16, s, 1000 ) );
+
+	// consuming moves the rest to the front
+	_assert( NULL == t_buf_test_call( L, lt_buf_consume, NULL, 10 ) );
+	lua_pop( L, 1 );
+	_assert( 1006 == buf->len && 1024 == buf->cap );
+	_assert( 0 == memcmp( t_buf_data( buf ), "abcdefxx", 8 ) );
+
+	// fixed buffers can't grow
+	t_buf_create_ud( L, 4 );
+	e = t_buf_test_call( L, t_buf_test_reserve, NULL, 5 );
+	_assert( NULL != e && NULL != strstr( e, "T.Buffer of 4 bytes can't hold 5 bytes" ) );
+	lua_close( L );
+	return 0;
+}
+
+
+// Add all testable functions to the array
+static const struct test_function all_tests [] = {
+	{ "Ring buffer wraps around the end of its storage", test_t_buf_ring_wrap },
+	{ "Growable buffer doubles its capacity", test_t_buf_grow },
+	{ NULL, NULL }
+};
+
+int
+main()
+{
+	return test_execute( all_tests );
+}
@@ -0,0 +1,178 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      test/t_buf_pol.c
+ * \brief     Unit test for the lua-t buffer pool source code
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t_unittest.h"
+
+
+/**--------------------------------------------------------------------------
+ * Call a pool or buffer function with one argument protected.
+ * \param   L     the Lua State.
+ * \param   fn    the function.
+ * \param   pos   stack position of the argument.
+ * \return  const char* the error message or NULL if it succeeded; the result
+ *          is left on the stack.
+ *  -------------------------------------------------------------------------*/
+static const char
+*t_buf_pol_test_call( lua_State *L, lua_CFunction fn, int pos )
+{
+	pos = lua_absindex( L, pos );
+	lua_pushcfunction( L, fn );
+	lua_pushvalue( L, pos );
+	return (LUA_OK == lua_pcall( L, 1, 1, 0 )) ? NULL : lua_tostring( L, -1 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a pool and push it onto the stack.
+ * \param   L     the Lua State.
+ * \param   sz    size of each buffer in bytes.
+ * \param   n     number of buffers in the pool.
+ * \param   zr    zero buffers when handing them out.
+ * \return  struct t_buf_pol* the pool.
+ *  -------------------------------------------------------------------------*/
+static struct t_buf_pol
+*t_buf_pol_test_new( lua_State *L, lua_Integer sz, lua_Integer n, int zr )
+{
+	lua_pushcfunction( L, lt_buf_pol_New );
+	lua_pushinteger( L, sz );
+	lua_pushinteger( L, n );
+	lua_pushboolean( L, zr );
+	lua_call( L, 3, 1 );
+	return t_buf_pol_check_ud( L, -1, 1 );
+}
+
+
+static int
+test_t_buf_pol_get( )
+{
+	lua_State        *L = luaL_newstate( );
+	struct t_buf_pol *pl;
+	struct t_buf     *a, *b, *c;
+
+	luaopen_t_buf( L );
+	lua_settop( L, 0 );
+	pl = t_buf_pol_test_new( L, 64, 2, 1 );                        // 1
+
+	// slots are handed out from the beginning of the arena
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 2
+	a = t_buf_check_ud( L, 2, 1 );
+	_assert( T_BUF_POL == a->t && 64 == a->len && 0 == a->rd );
+	_assert( pl->a == a->b );
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 3
+	b = t_buf_check_ud( L, 3, 1 );
+	_assert( T_BUF_POL == b->t && 1 == b->rd );
+	_assert( pl->a + 64 == b->b );
+	_assert( 2 == pl->ht && 0 == pl->ms && 0 == pl->fr );
+
+	// an exhausted pool falls back to ordinary buffers
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 4
+	c = t_buf_check_ud( L, 4, 1 );
+	_assert( T_BUF_FIX == c->t && 64 == c->len );
+	_assert( 2 == pl->ht && 1 == pl->ms );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_buf_pol_release( )
+{
+	lua_State        *L = luaL_newstate( );
+	struct t_buf_pol *pl;
+	struct t_buf     *a, *c;
+	const char       *e;
+
+	luaopen_t_buf( L );
+	lua_settop( L, 0 );
+	pl = t_buf_pol_test_new( L, 64, 2, 1 );                        // 1
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 2
+	a = t_buf_check_ud( L, 2, 1 );
+	memcpy( a->b, "hello", 5 );
+
+	// released buffers are kept by the pool ...
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_release, 2 ) );
+	lua_pop( L, 1 );
+	_assert( 0 == a->len );
+	lua_getuservalue( L, 1 );
+	_assert( 1 == lua_rawlen( L, -1 ) && 1 == pl->fr );
+	lua_pop( L, 1 );
+
+	// ... and handed out again as the very same userdata, zeroed
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 3
+	_assert( lua_rawequal( L, 2, 3 ) );
+	_assert( 64 == a->len && 0 == a->b[ 0 ] && 0 == a->rd );
+	_assert( 2 == pl->ht && 0 == pl->ms );
+	lua_settop( L, 2 );
+
+	// releasing twice is an error; buffers from elsewhere are left alone
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_release, 2 ) );
+	lua_pop( L, 1 );
+	e = t_buf_pol_test_call( L, lt_buf_release, 2 );
+	_assert( NULL != e && NULL != strstr( e, "T.Buffer was already released" ) );
+	lua_pop( L, 1 );
+	c = t_buf_create_ud( L, 8 );                                   // 3
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_release, 3 ) );
+	_assert( 8 == c->len );
+
+	// pools which don't zero hand out the previous content
+	lua_settop( L, 0 );
+	pl = t_buf_pol_test_new( L, 8, 1, 0 );                         // 1
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 2
+	a = t_buf_check_ud( L, 2, 1 );
+	memcpy( a->b, "abcdefgh", 8 );
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_release, 2 ) );
+	lua_settop( L, 1 );
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 2
+	a = t_buf_check_ud( L, 2, 1 );
+	_assert( 0 == memcmp( a->b, "abcdefgh", 8 ) );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_buf_pol_collect( )
+{
+	lua_State        *L = luaL_newstate( );
+	struct t_buf_pol *pl;
+
+	luaopen_t_buf( L );
+	lua_settop( L, 0 );
+	pl = t_buf_pol_test_new( L, 16, 2, 1 );                        // 1
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 2
+	_assert( NULL == t_buf_pol_test_call( L, lt_buf_pol_get, 1 ) ); // 3
+	_assert( 0 == pl->fr );
+
+	// buffers which get collected instead of released return their slot
+	lua_settop( L, 2 );
+	lua_gc( L, LUA_GCCOLLECT, 0 );
+	_assert( 1 == pl->fr && 1 == pl->fs[ 0 ] );
+	lua_settop( L, 1 );
+	lua_gc( L, LUA_GCCOLLECT, 0 );
+	_assert( 2 == pl->fr && 0 == pl->fs[ 1 ] );
+	lua_getuservalue( L, 1 );
+	_assert( 0 == lua_rawlen( L, -1 ) );
+	lua_close( L );
+	return 0;
+}
+
+
+// Add all testable functions to the array
+static const struct test_function all_tests [] = {
+	{ "Getting buffers from a pool", test_t_buf_pol_get },
+	{ "Releasing buffers to a pool", test_t_buf_pol_release },
+	{ "Collected pool buffers return their slot", test_t_buf_pol_collect },
+	{ NULL, NULL }
+};
+
+int
+main()
+{
+	return test_execute( all_tests );
+}
@@ -0,0 +1,437 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      test/t_pck.c
+ * \brief     Unit test for the lua-t packer source code
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "lualib.h"
+#include "t_unittest.h"
+
+
+/**--------------------------------------------------------------------------
+ * Create a Lua state with T.Buffer and T.Pack loaded as global T.
+ * \return  lua_State* the new state.
+ *  -------------------------------------------------------------------------*/
+static lua_State
+*t_pck_test_state( )
+{
+	lua_State *L = luaL_newstate( );
+
+	luaL_openlibs( L );
+	lua_newtable( L );
+	luaopen_t_buf( L );
+	lua_setfield( L, -2, "Buffer" );
+	luaopen_t_pck( L );
+	lua_setfield( L, -2, "Pack" );
+	// T.Pack finds its class as package.loaded.t.Pack
+	luaL_getsubtable( L, LUA_REGISTRYINDEX, "_LOADED" );
+	lua_pushvalue( L, -2 );
+	lua_setfield( L, -2, "t" );
+	lua_pop( L, 1 );
+	lua_setglobal( L, "T" );
+	return L;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read a variable sized value from a string.
+ * \lparam  string  packed data.
+ * \lparam  int     packer type (enum t_pck_t).
+ * \lparam  int     bytes of the length prefix (opt, default 0).
+ * \lreturn value   read from the string.
+ *  -------------------------------------------------------------------------*/
+static int
+t_pck_test_readvar( lua_State *L )
+{
+	struct t_pck  p;
+	size_t        l;
+	const char   *s = luaL_checklstring( L, 1, &l );
+
+	p.t = (enum t_pck_t) luaL_checkinteger( L, 2 );
+	p.s = (size_t) luaL_optinteger( L, 3, 0 );
+	p.m = 0;
+	p.b = 0;
+	t_pck_readvar( L, &p, (const unsigned char *) s, l );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run t_pck_test_readvar() protected.
+ * \return  const char* the error message or NULL if it succeeded.
+ *  -------------------------------------------------------------------------*/
+static const char
+*t_pck_test_readerr( lua_State *L, const char *s, size_t l, enum t_pck_t t, size_t n )
+{
+	lua_settop( L, 0 );
+	lua_pushcfunction( L, t_pck_test_readvar );
+	lua_pushlstring( L, s, l );
+	lua_pushinteger( L, (lua_Integer) t );
+	lua_pushinteger( L, (lua_Integer) n );
+	return (LUA_OK == lua_pcall( L, 3, 1, 0 )) ? NULL : lua_tostring( L, -1 );
+}
+
+
+static int
+test_t_pck_varint( )
+{
+	lua_Unsigned  vals[ ] = { 0, 1, 127, 128, 300, 16383, 16384,
+	                          LUA_MAXINTEGER, (lua_Unsigned) -1 };
+	unsigned char b[ 16 ];
+	lua_Unsigned  v;
+	size_t        i, n;
+
+	for (i=0; i < sizeof( vals ) / sizeof( vals[0] ); i++)
+	{
+		n = t_pck_putvarint( b, vals[ i ] );
+		_assert( n == t_pck_lenvarint( vals[ i ] ) );
+		_assert( n == t_pck_getvarint( b, n, &v ) );
+		_assert( v == vals[ i ] );
+		// every prefix of a varint is incomplete
+		_assert( 0 == t_pck_getvarint( b, n-1, &v ) );
+	}
+
+	// 300 = 0b10_0101100 -> low group first, continuation bit set
+	_assert( 2 == t_pck_putvarint( b, 300 ) );
+	_assert( 0xAC == b[0] && 0x02 == b[1] );
+	_assert( 1 == t_pck_lenvarint( 127 ) );
+	_assert( 2 == t_pck_lenvarint( 128 ) );
+	_assert( 10 == t_pck_lenvarint( (lua_Unsigned) -1 ) );
+
+	// more continuation bytes than a lua_Unsigned can hold
+	memset( b, 0x80, sizeof( b ) );
+	_assert( 0 == t_pck_getvarint( b, sizeof( b ), &v ) );
+	return 0;
+}
+
+
+static int
+test_t_pck_zigzag( )
+{
+	lua_Integer   vals[ ] = { 0, -1, 1, -2, 2, -64, 63, 64,
+	                          LUA_MININTEGER, LUA_MAXINTEGER };
+	lua_State    *L = t_pck_test_state( );
+	struct t_pck  p;
+	unsigned char b[ 16 ];
+	size_t        i, n;
+
+	p.t = T_PCK_VRS;
+	p.s = 0;
+	p.m = 0;
+	p.b = 0;
+	for (i=0; i < sizeof( vals ) / sizeof( vals[0] ); i++)
+	{
+		lua_pushinteger( L, vals[ i ] );
+		n = t_pck_putvar( L, &p, b, sizeof( b ) );
+		_assert( n == t_pck_putvar( L, &p, NULL, 0 ) );
+		lua_pop( L, 1 );
+		_assert( n == t_pck_readvar( L, &p, b, n ) );
+		_assert( lua_tointeger( L, -1 ) == vals[ i ] );
+		lua_pop( L, 1 );
+	}
+
+	// small magnitudes get small codes either way
+	lua_pushinteger( L, -1 );
+	_assert( 1 == t_pck_putvar( L, &p, b, sizeof( b ) ) && 0x01 == b[0] );
+	lua_pushinteger( L, 1 );
+	_assert( 1 == t_pck_putvar( L, &p, b, sizeof( b ) ) && 0x02 == b[0] );
+	lua_pushinteger( L, -64 );
+	_assert( 1 == t_pck_putvar( L, &p, b, sizeof( b ) ) && 0x7F == b[0] );
+	lua_pushinteger( L, 64 );
+	_assert( 2 == t_pck_putvar( L, &p, b, sizeof( b ) ) );
+	lua_pushinteger( L, LUA_MININTEGER );
+	_assert( 10 == t_pck_putvar( L, &p, b, sizeof( b ) ) );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_pck_prefix( )
+{
+	lua_State    *L = t_pck_test_state( );
+	struct t_pck  p;
+	unsigned char b[ 512 ];
+	char          x[ 300 ];
+	size_t        l;
+	const char   *s;
+
+	p.t = T_PCK_LPR;
+	p.b = 0;
+
+	// s1
+	p.s = 1;
+	p.m = 0;
+	lua_pushliteral( L, "abc" );
+	_assert( 4 == t_pck_putvar( L, &p, b, sizeof( b ) ) );
+	_assert( 0 == memcmp( b, "\x03" "abc", 4 ) );
+	_assert( 4 == t_pck_readvar( L, &p, b, 4 ) );
+	s = lua_tolstring( L, -1, &l );
+	_assert( 3 == l && 0 == memcmp( s, "abc", 3 ) );
+	lua_pop( L, 2 );
+
+	// big endian s2
+	p.s = 2;
+	p.m = 0;
+	lua_pushliteral( L, "abc" );
+	_assert( 5 == t_pck_putvar( L, &p, b, sizeof( b ) ) );
+	_assert( 0 == memcmp( b, "\x00\x03" "abc", 5 ) );
+	_assert( 5 == t_pck_readvar( L, &p, b, 5 ) );
+	_assert( 0 == strcmp( lua_tostring( L, -1 ), "abc" ) );
+	lua_pop( L, 2 );
+
+	// little endian s4
+	p.s = 4;
+	p.m = 1;
+	lua_pushliteral( L, "ab" );
+	_assert( 6 == t_pck_putvar( L, &p, b, sizeof( b ) ) );
+	_assert( 0 == memcmp( b, "\x02\x00\x00\x00" "ab", 6 ) );
+	_assert( 6 == t_pck_readvar( L, &p, b, 6 ) );
+	_assert( 0 == strcmp( lua_tostring( L, -1 ), "ab" ) );
+	lua_pop( L, 2 );
+
+	// S has a varint prefix
+	p.s = 0;
+	p.m = 0;
+	lua_pushliteral( L, "hello" );
+	_assert( 6 == t_pck_putvar( L, &p, b, sizeof( b ) ) );
+	_assert( 0 == memcmp( b, "\x05" "hello", 6 ) );
+	lua_pop( L, 1 );
+	memset( x, 'x', sizeof( x ) );
+	lua_pushlstring( L, x, sizeof( x ) );
+	_assert( 302 == t_pck_putvar( L, &p, b, sizeof( b ) ) );
+	_assert( 0xAC == b[0] && 0x02 == b[1] );
+	_assert( 302 == t_pck_readvar( L, &p, b, 302 ) );
+	s = lua_tolstring( L, -1, &l );
+	_assert( sizeof( x ) == l && 0 == memcmp( s, x, l ) );
+	lua_pop( L, 2 );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_pck_truncated( )
+{
+	lua_State   *L = t_pck_test_state( );
+	const char  *e;
+
+	_assert( NULL == t_pck_test_readerr( L, "\xAC\x02", 2, T_PCK_VRU, 0 ) );
+	_assert( 300 == lua_tointeger( L, -1 ) );
+
+	// varint without its last byte
+	e = t_pck_test_readerr( L, "\xAC", 1, T_PCK_VRU, 0 );
+	_assert( NULL != e && NULL != strstr( e, "packed VarUInt is truncated or malformed" ) );
+	e = t_pck_test_readerr( L, "\x80\x80", 2, T_PCK_VRS, 0 );
+	_assert( NULL != e && NULL != strstr( e, "packed VarInt is truncated or malformed" ) );
+	e = t_pck_test_readerr( L, "", 0, T_PCK_VRU, 0 );
+	_assert( NULL != e && NULL != strstr( e, "truncated or malformed" ) );
+
+	// prefix claims more than there is
+	e = t_pck_test_readerr( L, "\x09" "abc", 4, T_PCK_LPR, 1 );
+	_assert( NULL != e && NULL != strstr( e, "packed String is truncated" ) );
+	e = t_pck_test_readerr( L, "\x05" "ab", 3, T_PCK_LPR, 0 );
+	_assert( NULL != e && NULL != strstr( e, "packed String is truncated" ) );
+	e = t_pck_test_readerr( L, "\xff\xff\xff\xff\xff\xff\xff\xff\x7f", 9, T_PCK_LPR, 0 );
+	_assert( NULL != e && NULL != strstr( e, "packed String is truncated" ) );
+
+	// prefix itself is cut off
+	e = t_pck_test_readerr( L, "\x00", 1, T_PCK_LPR, 2 );
+	_assert( NULL != e && NULL != strstr( e, "packed String is truncated" ) );
+	e = t_pck_test_readerr( L, "\x83", 1, T_PCK_LPR, 0 );
+	_assert( NULL != e && NULL != strstr( e, "packed String is truncated or malformed" ) );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_pck_reader( )
+{
+	lua_State           *L = t_pck_test_state( );
+	struct t_pcr        *pr;
+	const unsigned char *b;
+	size_t               l;
+
+	_assert( LUA_OK == luaL_dostring( L,
+	   "st = T.Pack( {id='Q'}, {name='S'}, {score='<i2'}, {tail='B'} )\n"
+	   "d  = st:pack( {id=300, name='bob', score=-2, tail=9} )" ) );
+	lua_getglobal( L, "st" );                  // 1
+	lua_getglobal( L, "d" );                   // 2
+	b = (const unsigned char *) lua_tolstring( L, 2, &l );
+	_assert( 2 + 4 + 2 + 1 == l );
+
+	// the first member has a fixed offset
+	lua_getfield( L, 1, "id" );                // 3
+	pr = (struct t_pcr *) luaL_checkudata( L, 3, "T.Pack.Reader" );
+	_assert( 0 == pr->i && 0 == pr->o );
+	_assert( 0 == t_pck_resolve( L, 3, b, l ) );
+
+	// members behind variable sized ones only know their index
+	lua_getfield( L, 1, "name" );              // 4
+	_assert( 2 == t_pck_resolve( L, 4, b, l ) );
+	lua_getfield( L, 1, "score" );             // 5
+	pr = (struct t_pcr *) luaL_checkudata( L, 5, "T.Pack.Reader" );
+	_assert( 3 == pr->i );
+	_assert( 6 == t_pck_resolve( L, 5, b, l ) );
+	lua_getfield( L, 1, "tail" );              // 6
+	pr = (struct t_pcr *) luaL_checkudata( L, 6, "T.Pack.Reader" );
+	_assert( 4 == pr->i );
+	_assert( 8 == t_pck_resolve( L, 6, b, l ) );
+
+	// Readers get cached as long as they are referenced
+	lua_getfield( L, 1, "tail" );              // 7
+	_assert( lua_rawequal( L, 6, 7 ) );
+	lua_settop( L, 2 );
+
+	// offsets follow the packed data
+	_assert( LUA_OK == luaL_dostring( L,
+	   "local e = st:pack( {id=1, name=string.rep('x', 200), score=7, tail=3} )\n"
+	   "return st.tail( e ), st.score( e ), #e" ) );
+	_assert( 3 == lua_tointeger( L, -3 ) );
+	_assert( 7 == lua_tointeger( L, -2 ) );
+	_assert( 1 + 202 + 2 + 1 == lua_tointeger( L, -1 ) );
+	lua_settop( L, 2 );
+
+	// skipping a truncated element raises an error
+	_assert( LUA_OK == luaL_dostring( L, "return pcall( st.tail, d:sub( 1, 4 ) )" ) );
+	_assert( ! lua_toboolean( L, -2 ) );
+	_assert( NULL != strstr( lua_tostring( L, -1 ), "packed String is truncated" ) );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_pck_each( )
+{
+	lua_State    *L = t_pck_test_state( );
+	struct t_pcc *c;
+	lua_Integer   i;
+
+	_assert( LUA_OK == luaL_dostring( L,
+	   "rec = T.Pack( {ts='<I4'}, {val='<i2'} )\n"
+	   "arr = T.Pack( rec, 3 )\n"
+	   "buf = T.Buffer( arr:pack( { {ts=10,val=-1}, {ts=20,val=-2}, {ts=30,val=-3} } ) )" ) );
+
+	lua_pushcfunction( L, lt_pck_each );
+	lua_getglobal( L, "arr" );
+	lua_getglobal( L, "buf" );
+	lua_call( L, 2, 1 );                       // 1: iterator
+	for (i=1; i <= 3; i++)
+	{
+		lua_pushvalue( L, 1 );
+		lua_call( L, 0, 2 );                    // 2: index, 3: cursor
+		_assert( i == lua_tointeger( L, 2 ) );
+		c = (struct t_pcc *) luaL_checkudata( L, 3, "T.Pack.Cursor" );
+		_assert( (size_t) i == c->i && 6 * (size_t) (i-1) == c->o );
+		lua_getfield( L, 3, "ts" );
+		_assert( 10 * i == lua_tointeger( L, -1 ) );
+		lua_getfield( L, 3, "val" );
+		_assert( -i == lua_tointeger( L, -1 ) );
+		lua_settop( L, 1 );
+	}
+	lua_pushvalue( L, 1 );
+	lua_call( L, 0, 2 );
+	_assert( lua_isnil( L, 2 ) );
+	lua_settop( L, 0 );
+
+	// projections reuse one table; offset and count select records
+	_assert( LUA_OK == luaL_dostring( L,
+	   "local s, last = 0\n"
+	   "for i, r in rec:each( buf, 6, 2, {'ts'} ) do\n"
+	   "   assert( nil == last or last == r )\n"
+	   "   assert( nil == r.val )\n"
+	   "   s, last = s + r.ts, r\n"
+	   "end\n"
+	   "return s" ) );
+	_assert( 50 == lua_tointeger( L, -1 ) );
+	lua_settop( L, 0 );
+
+	// variable sized records can't be iterated
+	_assert( LUA_OK == luaL_dostring( L,
+	   "return pcall( T.Pack.each, T.Pack( 'QQ' ), buf )" ) );
+	_assert( ! lua_toboolean( L, 1 ) );
+	_assert( NULL != strstr( lua_tostring( L, 2 ), "records must be fixed sized" ) );
+	lua_settop( L, 0 );
+	_assert( LUA_OK == luaL_dostring( L, "return pcall( rec.each, rec, buf, 0, 4 )" ) );
+	_assert( ! lua_toboolean( L, 1 ) );
+	_assert( NULL != strstr( lua_tostring( L, 2 ), "too short" ) );
+	lua_close( L );
+	return 0;
+}
+
+
+static int
+test_t_pck_column( )
+{
+	lua_State    *L = t_pck_test_state( );
+	struct t_buf *buf;
+	int16_t       v[ 3 ];
+	lua_Integer   i;
+
+	_assert( LUA_OK == luaL_dostring( L,
+	   "rec = T.Pack( {ts='>I4'}, {val='<i2'} )\n"
+	   "arr = T.Pack( rec, 3 )\n"
+	   "buf = T.Buffer( arr:pack( { {ts=10,val=-1}, {ts=20,val=-2}, {ts=30,val=-3} } ) )" ) );
+
+	// the default target is a T.Buffer in native byte order
+	lua_pushcfunction( L, lt_pck_column );
+	lua_getglobal( L, "rec" );
+	lua_getglobal( L, "buf" );
+	lua_pushliteral( L, "val" );
+	lua_call( L, 3, 1 );
+	buf = t_buf_check_ud( L, -1, 1 );
+	_assert( sizeof( v ) == buf->len );
+	memcpy( v, buf->b, sizeof( v ) );
+	_assert( -1 == v[0] && -2 == v[1] && -3 == v[2] );
+	lua_settop( L, 0 );
+
+	// into a table, by index, limited count
+	lua_pushcfunction( L, lt_pck_column );
+	lua_getglobal( L, "arr" );
+	lua_getglobal( L, "buf" );
+	lua_pushinteger( L, 1 );
+	lua_pushinteger( L, 2 );
+	lua_pushnil( L );
+	lua_newtable( L );
+	lua_call( L, 6, 1 );
+	_assert( 2 == lua_rawlen( L, 1 ) );
+	for (i=1; i <= 2; i++)
+	{
+		lua_rawgeti( L, 1, i );
+		_assert( 10 * i == lua_tointeger( L, -1 ) );
+		lua_pop( L, 1 );
+	}
+	lua_settop( L, 0 );
+
+	// strided access must stay within the source
+	_assert( LUA_OK == luaL_dostring( L,
+	   "return pcall( rec.column, rec, buf, 'ts', 4 )" ) );
+	_assert( ! lua_toboolean( L, 1 ) );
+	_assert( NULL != strstr( lua_tostring( L, 2 ), "too short" ) );
+	lua_close( L );
+	return 0;
+}
+
+
+// Add all testable functions to the array
+static const struct test_function all_tests [] = {
+	{ "Varint round trips and incomplete input", test_t_pck_varint },
+	{ "Zigzag encoded varints", test_t_pck_zigzag },
+	{ "Fixed and varint length prefixed strings", test_t_pck_prefix },
+	{ "Truncated input raises errors", test_t_pck_truncated },
+	{ "Lazy Reader offsets behind variable sized members", test_t_pck_reader },
+	{ "Cursor iteration over fixed sized records", test_t_pck_each },
+	{ "Column gathering of record fields", test_t_pck_column },
+	{ NULL, NULL }
+};
+
+int
+main()
+{
+	return test_execute( all_tests );
+}
@@ -28,9 +28,42 @@ test_t_tim_add( )
 	return 0;
 }
 
+static int
+test_t_tim_ns( )
+{
+	struct timeval tA;
+
+	tA.tv_sec  = 12;
+	tA.tv_usec = 345678;
+	_assert( t_tim_getns( &tA ) == 12345678000ULL );
+
+	// negative spans count as already elapsed
+	tA.tv_sec  = -1;
+	_assert( t_tim_getns( &tA ) == 0 );
+
+	// round up to the next full microsecond
+	t_tim_setns( &tA, 12345678001ULL );
+	_assert( tA.tv_sec  == 12 );
+	_assert( tA.tv_usec == 345679 );
+	return 0;
+}
+
+static int
+test_t_tim_mono( )
+{
+	uint64_t a = t_tim_mono( );
+	uint64_t b = t_tim_mono( );
+
+	_assert( a > 0 );
+	_assert( b >= a );
+	return 0;
+}
+
 // Add all testable functions to the array
 static const struct test_function all_tests [] = {
 	{ "Adding two t_tim values", test_t_tim_add },
+	{ "Converting t_tim values to and from nanoseconds", test_t_tim_ns },
+	{ "Monotonic clock never goes backwards", test_t_tim_mono },
 	{ NULL, NULL }
 };
 